@@ -8,7 +8,7 @@ struct CameraUniforms
     mat4 projection_from_view;
     mat4 view_from_projection;
     vec4 near_far; // x=near, y=far, z=(far / (far - near)), w=((-far * near) / (far - near))
-	vec4 frustum_jitter; // xy=jitter, zw=unused
+	vec4 frustum_jitter; // xy=jitter relative to the previous frame, zw=jitter of this frame (in NDC)
 
     mat4 prev_projection_from_world;
 
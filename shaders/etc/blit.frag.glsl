@@ -6,9 +6,12 @@ in vec2 v_uv;
 
 PredefinedUniform(sampler2D, u_texture);
 
+// For blitting from only a part of the texture, e.g. the rendered part of the light buffer
+uniform vec2 u_uv_scale = vec2(1.0);
+
 PredefinedOutput(vec4, o_color);
 
 void main()
 {
-    o_color = texture(u_texture, v_uv);
+    o_color = texture(u_texture, v_uv * u_uv_scale);
 }
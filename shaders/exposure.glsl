@@ -0,0 +1,60 @@
+#ifndef EXPOSURE_GLSL
+#define EXPOSURE_GLSL
+
+#include <common.glsl>
+#include <camera_model.glsl>
+#include <camera_uniforms.h>
+#include <shader_locations.h>
+#include <shader_constants.h>
+
+// The luminance histogram of the light buffer and the (adapted) luminance to expose for, see FinalPass
+restrict PredefinedShaderStorageBlock(ExposureBlock)
+{
+    uint histogram[EXPOSURE_HISTOGRAM_BIN_COUNT];
+    float adaptedLuminance;
+};
+
+const float histogramLog2LuminanceRange = EXPOSURE_HISTOGRAM_MAX_LOG2_LUMINANCE - EXPOSURE_HISTOGRAM_MIN_LOG2_LUMINANCE;
+
+uint histogramBinFromLuminance(float luminance)
+{
+    if (luminance < 0.00001)
+    {
+        return 0;
+    }
+
+    float t = clamp((log2(luminance) - EXPOSURE_HISTOGRAM_MIN_LOG2_LUMINANCE) / histogramLog2LuminanceRange, 0.0, 1.0);
+    return 1 + uint(t * float(EXPOSURE_HISTOGRAM_BIN_COUNT - 2));
+}
+
+float histogramBinLog2Luminance(uint bin)
+{
+    float t = (float(bin - 1) + 0.5) / float(EXPOSURE_HISTOGRAM_BIN_COUNT - 2);
+    return EXPOSURE_HISTOGRAM_MIN_LOG2_LUMINANCE + t * histogramLog2LuminanceRange;
+}
+
+// The factor to expose the light buffer with, either from the metered luminance or the manual camera settings
+float computeExposure(CameraUniforms cameraUniforms)
+{
+    if (cameraUniforms.use_automatic_exposure)
+    {
+        // (metered from the histogram & adapted over time, see exposure_from_histogram.comp.glsl)
+        float ev100 = computeEV100FromAvgLuminance(adaptedLuminance);
+        ev100 -= cameraUniforms.exposure_compensation;
+
+        return convertEV100ToExposure(ev100);
+    }
+    else
+    {
+        float ev100 = computeEV100(cameraUniforms.aperture, cameraUniforms.shutter_speed, cameraUniforms.iso);
+        float exposure = convertEV100ToExposure(ev100);
+
+        //
+        // Why is this needed?!
+        // (well I guess I don't use physically based light light intensities..)
+        //
+        return exposure * 12000.0;
+    }
+}
+
+#endif // EXPOSURE_GLSL
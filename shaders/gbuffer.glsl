@@ -0,0 +1,64 @@
+#ifndef GBUFFER_GLSL
+#define GBUFFER_GLSL
+
+#include <common.glsl>
+#include <gbuffer_formats.h>
+
+// Packing & unpacking of the material properties in the g-buffer, according to GBUFFER_LAYOUT
+
+struct GBufferMaterial
+{
+    vec3 baseColor;
+    float roughness;
+    float metallic;
+};
+
+#if GBUFFER_LAYOUT == GBUFFER_LAYOUT_PACKED
+
+// Roughness in the upper six bits and metallic in the lower two bits of an 8-bit unorm channel. Since the value is
+// an exact multiple of 1/255 the conversion to and from the render target is lossless.
+float packRoughnessMetallic(float roughness, float metallic)
+{
+    uint r = uint(round(saturate(roughness) * 63.0));
+    uint m = uint(round(saturate(metallic) * 3.0));
+    return float((r << 2u) | m) / 255.0;
+}
+
+vec2 unpackRoughnessMetallic(float packed)
+{
+    uint bits = uint(round(packed * 255.0));
+    return vec2(float(bits >> 2u) / 63.0, float(bits & 3u) / 3.0);
+}
+
+#endif
+
+void packGBufferMaterial(vec3 baseColor, float roughness, float metallic, out vec4 albedo, out vec4 material)
+{
+#if GBUFFER_LAYOUT == GBUFFER_LAYOUT_PACKED
+    albedo = vec4(baseColor, packRoughnessMetallic(roughness, metallic));
+    material = vec4(0.0); // (not attached)
+#else
+    albedo = vec4(baseColor, 1.0);
+    material = vec4(roughness, metallic, 1.0, 1.0);
+#endif
+}
+
+GBufferMaterial fetchGBufferMaterial(sampler2D albedoTexture, sampler2D materialTexture, ivec2 pixelCoord)
+{
+    GBufferMaterial result;
+
+    vec4 albedo = texelFetch(albedoTexture, pixelCoord, 0);
+    result.baseColor = albedo.rgb;
+
+#if GBUFFER_LAYOUT == GBUFFER_LAYOUT_PACKED
+    vec2 roughnessMetallic = unpackRoughnessMetallic(albedo.a);
+#else
+    vec2 roughnessMetallic = texelFetch(materialTexture, pixelCoord, 0).rg;
+#endif
+
+    result.roughness = roughnessMetallic.x;
+    result.metallic = roughnessMetallic.y;
+    return result;
+}
+
+#endif // GBUFFER_GLSL
@@ -0,0 +1,38 @@
+#ifndef GBUFFER_FORMATS_H
+#define GBUFFER_FORMATS_H
+
+// Layout of the g-buffer textures. The material shaders pack and the light shaders unpack the material properties
+// through gbuffer.glsl, so they always agree with the textures created in GBuffer.cpp. (recompile to change)
+//
+//  SEPARATE:     albedo RGBA8 (A unused), material RGBA8 (roughness, metallic, BA unused)
+//  MATERIAL_RG8: albedo RGBA8 (A unused), material RG8 (roughness, metallic)
+//  PACKED:       albedo RGBA8 with 6 bits of roughness and 2 bits of metallic in A, no material texture
+//
+// The normal & velocity texture is RGBA16F in all layouts.
+#define GBUFFER_LAYOUT_SEPARATE     (0)
+#define GBUFFER_LAYOUT_MATERIAL_RG8 (1)
+#define GBUFFER_LAYOUT_PACKED       (2)
+
+// A 16-bit depth buffer halves the depth traffic, but with a standard (non-reversed) projection the precision is
+// only good enough for fairly small scenes or a far-away near plane.
+#define GBUFFER_DEPTH_32F (0)
+#define GBUFFER_DEPTH_16  (1)
+
+#define GBUFFER_LAYOUT       GBUFFER_LAYOUT_MATERIAL_RG8
+#define GBUFFER_DEPTH_FORMAT GBUFFER_DEPTH_32F
+
+#if GBUFFER_LAYOUT == GBUFFER_LAYOUT_SEPARATE
+ #define GBUFFER_MATERIAL_INTERNAL_FORMAT GL_RGBA8
+#elif GBUFFER_LAYOUT == GBUFFER_LAYOUT_MATERIAL_RG8
+ #define GBUFFER_MATERIAL_INTERNAL_FORMAT GL_RG8
+#elif GBUFFER_LAYOUT == GBUFFER_LAYOUT_PACKED
+ #define GBUFFER_MATERIAL_INTERNAL_FORMAT GL_NONE
+#endif
+
+#if GBUFFER_DEPTH_FORMAT == GBUFFER_DEPTH_32F
+ #define GBUFFER_DEPTH_INTERNAL_FORMAT GL_DEPTH_COMPONENT32F
+#elif GBUFFER_DEPTH_FORMAT == GBUFFER_DEPTH_16
+ #define GBUFFER_DEPTH_INTERNAL_FORMAT GL_DEPTH_COMPONENT16
+#endif
+
+#endif // GBUFFER_FORMATS_H
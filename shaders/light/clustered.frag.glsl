@@ -0,0 +1,103 @@
+#version 460
+
+#include <brdf.glsl>
+#include <common.glsl>
+#include <gbuffer.glsl>
+#include <shader_locations.h>
+#include <camera_uniforms.h>
+#include <light_clusters.glsl>
+
+in vec2 v_uv;
+
+PredefinedUniformBlock(CameraUniformBlock, camera);
+
+PredefinedUniform(sampler2D, u_g_buffer_albedo);
+PredefinedUniform(sampler2D, u_g_buffer_material);
+PredefinedUniform(sampler2D, u_g_buffer_norm_vel);
+PredefinedUniform(sampler2D, u_g_buffer_depth);
+
+PredefinedOutput(vec4, o_color);
+
+float linearizeDepth(float nonLinearDepth)
+{
+    float projectionA = camera.near_far.z;
+    float projectionB = camera.near_far.w;
+    return projectionB / (nonLinearDepth - projectionA);
+}
+
+void main()
+{
+    ivec2 pixelCoord = ivec2(gl_FragCoord.xy);
+
+    vec2 packedNormal = texelFetch(u_g_buffer_norm_vel, pixelCoord, 0).xy;
+    bool unlit = lengthSquared(packedNormal) < 0.0001;
+    if (unlit)
+    {
+        o_color = vec4(0.0, 0.0, 0.0, 1.0);
+        return;
+    }
+
+    // (the view ray is reconstructed here, so that this can be used with the plain quad.vert.glsl)
+    vec4 viewRay = camera.view_from_projection * vec4(v_uv * 2.0 - 1.0, 0.0, 1.0);
+    viewRay.xyz /= viewRay.w;
+    viewRay.xyz /= viewRay.z;
+
+    float depth = texelFetch(u_g_buffer_depth, pixelCoord, 0).x;
+    vec3 viewSpacePos = viewRay.xyz * linearizeDepth(depth);
+
+    vec3 N = octahedralDecode(packedNormal);
+    vec3 V = -normalize(viewSpacePos);
+
+    GBufferMaterial material = fetchGBufferMaterial(u_g_buffer_albedo, u_g_buffer_material, pixelCoord);
+    vec3 baseColor = material.baseColor;
+    float roughness = material.roughness + 0.01;
+    float metallic = material.metallic;
+    vec3 diffuseColor = vec3(1.0 - metallic) * baseColor;
+
+    ivec2 tile = min(ivec2(v_uv * vec2(LIGHT_CLUSTER_COUNT_X, LIGHT_CLUSTER_COUNT_Y)), ivec2(LIGHT_CLUSTER_COUNT_X - 1, LIGHT_CLUSTER_COUNT_Y - 1));
+    ivec3 cluster = ivec3(tile, clusterSliceFromDepth(viewSpacePos.z, camera.near_far.xy));
+    uint clusterIdx = clusterIndex(cluster);
+    uint lightCount = min(clusterLightCounts[clusterIdx], uint(LIGHT_CLUSTER_MAX_LIGHTS));
+
+    vec3 color = vec3(0.0);
+    for (uint i = 0; i < lightCount; ++i)
+    {
+        uint lightIdx = clusterLightIndices[clusterIdx * LIGHT_CLUSTER_MAX_LIGHTS + i];
+
+        vec3 toLight;
+        float range;
+        vec3 lightColor;
+        float spotFactor = 1.0;
+
+        if (lightIdx < pointLightCount)
+        {
+            PointLight light = pointLights[lightIdx];
+            toLight = light.viewPosition.xyz - viewSpacePos;
+            range = light.worldPosition.w;
+            lightColor = rgbFromColor(light.color);
+        }
+        else
+        {
+            SpotLight light = spotLights[lightIdx - pointLightCount];
+            toLight = light.viewPosition.xyz - viewSpacePos;
+            range = light.worldPosition.w;
+            lightColor = rgbFromColor(light.color);
+
+            float cosAngle = dot(-normalize(toLight), light.viewDirection.xyz);
+            spotFactor = smoothstep(light.cone.x, light.cone.y, cosAngle);
+        }
+
+        float distanceSquared = dot(toLight, toLight);
+        vec3 L = toLight * inversesqrt(distanceSquared);
+        float LdotN = max(dot(L, N), 0.0);
+
+        float attenuation = distanceAttenuation(distanceSquared, range) * spotFactor;
+        if (attenuation * LdotN <= 0.0) continue;
+
+        vec3 specular = specularBRDF(L, V, N, baseColor, roughness, metallic);
+        vec3 diffuse = diffuseColor * diffuseBRDF();
+        color += (diffuse + specular) * lightColor * attenuation * LdotN;
+    }
+
+    o_color = vec4(color, 1.0);
+}
@@ -2,6 +2,7 @@
 
 #include <brdf.glsl>
 #include <common.glsl>
+#include <gbuffer.glsl>
 #include <shader_locations.h>
 #include <camera_uniforms.h>
 #include <scene_uniforms.h>
@@ -31,6 +32,13 @@ PredefinedNoiseImage(img_blue_noise);
 
 PredefinedOutput(vec4, o_color);
 
+// 0 - hard shadows (a single sample), 1 - soft shadows (filtered with the samples below). Selected through program
+// permutations, see LightPass.
+// permutation: SHADOW_FILTER 0 1
+#ifndef SHADOW_FILTER
+ #define SHADOW_FILTER 1
+#endif
+
 // 9 samples in a Fibbonaci spiral with radius 1.0f
 const int numFibShadowSamples = 9;
 const vec2 fibShadowSamples[] = vec2[numFibShadowSamples](
@@ -47,20 +55,49 @@ const vec2 fibShadowSamples[] = vec2[numFibShadowSamples](
 
 float calculateShadowFactor(vec4 viewSpacePos, float LdotN)
 {
+    // (the light didn't get a segment in the shadow map atlas)
     int segmentIdx = directionalLight.shadowMapSegmentIndex.x;
-    ShadowMapSegment segment = shadowMapSegments[segmentIdx];
-    vec2 shadowTexelSize = vec2(1.0) / vec2(textureSize(u_shadow_map, 0));
+    if (segmentIdx < 0) return 1.0;
+
+    // Select the first cascade that ends beyond this pixel (view space z is the linear depth)
+    int cascadeCount = directionalLight.shadowMapSegmentIndex.y;
+    int cascade = 0;
+    while (cascade < cascadeCount && viewSpacePos.z > directionalLight.cascadeSplits[cascade])
+    {
+        cascade += 1;
+    }
+
+    // (beyond the shadow distance)
+    if (cascade == cascadeCount) return 1.0;
+
+    ShadowMapSegment segment = shadowMapSegments[segmentIdx + cascade];
+    vec2 shadowMapSize = vec2(textureSize(u_shadow_map, 0));
+    vec2 shadowTexelSize = vec2(1.0) / shadowMapSize;
+
+    // Never sample outside the segment, since that's where the other segments of the atlas are
+    vec2 segmentMinUv = (vec2(segment.minX, segment.minY) + 0.5) * shadowTexelSize;
+    vec2 segmentMaxUv = (vec2(segment.maxX, segment.maxY) - 0.5) * shadowTexelSize;
 
     float bias = 0.0006 - 0.0006 * pow(LdotN, 10.0);
     mat4 lightProjectionFromView = segment.lightViewProjection * camera.world_from_view;
 
+#if SHADOW_FILTER == 0
+    // (the first sample of the spiral is the center)
+    const int firstSample = 0;
+    const int endSample = 1;
+    mat2 sampleRot = mat2(1.0);
+#else
+    const int firstSample = 1;
+    const int endSample = numFibShadowSamples;
+
     // Generate rotation from a blue-noise value
     ivec3 noiseCoords = ivec3(ivec2(gl_FragCoord.xy) % ivec2(64), scene.frame_count_noise);
     float angle = TWO_PI * imageLoad(img_blue_noise, noiseCoords).r;
     mat2 sampleRot = mat2(cos(angle), sin(angle), -sin(angle), cos(angle));
+#endif
 
     float shadowAcc = 0.0;
-    for (int i = 1; i < numFibShadowSamples; ++i)
+    for (int i = firstSample; i < endSample; ++i)
     {
         vec4 posInShadowMap = lightProjectionFromView * viewSpacePos;
         posInShadowMap.xyz /= posInShadowMap.w;
@@ -69,17 +106,16 @@ float calculateShadowFactor(vec4 viewSpacePos, float LdotN)
         vec2 shadowMapUv = (segment.uvTransform * vec4(posInShadowMap.xy, 0.0, 1.0)).xy;
         vec2 offset = sampleRot * fibShadowSamples[i];
         shadowMapUv += directionalLight.softness.x * shadowTexelSize * offset;
+        shadowMapUv = clamp(shadowMapUv, segmentMinUv, segmentMaxUv);
         float mapDepth = texture(u_shadow_map, shadowMapUv).x;
 
         float actualDepth = posInShadowMap.z * 0.5 + 0.5;
         float shadowFactor = (mapDepth < actualDepth + bias) ? 0.0 : 1.0;
 
-        // TODO: Implement a proper UV-based way of detecting if we sample outside the shadow map segment
-
         shadowAcc += shadowFactor;
     }
 
-    return shadowAcc / (numFibShadowSamples - 1);
+    return shadowAcc / float(endSample - firstSample);
 }
 
 float linearizeDepth(float nonLinearDepth)
@@ -91,10 +127,13 @@ float linearizeDepth(float nonLinearDepth)
 
 void main()
 {
-    float depth = texture(u_g_buffer_depth, v_uv).x;
+    // (texel fetches, since the viewport only covers part of the g-buffer with dynamic resolution)
+    ivec2 pixelCoord = ivec2(gl_FragCoord.xy);
+
+    float depth = texelFetch(u_g_buffer_depth, pixelCoord, 0).x;
     vec4 viewSpacePos = vec4(v_view_ray * linearizeDepth(depth), 1.0);
 
-    vec2 packedNormal = texture(u_g_buffer_norm_vel, v_uv).xy;
+    vec2 packedNormal = texelFetch(u_g_buffer_norm_vel, pixelCoord, 0).xy;
     bool unlit = lengthSquared(packedNormal) < 0.0001;
 
     vec3 N = octahedralDecode(packedNormal);
@@ -105,10 +144,10 @@ void main()
     vec3 lightColor = rgbFromColor(directionalLight.color);
     vec3 directLight = lightColor * calculateShadowFactor(viewSpacePos, LdotN);
 
-    vec3 baseColor = texture(u_g_buffer_albedo, v_uv).rgb;
-    vec4 material = texture(u_g_buffer_material, v_uv);
-    float roughness = material.x + 0.01;
-    float metallic = material.y;
+    GBufferMaterial material = fetchGBufferMaterial(u_g_buffer_albedo, u_g_buffer_material, pixelCoord);
+    vec3 baseColor = material.baseColor;
+    float roughness = material.roughness + 0.01;
+    float metallic = material.metallic;
 
     vec3 specular = specularBRDF(L, V, N, baseColor, roughness, metallic);
     // TODO: Add the multiscatter estimation from Filament 4.7.2:
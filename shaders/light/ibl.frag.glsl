@@ -1,6 +1,7 @@
 #version 460
 
 #include <common.glsl>
+#include <gbuffer.glsl>
 #include <brdf.glsl>
 
 #include <shader_locations.h>
@@ -45,10 +46,12 @@ vec3 ggxBrdfApproximation(vec3 specularColor, float roughness, float NdotV)
 
 void main()
 {
-    float depth = texture(u_g_buffer_depth, v_uv).x;
+    ivec2 pixelCoord = ivec2(gl_FragCoord.xy);
+
+    float depth = texelFetch(u_g_buffer_depth, pixelCoord, 0).x;
     vec4 viewSpacePos = vec4(v_view_ray * linearizeDepth(depth), 1.0);
 
-    vec2 packedNormal = texture(u_g_buffer_norm_vel, v_uv).xy;
+    vec2 packedNormal = texelFetch(u_g_buffer_norm_vel, pixelCoord, 0).xy;
     bool unlit = lengthSquared(packedNormal) < 0.0001;
 
     vec3 N = octahedralDecode(packedNormal);
@@ -56,11 +59,11 @@ void main()
 
     // This roughness parameter is supposed to be perceptually linear! Since we use a squared
     // roughness when prefiltering the radiance map this works itself out in this shader.
-    vec4 material = texture(u_g_buffer_material, v_uv);
-    float roughness = material.x;
-    float metallic = material.y;
+    GBufferMaterial material = fetchGBufferMaterial(u_g_buffer_albedo, u_g_buffer_material, pixelCoord);
+    float roughness = material.roughness;
+    float metallic = material.metallic;
 
-    vec3 baseColor = texture(u_g_buffer_albedo, v_uv).xyz;
+    vec3 baseColor = material.baseColor;
 
     vec3 f0 = mix(vec3(DIELECTRIC_REFLECTANCE), baseColor, metallic);
     // (use square roughness here, since we call directly into the brdf-related code)
@@ -99,7 +102,7 @@ void main()
     vec3 kDiffuse = (vec3(1.0) - F) * vec3(1.0 - metallic);
     vec3 indirectLight = (kDiffuse * diffuse) + specular;
 
-    indirectLight *= texture(u_occlusion_texture, v_uv).r;
+    indirectLight *= texelFetch(u_occlusion_texture, pixelCoord, 0).r;
 
     vec3 color = (unlit) ? baseColor : indirectLight;
     o_color = vec4(color, 1.0);
@@ -0,0 +1,103 @@
+#version 460
+
+#include <shader_locations.h>
+#include <camera_uniforms.h>
+#include <light_clusters.glsl>
+
+// One work group per cluster, where the invocations share the lights between them
+layout(
+    local_size_x = 64
+) in;
+
+PredefinedUniformBlock(CameraUniformBlock, camera);
+
+shared uint sharedLightCount;
+
+bool sphereIntersectsAabb(vec3 center, float radius, vec3 aabbMin, vec3 aabbMax)
+{
+    vec3 closestPoint = clamp(center, aabbMin, aabbMax);
+    vec3 delta = closestPoint - center;
+    return dot(delta, delta) <= radius * radius;
+}
+
+// From https://bartwronski.com/2017/04/13/cull-that-cone/
+bool coneIntersectsSphere(vec3 origin, vec3 direction, float range, float cosAngle, float sinAngle, vec3 center, float radius)
+{
+    vec3 v = center - origin;
+    float vLengthSquared = dot(v, v);
+    float v1Length = dot(v, direction);
+    float distanceClosestPoint = cosAngle * sqrt(max(vLengthSquared - v1Length * v1Length, 0.0)) - v1Length * sinAngle;
+
+    bool angleCull = distanceClosestPoint > radius;
+    bool frontCull = v1Length > radius + range;
+    bool backCull = v1Length < -radius;
+    return !(angleCull || frontCull || backCull);
+}
+
+void main()
+{
+    ivec3 cluster = ivec3(gl_WorkGroupID);
+    uint clusterIdx = clusterIndex(cluster);
+
+    if (gl_LocalInvocationIndex == 0)
+    {
+        sharedLightCount = 0;
+    }
+
+    // The view space bounds of the cluster, from the rays through the corners of its tile, at both depths of its slice
+    vec2 tileSize = vec2(2.0) / vec2(LIGHT_CLUSTER_COUNT_X, LIGHT_CLUSTER_COUNT_Y);
+    vec2 tileMinNdc = vec2(cluster.xy) * tileSize - 1.0;
+    float minDepth = clusterSliceDepth(cluster.z, camera.near_far.xy);
+    float maxDepth = clusterSliceDepth(cluster.z + 1, camera.near_far.xy);
+
+    vec3 aabbMin = vec3(1.0e30);
+    vec3 aabbMax = vec3(-1.0e30);
+    for (int i = 0; i < 4; ++i)
+    {
+        vec2 cornerNdc = tileMinNdc + tileSize * vec2(i & 1, (i >> 1) & 1);
+        vec4 viewSpacePos = camera.view_from_projection * vec4(cornerNdc, 1.0, 1.0);
+        vec3 ray = viewSpacePos.xyz / viewSpacePos.w;
+        ray /= ray.z;
+
+        aabbMin = min(aabbMin, min(ray * minDepth, ray * maxDepth));
+        aabbMax = max(aabbMax, max(ray * minDepth, ray * maxDepth));
+    }
+
+    vec3 clusterCenter = 0.5 * (aabbMin + aabbMax);
+    float clusterRadius = length(aabbMax - clusterCenter);
+
+    barrier();
+
+    uint totalLightCount = pointLightCount + spotLightCount;
+    for (uint lightIdx = gl_LocalInvocationIndex; lightIdx < totalLightCount; lightIdx += gl_WorkGroupSize.x)
+    {
+        bool affectsCluster;
+        if (lightIdx < pointLightCount)
+        {
+            PointLight light = pointLights[lightIdx];
+            affectsCluster = sphereIntersectsAabb(light.viewPosition.xyz, light.worldPosition.w, aabbMin, aabbMax);
+        }
+        else
+        {
+            SpotLight light = spotLights[lightIdx - pointLightCount];
+            affectsCluster = coneIntersectsSphere(light.viewPosition.xyz, light.viewDirection.xyz, light.worldPosition.w,
+                                                  light.cone.x, light.cone.z, clusterCenter, clusterRadius);
+        }
+
+        if (affectsCluster)
+        {
+            uint slot = atomicAdd(sharedLightCount, 1u);
+            if (slot < LIGHT_CLUSTER_MAX_LIGHTS)
+            {
+                clusterLightIndices[clusterIdx * LIGHT_CLUSTER_MAX_LIGHTS + slot] = lightIdx;
+            }
+        }
+    }
+
+    barrier();
+
+    if (gl_LocalInvocationIndex == 0)
+    {
+        clusterLightCounts[clusterIdx] = sharedLightCount;
+    }
+}
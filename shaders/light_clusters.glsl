@@ -0,0 +1,54 @@
+#ifndef LIGHT_CLUSTERS_GLSL
+#define LIGHT_CLUSTERS_GLSL
+
+#include <shader_locations.h>
+#include <shader_constants.h>
+#include <shader_types.h>
+
+// The point & spot lights, see LocalLightPass. Cluster light indices first index the point lights and then the spot
+// lights, i.e. the spot light index is offset by the point light count.
+restrict readonly PredefinedShaderStorageBlock(PointLightBlock)
+{
+    uint pointLightCount;
+    PointLight pointLights[];
+};
+
+restrict readonly PredefinedShaderStorageBlock(SpotLightBlock)
+{
+    uint spotLightCount;
+    SpotLight spotLights[];
+};
+
+restrict PredefinedShaderStorageBlock(LightClusterBlock)
+{
+    // (can be larger than LIGHT_CLUSTER_MAX_LIGHTS if the cluster overflowed, in which case the rest are dropped)
+    uint clusterLightCounts[LIGHT_CLUSTER_COUNT];
+    uint clusterLightIndices[LIGHT_CLUSTER_COUNT * LIGHT_CLUSTER_MAX_LIGHTS];
+};
+
+// The depth slices are distributed exponentially between the near and far planes, so that clusters are roughly cubical
+int clusterSliceFromDepth(float viewDepth, vec2 nearFar)
+{
+    float slice = log(viewDepth / nearFar.x) / log(nearFar.y / nearFar.x) * float(LIGHT_CLUSTER_COUNT_Z);
+    return clamp(int(slice), 0, LIGHT_CLUSTER_COUNT_Z - 1);
+}
+
+float clusterSliceDepth(int slice, vec2 nearFar)
+{
+    return nearFar.x * pow(nearFar.y / nearFar.x, float(slice) / float(LIGHT_CLUSTER_COUNT_Z));
+}
+
+uint clusterIndex(ivec3 cluster)
+{
+    return uint(cluster.x + LIGHT_CLUSTER_COUNT_X * (cluster.y + LIGHT_CLUSTER_COUNT_Y * cluster.z));
+}
+
+// Windowed inverse square falloff, which reaches zero at the range of the light
+float distanceAttenuation(float distanceSquared, float range)
+{
+    float ratio = distanceSquared / (range * range);
+    float window = clamp(1.0 - ratio * ratio, 0.0, 1.0);
+    return (window * window) / max(distanceSquared, 0.0001);
+}
+
+#endif // LIGHT_CLUSTERS_GLSL
@@ -0,0 +1,35 @@
+#ifndef LIGHT_FORMATS_H
+#define LIGHT_FORMATS_H
+
+// Storage formats for the intermediate light buffers. Since the format qualifiers of the images in the shaders must
+// match the formats of the textures, these are selected here, visible from both C++ and GLSL. (recompile to change)
+#define LIGHT_FORMAT_RGBA32F        (0)
+#define LIGHT_FORMAT_RGBA16F        (1)
+#define LIGHT_FORMAT_R11F_G11F_B10F (2)
+
+#define LIGHT_BUFFER_FORMAT LIGHT_FORMAT_RGBA16F
+#define TAA_HISTORY_FORMAT  LIGHT_FORMAT_RGBA16F
+
+#if LIGHT_BUFFER_FORMAT == LIGHT_FORMAT_RGBA32F
+ #define LIGHT_BUFFER_IMAGE_FORMAT    rgba32f
+ #define LIGHT_BUFFER_INTERNAL_FORMAT GL_RGBA32F
+#elif LIGHT_BUFFER_FORMAT == LIGHT_FORMAT_RGBA16F
+ #define LIGHT_BUFFER_IMAGE_FORMAT    rgba16f
+ #define LIGHT_BUFFER_INTERNAL_FORMAT GL_RGBA16F
+#elif LIGHT_BUFFER_FORMAT == LIGHT_FORMAT_R11F_G11F_B10F
+ #define LIGHT_BUFFER_IMAGE_FORMAT    r11f_g11f_b10f
+ #define LIGHT_BUFFER_INTERNAL_FORMAT GL_R11F_G11F_B10F
+#endif
+
+#if TAA_HISTORY_FORMAT == LIGHT_FORMAT_RGBA32F
+ #define TAA_HISTORY_IMAGE_FORMAT    rgba32f
+ #define TAA_HISTORY_INTERNAL_FORMAT GL_RGBA32F
+#elif TAA_HISTORY_FORMAT == LIGHT_FORMAT_RGBA16F
+ #define TAA_HISTORY_IMAGE_FORMAT    rgba16f
+ #define TAA_HISTORY_INTERNAL_FORMAT GL_RGBA16F
+#elif TAA_HISTORY_FORMAT == LIGHT_FORMAT_R11F_G11F_B10F
+ #define TAA_HISTORY_IMAGE_FORMAT    r11f_g11f_b10f
+ #define TAA_HISTORY_INTERNAL_FORMAT GL_R11F_G11F_B10F
+#endif
+
+#endif // LIGHT_FORMATS_H
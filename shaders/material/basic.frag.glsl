@@ -1,9 +1,11 @@
 #version 460
 
 #include <common.glsl>
+#include <gbuffer.glsl>
 
 #include <shader_locations.h>
 #include <camera_uniforms.h>
+#include <material_table.glsl>
 
 in vec2 v_tex_coord;
 in vec3 v_position;
@@ -14,18 +16,14 @@ in vec4 v_prev_proj_pos;
 
 PredefinedUniformBlock(CameraUniformBlock, camera);
 
-uniform vec3 u_base_color;
-uniform float u_roughness;
-uniform float u_metallic;
-
 PredefinedOutput(vec4, o_g_buffer_albedo);
 PredefinedOutput(vec4, o_g_buffer_material);
 PredefinedOutput(vec4, o_g_buffer_norm_vel);
 
 void main()
 {
-    o_g_buffer_albedo = vec4(u_base_color, 1.0);
-    o_g_buffer_material = vec4(u_roughness, u_metallic, 1.0, 1.0);
+    MaterialData material = materials[u_material_index];
+    packGBufferMaterial(material.base_color.rgb, material.properties.x, material.properties.y, o_g_buffer_albedo, o_g_buffer_material);
 
     vec2 curr01Pos = (v_curr_proj_pos.xy / v_curr_proj_pos.w) * 0.5 + 0.5;
     vec2 prev01Pos = (v_prev_proj_pos.xy / v_prev_proj_pos.w) * 0.5 + 0.5;
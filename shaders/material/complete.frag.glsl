@@ -1,9 +1,13 @@
 #version 460
+#extension GL_ARB_bindless_texture : require
 
 #include <common.glsl>
+#include <gbuffer.glsl>
 
 #include <shader_locations.h>
 #include <camera_uniforms.h>
+#include <scene_uniforms.h>
+#include <material_table.glsl>
 
 in vec2 v_tex_coord;
 in vec3 v_position;
@@ -16,25 +20,50 @@ in vec4 v_curr_proj_pos;
 in vec4 v_prev_proj_pos;
 
 PredefinedUniformBlock(CameraUniformBlock, camera);
-
-uniform sampler2D u_base_color;
-uniform sampler2D u_normal_map;
-uniform sampler2D u_roughness_map;
-uniform sampler2D u_metallic_map;
+PredefinedUniformBlock(SceneUniformBlock, scene);
 
 PredefinedOutput(vec4, o_g_buffer_albedo);
 PredefinedOutput(vec4, o_g_buffer_material);
 PredefinedOutput(vec4, o_g_buffer_norm_vel);
 
+// (calculated before any non-uniform control flow)
+vec2 tex_coord_ddx;
+vec2 tex_coord_ddy;
+
+vec4 sampleMaterialMap(uvec2 handle, vec4 atlasRect, int atlasLayer, vec4 fallback)
+{
+    // A zero handle means that the texture isn't loaded yet (or doesn't exist)
+    if (handle == uvec2(0)) return fallback;
+
+    if (atlasLayer < 0)
+    {
+        return texture(sampler2D(handle), v_tex_coord);
+    }
+
+    // Atlas regions are padded with wrapped texels, so repeat manually but use the derivatives of the unwrapped
+    // coordinates. The 0.5 scale matches the -1 LOD bias that is used for regular material textures.
+    vec2 uv = atlasRect.xy + fract(v_tex_coord) * atlasRect.zw;
+    vec2 ddx = 0.5 * tex_coord_ddx * atlasRect.zw;
+    vec2 ddy = 0.5 * tex_coord_ddy * atlasRect.zw;
+    return textureGrad(sampler2DArray(handle), vec3(uv, float(atlasLayer)), ddx, ddy);
+}
+
 void main()
 {
-    o_g_buffer_albedo = texture(u_base_color, v_tex_coord);
+    MaterialData material = materials[u_material_index];
+    writeTextureFeedback(v_tex_coord, scene.frame_count);
+
+    tex_coord_ddx = dFdx(v_tex_coord);
+    tex_coord_ddy = dFdy(v_tex_coord);
+    ivec4 layers = material.map_atlas_layers;
 
-    float roughness = texture(u_roughness_map, v_tex_coord).r;
-    float metallic = texture(u_metallic_map, v_tex_coord).r;
-    o_g_buffer_material = vec4(roughness, metallic, 1.0, 1.0);
+    vec3 baseColor = sampleMaterialMap(material.base_color_map, material.base_color_map_rect, layers.x, material.base_color).rgb;
+    float roughness = sampleMaterialMap(material.roughness_map, material.roughness_map_rect, layers.z, material.properties.xxxx).r;
+    float metallic = sampleMaterialMap(material.metallic_map, material.metallic_map_rect, layers.w, material.properties.yyyy).r;
+    packGBufferMaterial(baseColor, roughness, metallic, o_g_buffer_albedo, o_g_buffer_material);
 
-    vec3 mapped_normal = unpackNormalMapNormal(texture(u_normal_map, v_tex_coord).xyz);
+    vec4 normal_sample = sampleMaterialMap(material.normal_map, material.normal_map_rect, layers.y, vec4(0.5, 0.5, 1.0, 1.0));
+    vec3 mapped_normal = unpackNormalMapNormal(normal_sample.xyz);
     mat3 tbn_matrix = createTbnMatrix(v_tangent, v_bitangent, v_normal);
     vec3 N = normalize(tbn_matrix * mapped_normal);
 
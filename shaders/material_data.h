@@ -0,0 +1,29 @@
+#ifndef MATERIAL_DATA_H
+#define MATERIAL_DATA_H
+
+// One entry in the GPU material table, indexed by u_material_index. Texture handles are ARB_bindless_texture handles
+// stored as uvec2 so that the struct can be shared with C++. A zero handle means that the constant value is used.
+struct MaterialData
+{
+    uvec2 base_color_map;
+    uvec2 normal_map;
+    uvec2 roughness_map;
+    uvec2 metallic_map;
+
+    // rgb - base color, a - unused
+    vec4 base_color;
+
+    // x - roughness, y - metallic, zw - unused
+    vec4 properties;
+
+    // For maps packed in a texture atlas (the handle is then of a sampler2DArray): xy - uv offset, zw - uv scale
+    vec4 base_color_map_rect;
+    vec4 normal_map_rect;
+    vec4 roughness_map_rect;
+    vec4 metallic_map_rect;
+
+    // Atlas layer of each map (base color, normal, roughness, metallic), or -1 if the map isn't in an atlas
+    ivec4 map_atlas_layers;
+};
+
+#endif // MATERIAL_DATA_H
@@ -0,0 +1,39 @@
+#ifndef MATERIAL_TABLE_GLSL
+#define MATERIAL_TABLE_GLSL
+
+#include <material_data.h>
+#include <shader_locations.h>
+
+// The GPU material table, see MaterialSystem
+restrict readonly PredefinedShaderStorageBlock(MaterialTableBlock)
+{
+    MaterialData materials[];
+};
+
+PredefinedUniform(int, u_material_index);
+
+// Texture streaming feedback, one entry per material. Each entry is the largest log2 texture resolution that would be
+// needed to get one texel per pixel, for the requesting fragments. See MaterialSystem & TextureSystem for the rest.
+restrict PredefinedShaderStorageBlock(TextureFeedbackBlock)
+{
+    uint requested_log2_resolution[];
+};
+
+void writeTextureFeedback(vec2 uv, int frameCount)
+{
+    // (derivatives must be calculated outside of non-uniform control flow)
+    vec2 uvFootprint = max(abs(dFdx(uv)), abs(dFdy(uv)));
+    float texelsPerPixelLog2 = -log2(max(max(uvFootprint.x, uvFootprint.y), 1.0e-6));
+
+    // Only a single pixel in every 8x8 tile writes feedback each frame, which keeps the atomic traffic low
+    ivec2 tilePixel = ivec2(gl_FragCoord.xy) % ivec2(8);
+    ivec2 activePixel = ivec2(frameCount % 8, (frameCount / 8) % 8);
+
+    if (tilePixel == activePixel)
+    {
+        uint requested = uint(clamp(ceil(texelsPerPixelLog2), 0.0, 15.0));
+        atomicMax(requested_log2_resolution[u_material_index], requested);
+    }
+}
+
+#endif // MATERIAL_TABLE_GLSL
@@ -0,0 +1,148 @@
+#version 460
+
+#include <common.glsl>
+#include <exposure.glsl>
+#include <camera_uniforms.h>
+#include <shader_locations.h>
+
+//
+// Generates the whole bloom downsample pyramid (mip 0 to 6) in a single dispatch, in the style of AMD's FidelityFX
+// Single Pass Downsampler. Every work group reduces a 64x64 tile of mip 0 down to a single texel of mip 6, keeping the
+// intermediate levels in shared memory. Since the pyramid is only six levels deep no work group ever needs the results
+// of another one, so the final global synchronization step of SPD isn't needed here.
+//
+
+layout(
+    local_size_x = 16,
+    local_size_y = 16
+) in;
+
+PredefinedUniformBlock(CameraUniformBlock, camera);
+
+PredefinedUniform(sampler2D, u_texture);
+
+// Expose the light buffer while reading it, for when it isn't exposed in place before the bloom (see FinalPass)
+uniform bool u_apply_exposure = false;
+
+// The rendered part of the light buffer, for dynamic resolution (the pyramid itself is always at output resolution)
+uniform vec2 u_uv_scale = vec2(1.0);
+
+// Pixels darker than this don't contribute to the bloom (with 0 all light is kept)
+uniform float u_threshold;
+
+layout(binding = 0, rgba16f) restrict writeonly uniform image2D img_mip0;
+layout(binding = 1, rgba16f) restrict writeonly uniform image2D img_mip1;
+layout(binding = 2, rgba16f) restrict writeonly uniform image2D img_mip2;
+layout(binding = 3, rgba16f) restrict writeonly uniform image2D img_mip3;
+layout(binding = 4, rgba16f) restrict writeonly uniform image2D img_mip4;
+layout(binding = 5, rgba16f) restrict writeonly uniform image2D img_mip5;
+layout(binding = 6, rgba16f) restrict writeonly uniform image2D img_mip6;
+
+// One texel of mip 2 per invocation, which is then reduced in place
+shared vec3 sharedTexels[16][16];
+
+vec3 thresholded(vec3 color)
+{
+    float brightness = max(color.r, max(color.g, color.b));
+    float contribution = max(brightness - u_threshold, 0.0) / max(brightness, 0.00001);
+    return color * contribution;
+}
+
+// Luminance weighted average for the first downsample, which keeps single very bright pixels from flickering as the
+// camera moves. See https://www.iryoku.com/next-generation-post-processing-in-call-of-duty-advanced-warfare
+vec3 karisAverage(vec3 a, vec3 b, vec3 c, vec3 d)
+{
+    float wa = 1.0 / (1.0 + luminance(a));
+    float wb = 1.0 / (1.0 + luminance(b));
+    float wc = 1.0 / (1.0 + luminance(c));
+    float wd = 1.0 / (1.0 + luminance(d));
+    return (a * wa + b * wb + c * wc + d * wd) / (wa + wb + wc + wd);
+}
+
+void storeIfInside(writeonly image2D image, ivec2 coord, vec3 color)
+{
+    ivec2 size = imageSize(image);
+    if (coord.x < size.x && coord.y < size.y)
+    {
+        imageStore(image, coord, vec4(color, 1.0));
+    }
+}
+
+void main()
+{
+    ivec2 local = ivec2(gl_LocalInvocationID.xy);
+    ivec2 mip0Size = imageSize(img_mip0);
+    vec2 mip0TexelSize = vec2(1.0) / vec2(mip0Size);
+    float exposure = u_apply_exposure ? computeExposure(camera) : 1.0;
+
+    //
+    // Mip 0 & 1: each invocation loads a 4x4 block of mip 0 (with the threshold applied), which becomes 2x2 of mip 1
+    //
+
+    ivec2 blockOrigin = ivec2(gl_WorkGroupID.xy) * 64 + local * 4;
+
+    vec3 mip1Texels[2][2];
+    for (int y = 0; y < 2; ++y)
+    {
+        for (int x = 0; x < 2; ++x)
+        {
+            vec3 quad[4];
+            for (int i = 0; i < 4; ++i)
+            {
+                ivec2 coord = blockOrigin + 2 * ivec2(x, y) + ivec2(i & 1, i >> 1);
+                vec2 uv = (vec2(coord) + 0.5) * mip0TexelSize;
+                quad[i] = thresholded(exposure * textureLod(u_texture, uv * u_uv_scale, 0.0).rgb);
+                storeIfInside(img_mip0, coord, quad[i]);
+            }
+
+            mip1Texels[y][x] = karisAverage(quad[0], quad[1], quad[2], quad[3]);
+            storeIfInside(img_mip1, blockOrigin / 2 + ivec2(x, y), mip1Texels[y][x]);
+        }
+    }
+
+    //
+    // Mip 2: one texel per invocation
+    //
+
+    ivec2 tileOrigin = ivec2(gl_WorkGroupID.xy) * 16;
+
+    vec3 mip2Texel = 0.25 * (mip1Texels[0][0] + mip1Texels[0][1] + mip1Texels[1][0] + mip1Texels[1][1]);
+    storeIfInside(img_mip2, tileOrigin + local, mip2Texel);
+    sharedTexels[local.y][local.x] = mip2Texel;
+
+    //
+    // Mip 3 to 6: halve the number of active invocations in each dimension for every level
+    //
+
+    for (int level = 3; level <= 6; ++level)
+    {
+        barrier();
+
+        int activeSize = 16 >> (level - 2);
+        vec3 texel = vec3(0.0);
+        bool active = local.x < activeSize && local.y < activeSize;
+        if (active)
+        {
+            ivec2 source = local * 2;
+            texel = 0.25 * (sharedTexels[source.y][source.x] + sharedTexels[source.y][source.x + 1]
+                          + sharedTexels[source.y + 1][source.x] + sharedTexels[source.y + 1][source.x + 1]);
+
+            ivec2 coord = (tileOrigin >> (level - 2)) + local;
+            switch (level)
+            {
+                case 3: storeIfInside(img_mip3, coord, texel); break;
+                case 4: storeIfInside(img_mip4, coord, texel); break;
+                case 5: storeIfInside(img_mip5, coord, texel); break;
+                case 6: storeIfInside(img_mip6, coord, texel); break;
+            }
+        }
+
+        // (all reads of this level must be done before any invocation overwrites it)
+        barrier();
+
+        if (active)
+        {
+            sharedTexels[local.y][local.x] = texel;
+        }
+    }
+}
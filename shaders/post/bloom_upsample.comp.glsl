@@ -0,0 +1,59 @@
+#version 460
+
+#include <shader_locations.h>
+
+//
+// Compute version of bloom_upsample.frag.glsl, i.e. one level of the upsample chain: the lower (already upsampled)
+// level is blurred with a tent filter and added to the downsampled texture of this level.
+//
+
+layout(
+    local_size_x = 8,
+    local_size_y = 8
+) in;
+
+PredefinedUniform(sampler2D, u_texture);
+uniform sampler2D u_texture_to_blur;
+uniform float u_texel_aspect;
+uniform float u_blur_radius;
+uniform int u_target_lod;
+
+layout(binding = 0, rgba16f) restrict writeonly uniform image2D img_target;
+
+vec4 tent3x3Upsample(vec2 uv, vec2 offset, float sampleLod)
+{
+    vec2 off = offset;
+
+    vec4 color = 6.0 * textureLod(u_texture_to_blur, uv, sampleLod);
+
+    color += 2.0 * textureLod(u_texture_to_blur, uv + vec2(-off.x, 0.0), sampleLod);
+    color += 2.0 * textureLod(u_texture_to_blur, uv + vec2(+off.x, 0.0), sampleLod);
+    color += 2.0 * textureLod(u_texture_to_blur, uv + vec2(0.0, -off.y), sampleLod);
+    color += 2.0 * textureLod(u_texture_to_blur, uv + vec2(0.0, +off.y), sampleLod);
+
+    color += 1.0 * textureLod(u_texture_to_blur, uv + vec2(-off.x, -off.y), sampleLod);
+    color += 1.0 * textureLod(u_texture_to_blur, uv + vec2(-off.x, +off.y), sampleLod);
+    color += 1.0 * textureLod(u_texture_to_blur, uv + vec2(+off.x, -off.y), sampleLod);
+    color += 1.0 * textureLod(u_texture_to_blur, uv + vec2(+off.x, +off.y), sampleLod);
+
+    return color / vec4(18.0);
+}
+
+void main()
+{
+    ivec2 pixelCoord = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 targetSize = imageSize(img_target);
+
+    if (pixelCoord.x < targetSize.x && pixelCoord.y < targetSize.y)
+    {
+        vec2 uv = (vec2(pixelCoord) + 0.5) / vec2(targetSize);
+
+        float sampleLod = float(u_target_lod + 1);
+        vec2 offset = vec2(1.0, u_texel_aspect) * vec2(u_blur_radius);
+        vec4 blurred = tent3x3Upsample(uv, offset, sampleLod);
+
+        vec4 current = textureLod(u_texture, uv, float(u_target_lod));
+
+        imageStore(img_target, pixelCoord, current + blurred);
+    }
+}
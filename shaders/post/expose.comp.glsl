@@ -1,10 +1,11 @@
 #version 460
 
 #include <common.glsl>
+#include <exposure.glsl>
 #include <scene_uniforms.h>
-#include <camera_model.glsl>
 #include <camera_uniforms.h>
 #include <shader_locations.h>
+#include <light_formats.h>
 
 layout(
     local_size_x = 32,
@@ -14,10 +15,7 @@ layout(
 PredefinedUniformBlock(CameraUniformBlock, camera);
 PredefinedUniformBlock(SceneUniformBlock, scene);
 
-layout(binding = 0, rgba32f) restrict uniform image2D img_light_buffer;
-
-layout(binding = 1, r32f) restrict readonly uniform image2D img_avg_log_lum;
-layout(binding = 2, r32f) restrict          uniform image2D img_history_lum;
+layout(binding = 0, LIGHT_BUFFER_IMAGE_FORMAT) restrict uniform image2D img_light_buffer;
 
 void main()
 {
@@ -27,39 +25,7 @@ void main()
     if (pixelCoord.x < imagePx.x && pixelCoord.y < imagePx.y)
     {
         vec3 hdrColor = imageLoad(img_light_buffer, pixelCoord).rgb;
-
-        if (camera.use_automatic_exposure)
-        {
-            // Read current average luminance
-            float avgLogLuminance = imageLoad(img_avg_log_lum, ivec2(0)).r;
-            float avgLuminance = exp(avgLogLuminance);
-
-            // Read history of average luminances
-            float histLuminance = imageLoad(img_history_lum, ivec2(0)).r;
-
-            // Compute the actual luminance to use, from history & current, and write back to next history sample
-            float realLuminance = histLuminance + (avgLuminance - histLuminance)
-                                                * (1.0 - exp(-scene.delta_time * camera.adaption_rate));
-            imageStore(img_history_lum, ivec2(0), vec4(realLuminance));
-
-            float ev100 = computeEV100FromAvgLuminance(realLuminance);
-            ev100 -= camera.exposure_compensation;
-
-            float exposure = convertEV100ToExposure(ev100);
-            hdrColor *= exposure;
-        }
-        else
-        {
-            float ev100 = computeEV100(camera.aperture, camera.shutter_speed, camera.iso);
-            float exposure = convertEV100ToExposure(ev100);
-            hdrColor *= exposure;
-
-            //
-            // Why is this needed?!
-            // (well I guess I don't use physically based light light intensities..)
-            //
-            hdrColor *= 12000.0;
-        }
+        hdrColor *= computeExposure(camera);
 
         // TODO: Maybe we wanna put the luminance in alpha or something like that?
         imageStore(img_light_buffer, pixelCoord, vec4(hdrColor, 1.0));
@@ -0,0 +1,69 @@
+#version 460
+
+#include <exposure.glsl>
+#include <scene_uniforms.h>
+#include <camera_uniforms.h>
+#include <shader_locations.h>
+
+// A single work group, with one invocation per bin
+layout(
+    local_size_x = EXPOSURE_HISTOGRAM_BIN_COUNT
+) in;
+
+PredefinedUniformBlock(CameraUniformBlock, camera);
+PredefinedUniformBlock(SceneUniformBlock, scene);
+
+// Only the pixels between these percentiles (ignoring black pixels) are metered, so that small very dark or very bright
+// parts of the screen don't affect the exposure.
+uniform float u_low_percentile;
+uniform float u_high_percentile;
+
+shared uint localHistogram[EXPOSURE_HISTOGRAM_BIN_COUNT];
+
+void main()
+{
+    uint bin = gl_LocalInvocationIndex;
+    localHistogram[bin] = histogram[bin];
+
+    // Clear for the next frame
+    histogram[bin] = 0;
+
+    barrier();
+
+    if (bin == 0)
+    {
+        uint totalCount = 0;
+        for (uint i = 1; i < EXPOSURE_HISTOGRAM_BIN_COUNT; ++i)
+        {
+            totalCount += localHistogram[i];
+        }
+
+        float lowCount = u_low_percentile * float(totalCount);
+        float highCount = u_high_percentile * float(totalCount);
+
+        // Average the log2 luminance of the pixels that fall within the percentiles
+        float accumulatedCount = 0.0;
+        float weightedLog2Luminance = 0.0;
+        float totalWeight = 0.0;
+        for (uint i = 1; i < EXPOSURE_HISTOGRAM_BIN_COUNT; ++i)
+        {
+            float binCount = float(localHistogram[i]);
+            float weight = max(min(accumulatedCount + binCount, highCount) - max(accumulatedCount, lowCount), 0.0);
+            weightedLog2Luminance += weight * histogramBinLog2Luminance(i);
+            totalWeight += weight;
+            accumulatedCount += binCount;
+        }
+
+        float historyLuminance = adaptedLuminance;
+        float averageLuminance = (totalWeight > 0.0) ? exp2(weightedLog2Luminance / totalWeight) : historyLuminance;
+
+        // (the history starts out as zero, and shouldn't fade in from black)
+        if (historyLuminance <= 0.0)
+        {
+            historyLuminance = averageLuminance;
+        }
+
+        adaptedLuminance = historyLuminance + (averageLuminance - historyLuminance)
+                                            * (1.0 - exp(-scene.delta_time * camera.adaption_rate));
+    }
+}
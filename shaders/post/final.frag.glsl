@@ -19,7 +19,11 @@ uniform float u_bloom_amount;
 uniform float u_vignette_falloff;
 uniform float u_gamma;
 
-uniform int u_tonemap_operator_selector;
+// (selected through program permutations, see FinalPass)
+// permutation: TONEMAP_OPERATOR 0 1 2 3
+#ifndef TONEMAP_OPERATOR
+ #define TONEMAP_OPERATOR TONEMAP_OP_ACES
+#endif
 
 PredefinedOutput(vec4, o_color);
 
@@ -33,25 +37,15 @@ void main()
     float aspectRatio = camera.projection_from_view[1][1] / camera.projection_from_view[0][0];
     hdrColor *= naturalVignetting(u_vignette_falloff, aspectRatio, v_uv);
 
-    vec3 ldrColor;
-    switch (u_tonemap_operator_selector)
-    {
-        case TONEMAP_OP_ACES:
-            ldrColor = ACES_tonemap(hdrColor);
-            break;
-
-        case TONEMAP_OP_REINHARD:
-            ldrColor = hdrColor / (vec3(1.0) + hdrColor);
-            break;
-
-        case TONEMAP_OP_UNCHARTED_2:
-            ldrColor = uncharted2Tonemap(hdrColor);
-            break;
-
-        case TONEMAP_OP_CLAMP:
-            ldrColor = hdrColor;
-            break;
-    }
+#if TONEMAP_OPERATOR == TONEMAP_OP_ACES
+    vec3 ldrColor = ACES_tonemap(hdrColor);
+#elif TONEMAP_OPERATOR == TONEMAP_OP_REINHARD
+    vec3 ldrColor = hdrColor / (vec3(1.0) + hdrColor);
+#elif TONEMAP_OPERATOR == TONEMAP_OP_UNCHARTED_2
+    vec3 ldrColor = uncharted2Tonemap(hdrColor);
+#elif TONEMAP_OPERATOR == TONEMAP_OP_CLAMP
+    vec3 ldrColor = hdrColor;
+#endif
 
     vec3 gammaCorrectLdr = gammaAdust(ldrColor, u_gamma);
 
@@ -0,0 +1,175 @@
+#version 460
+
+#include <common.glsl>
+#include <exposure.glsl>
+#include <shader_locations.h>
+#include <shader_constants.h>
+#include <camera_uniforms.h>
+#include <scene_uniforms.h>
+#include <camera_model.glsl>
+#include <temporal_upsample.glsl>
+#include <light_formats.h>
+#include <etc/aces.glsl>
+
+//
+// Exposure, TAA resolve, bloom composite, vignetting & tonemapping in a single pass, i.e. expose.comp.glsl,
+// temporal_aa.comp.glsl and final.frag.glsl in sequence (which are kept as a debug path, see FinalPass). The light
+// buffer is only read once and never written back, and the only other full resolution write is the TAA history.
+// Every work group loads its tile of the light buffer plus a one pixel border into shared memory, exposed, which is
+// then used for the neighbourhood clamp of the TAA. With dynamic resolution the tile covers the (smaller) footprint of
+// the output pixels in the light buffer, plus a border, and the TAA resolve also upsamples.
+//
+
+layout(
+    local_size_x = 16,
+    local_size_y = 16
+) in;
+
+#define TILE_SIZE (16)
+
+// (one pixel of border on each side, plus one pixel of margin in case of rounding in the footprint calculations)
+#define BORDERED_TILE_SIZE (TILE_SIZE + 3)
+
+PredefinedUniformBlock(CameraUniformBlock, camera);
+PredefinedUniformBlock(SceneUniformBlock, scene);
+
+layout(binding = 0, TAA_HISTORY_IMAGE_FORMAT)  restrict writeonly uniform image2D img_history_dst;
+layout(binding = 1, LIGHT_BUFFER_IMAGE_FORMAT) restrict readonly  uniform image2D img_light_buffer;
+layout(binding = 2, rgba16f)                   restrict readonly  uniform image2D img_norm_vel;
+layout(binding = 3, rgba8)                     restrict writeonly uniform image2D img_output;
+
+uniform sampler2D u_history_texture;
+uniform sampler2D u_bloom_texture;
+
+uniform bool u_taa_enabled = true;
+uniform float u_history_blend = 0.05;
+uniform bool u_first_frame = true;
+
+uniform float u_bloom_amount;
+uniform float u_vignette_falloff;
+uniform float u_gamma;
+
+// (selected through program permutations, see FinalPass)
+// permutation: TONEMAP_OPERATOR 0 1 2 3
+#ifndef TONEMAP_OPERATOR
+ #define TONEMAP_OPERATOR TONEMAP_OP_ACES
+#endif
+
+shared vec3 exposedTile[BORDERED_TILE_SIZE][BORDERED_TILE_SIZE];
+
+void main()
+{
+    ivec2 outputPx = imageSize(img_output);
+    ivec2 renderPx = scene.render_size;
+    bool upsampling = any(notEqual(renderPx, outputPx));
+
+    // (one uniform value for the whole dispatch, so it's the same for all invocations)
+    float exposure = computeExposure(camera);
+
+    // The tile starts one pixel before the render pixel closest to the first output pixel of the work group
+    vec2 unusedOffset;
+    ivec2 firstOutputPixel = ivec2(gl_WorkGroupID.xy) * TILE_SIZE;
+    vec2 firstOutputUv = (vec2(firstOutputPixel) + 0.5) / vec2(outputPx);
+    ivec2 tileOrigin = closestRenderPixel(firstOutputUv, renderPx, camera.frustum_jitter.zw, unusedOffset) - ivec2(1);
+
+    for (uint i = gl_LocalInvocationIndex; i < BORDERED_TILE_SIZE * BORDERED_TILE_SIZE; i += TILE_SIZE * TILE_SIZE)
+    {
+        ivec2 tileCoord = ivec2(i % BORDERED_TILE_SIZE, i / BORDERED_TILE_SIZE);
+        ivec2 coord = clamp(tileOrigin + tileCoord, ivec2(0), renderPx - 1);
+        exposedTile[tileCoord.y][tileCoord.x] = exposure * imageLoad(img_light_buffer, coord).rgb;
+    }
+
+    barrier();
+
+    ivec2 pixelCoord = ivec2(gl_GlobalInvocationID.xy);
+    if (pixelCoord.x >= outputPx.x || pixelCoord.y >= outputPx.y)
+    {
+        return;
+    }
+
+    vec2 uv = (vec2(pixelCoord) + 0.5) / vec2(outputPx);
+
+    vec2 sampleOffset;
+    ivec2 renderCoord = closestRenderPixel(uv, renderPx, camera.frustum_jitter.zw, sampleOffset);
+    ivec2 local = renderCoord - tileOrigin;
+
+    vec3 hdrColor = exposedTile[local.y][local.x];
+
+    //
+    // TAA resolve, see temporal_aa.comp.glsl
+    //
+
+    if (u_taa_enabled)
+    {
+        vec3 nmin = hdrColor;
+        vec3 nmax = hdrColor;
+        vec3 reconstructed = vec3(0.0);
+        float totalWeight = 0.0;
+
+        for (int y = -1; y <= 1; ++y)
+        {
+            for (int x = -1; x <= 1; ++x)
+            {
+                vec3 neighbour = exposedTile[local.y + y][local.x + x];
+                nmin = min(nmin, neighbour);
+                nmax = max(nmax, neighbour);
+
+                float weight = upsampleSampleWeight(sampleOffset - vec2(x, y));
+                reconstructed += weight * neighbour;
+                totalWeight += weight;
+            }
+        }
+
+        if (upsampling)
+        {
+            hdrColor = reconstructed / totalWeight;
+        }
+
+        if (!u_first_frame)
+        {
+            vec2 velocity = imageLoad(img_norm_vel, renderCoord).zw;
+            vec2 histUv = uv - velocity;
+
+            vec3 histSample = textureLod(u_history_texture, histUv, 0).rgb;
+            histSample = clamp(histSample, nmin, nmax);
+
+            float historyBlend = u_history_blend;
+            if (upsampling)
+            {
+                historyBlend *= upsampleSampleWeight(sampleOffset);
+            }
+
+            // if history sample is outside screen, switch to aliased image as a fallback.
+            bool outsideScreen = any(greaterThan(histUv, vec2(1.0))) || any(lessThan(histUv, vec2(0.0)));
+            float blend = outsideScreen ? 1.0 : historyBlend;
+
+            hdrColor = mix(histSample, hdrColor, vec3(blend));
+        }
+
+        imageStore(img_history_dst, pixelCoord, vec4(hdrColor, 1.0));
+    }
+
+    //
+    // Bloom, vignette & tonemapping, see final.frag.glsl
+    //
+
+    vec3 bloom = textureLod(u_bloom_texture, uv, 0.0).rgb;
+    hdrColor = mix(hdrColor, bloom, u_bloom_amount);
+
+    float aspectRatio = camera.projection_from_view[1][1] / camera.projection_from_view[0][0];
+    hdrColor *= naturalVignetting(u_vignette_falloff, aspectRatio, uv);
+
+#if TONEMAP_OPERATOR == TONEMAP_OP_ACES
+    vec3 ldrColor = ACES_tonemap(hdrColor);
+#elif TONEMAP_OPERATOR == TONEMAP_OP_REINHARD
+    vec3 ldrColor = hdrColor / (vec3(1.0) + hdrColor);
+#elif TONEMAP_OPERATOR == TONEMAP_OP_UNCHARTED_2
+    vec3 ldrColor = uncharted2Tonemap(hdrColor);
+#elif TONEMAP_OPERATOR == TONEMAP_OP_CLAMP
+    vec3 ldrColor = hdrColor;
+#endif
+
+    vec3 gammaCorrectLdr = gammaAdust(ldrColor, u_gamma);
+
+    imageStore(img_output, pixelCoord, vec4(gammaCorrectLdr, 1.0));
+}
@@ -0,0 +1,43 @@
+#version 460
+
+#include <common.glsl>
+#include <exposure.glsl>
+#include <light_formats.h>
+#include <scene_uniforms.h>
+#include <shader_locations.h>
+
+layout(
+    local_size_x = 16,
+    local_size_y = 16
+) in;
+
+PredefinedUniformBlock(SceneUniformBlock, scene);
+
+layout(binding = 0, LIGHT_BUFFER_IMAGE_FORMAT) restrict readonly uniform image2D img_light_buffer;
+
+// (one invocation per bin, so the work group size must match)
+shared uint localHistogram[EXPOSURE_HISTOGRAM_BIN_COUNT];
+
+void main()
+{
+    localHistogram[gl_LocalInvocationIndex] = 0;
+    barrier();
+
+    // Bin the pixels in shared memory first, so that there is only a single global atomic per bin & work group
+    ivec2 pixelCoord = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 renderPx = scene.render_size;
+    if (pixelCoord.x < renderPx.x && pixelCoord.y < renderPx.y)
+    {
+        vec3 color = imageLoad(img_light_buffer, pixelCoord).rgb;
+        uint bin = histogramBinFromLuminance(luminance(color));
+        atomicAdd(localHistogram[bin], 1u);
+    }
+
+    barrier();
+
+    uint count = localHistogram[gl_LocalInvocationIndex];
+    if (count > 0)
+    {
+        atomicAdd(histogram[gl_LocalInvocationIndex], count);
+    }
+}
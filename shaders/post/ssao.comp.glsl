@@ -25,6 +25,13 @@ PredefinedUniform(sampler2D, u_g_buffer_depth);
 PredefinedNoiseImage(img_blue_noise);
 layout(binding = 0, r16f) restrict writeonly uniform image2D img_occlusion;
 
+// Samples per pixel and frame. With fewer samples than in the kernel every frame uses a different (interleaved) subset
+// of it, so that the temporal accumulation eventually sees all of them.
+uniform int u_sample_count = SSAO_KERNEL_SAMPLE_COUNT;
+
+// The part of img_occlusion (and of the depth & normal textures) to compute, for dynamic resolution
+uniform ivec2 u_render_size;
+
 vec3 project(vec3 vsPos)
 {
     vec4 projPos = camera.projection_from_view * vec4(vsPos, 1.0);
@@ -40,14 +47,13 @@ vec3 unproject(vec3 projPos)
 void main()
 {
     ivec2 pixelCoord = ivec2(gl_GlobalInvocationID.xy);
-    ivec2 imagePx = imageSize(img_occlusion);
-
-    if (pixelCoord.x < imagePx.x && pixelCoord.y < imagePx.y)
+    if (pixelCoord.x < u_render_size.x && pixelCoord.y < u_render_size.y)
     {
         vec3 N = octahedralDecode(texelFetch(u_g_buffer_norm_vel, pixelCoord, 0).xy);
         float depth = texelFetch(u_g_buffer_depth, pixelCoord, 0).r;
 
-        vec2 uv = (vec2(pixelCoord) + vec2(0.5)) / imageSize(img_occlusion);
+        vec2 uv = (vec2(pixelCoord) + vec2(0.5)) / vec2(u_render_size);
+        vec2 textureUvScale = vec2(u_render_size) / vec2(textureSize(u_g_buffer_depth, 0));
 
         // Get view space position of fragment
         vec3 origin = unproject(vec3(uv * vec2(2.0) - vec2(1.0), depth * 2.0 - 1.0));
@@ -78,9 +84,14 @@ void main()
 
         mat3 kernelTransform = tbn * noiseRotation;
 
+        int kernelStride = SSAO_KERNEL_SAMPLE_COUNT / u_sample_count;
+        int kernelOffset = scene.frame_count % kernelStride;
+
         float occlusion = 0.0;
-        for (int i = 0; i < SSAO_KERNEL_SAMPLE_COUNT; ++i)
+        for (int j = 0; j < u_sample_count; ++j)
         {
+            int i = j * kernelStride + kernelOffset;
+
             // Calculate sample view space position
             vec3 samplePos = kernelTransform *  ssao.kernel[i].xyz;
             samplePos = origin + (samplePos * ssao.kernel_radius);
@@ -89,14 +100,14 @@ void main()
             // Get actual/reference depth at sample
             vec3 projSamplePos = project(samplePos);
             vec2 sampleUv = projSamplePos.xy * vec2(0.5) + vec2(0.5);
-            float projReferenceDepth = texture(u_g_buffer_depth, sampleUv).r;
+            float projReferenceDepth = texture(u_g_buffer_depth, sampleUv * textureUvScale).r;
             vec3 vsRefPosition = unproject(vec3(projSamplePos.xy, projReferenceDepth * 2.0 - 1.0));
             float vsReferenceDepth = vsRefPosition.z;
 
             float rangeCheck = smoothstep(0.0, 1.0, ssao.kernel_radius / abs(origin.z - vsReferenceDepth));
             occlusion += (vsSampleDepth > vsReferenceDepth ? 1.0 : 0.0) * rangeCheck;
         }
-        occlusion /= float(SSAO_KERNEL_SAMPLE_COUNT);
+        occlusion /= float(u_sample_count);
 
         // Intensify the ambient occlusion, i.e. make occluded parts darker
         occlusion = pow(1.0 - occlusion, ssao.intensity);
@@ -0,0 +1,63 @@
+#version 460
+
+//
+// Separable depth aware (bilateral) blur of the half resolution occlusion, run once per direction. Every work group
+// blurs a line of 64 pixels, which are loaded (with their neighbours) into shared memory once instead of once per tap.
+// The source and target are both RG16F, with the occlusion in r and the view depth in g.
+//
+
+layout(
+    local_size_x = 64
+) in;
+
+#define BLUR_RADIUS 4
+#define TILE_SIZE (64 + 2 * BLUR_RADIUS)
+
+// (1, 0) for the horizontal pass and (0, 1) for the vertical pass
+uniform ivec2 u_direction;
+
+layout(binding = 0, rg16f) restrict writeonly uniform image2D img_target;
+layout(binding = 1, rg16f) restrict readonly  uniform image2D img_source;
+
+shared vec2 tile[TILE_SIZE];
+
+void main()
+{
+    ivec2 imagePx = imageSize(img_source);
+    int localIdx = int(gl_LocalInvocationID.x);
+
+    // The work group x is along the blur direction, and y is across it
+    ivec2 lineOrigin = int(gl_WorkGroupID.y) * (ivec2(1) - u_direction) + int(gl_WorkGroupID.x) * 64 * u_direction;
+
+    for (int i = localIdx; i < TILE_SIZE; i += 64)
+    {
+        ivec2 coord = clamp(lineOrigin + (i - BLUR_RADIUS) * u_direction, ivec2(0), imagePx - 1);
+        tile[i] = imageLoad(img_source, coord).rg;
+    }
+
+    barrier();
+
+    ivec2 pixelCoord = lineOrigin + localIdx * u_direction;
+    if (pixelCoord.x < imagePx.x && pixelCoord.y < imagePx.y)
+    {
+        vec2 center = tile[localIdx + BLUR_RADIUS];
+        float depthTolerance = 0.02 * center.g;
+
+        float occlusion = 0.0;
+        float totalWeight = 0.0;
+        for (int offset = -BLUR_RADIUS; offset <= BLUR_RADIUS; ++offset)
+        {
+            vec2 tap = tile[localIdx + BLUR_RADIUS + offset];
+
+            // Gaussian falloff (sigma = radius / 2), times a falloff for taps on other surfaces
+            float spatialWeight = exp(-2.0 * float(offset * offset) / float(BLUR_RADIUS * BLUR_RADIUS));
+            float depthWeight = exp(-abs(tap.g - center.g) / depthTolerance);
+            float weight = spatialWeight * depthWeight;
+
+            occlusion += weight * tap.r;
+            totalWeight += weight;
+        }
+
+        imageStore(img_target, pixelCoord, vec4(occlusion / totalWeight, center.g, 0.0, 0.0));
+    }
+}
@@ -7,7 +7,15 @@ layout(
     local_size_y = 32
 ) in;
 
-layout(binding = 0, r16f) restrict uniform image2D img_occlusion;
+// (reads from a separate image, so that no invocation can read what another one has already blurred)
+layout(binding = 0, r16f) restrict writeonly uniform image2D img_occlusion;
+layout(binding = 1, r16f) restrict readonly  uniform image2D img_source;
+
+// 0 - fast 3x3 blur, 1 - wider (better but slower) 5x5 blur. Selected through program permutations, see SSAOPass.
+// permutation: SSAO_BLUR_QUALITY 0 1
+#ifndef SSAO_BLUR_QUALITY
+ #define SSAO_BLUR_QUALITY 1
+#endif
 
 void main()
 {
@@ -16,22 +24,22 @@ void main()
 
     if (pixelCoord.x < imagePx.x && pixelCoord.y < imagePx.y)
     {
-#if 0
+#if SSAO_BLUR_QUALITY == 0
 
-        float occlusionCenter = imageLoad(img_occlusion, pixelCoord).r;
+        float occlusionCenter = imageLoad(img_source, pixelCoord).r;
 
         vec4 occlusionPlus = vec4(
-            imageLoad(img_occlusion, pixelCoord + ivec2(+1,  0)).r,
-            imageLoad(img_occlusion, pixelCoord + ivec2(-1,  0)).r,
-            imageLoad(img_occlusion, pixelCoord + ivec2( 0, +1)).r,
-            imageLoad(img_occlusion, pixelCoord + ivec2( 0, -1)).r
+            imageLoad(img_source, pixelCoord + ivec2(+1,  0)).r,
+            imageLoad(img_source, pixelCoord + ivec2(-1,  0)).r,
+            imageLoad(img_source, pixelCoord + ivec2( 0, +1)).r,
+            imageLoad(img_source, pixelCoord + ivec2( 0, -1)).r
         );
 
         vec4 occlusionCross = vec4(
-            imageLoad(img_occlusion, pixelCoord + ivec2(+1, +1)).r,
-            imageLoad(img_occlusion, pixelCoord + ivec2(+1, -1)).r,
-            imageLoad(img_occlusion, pixelCoord + ivec2(-1, +1)).r,
-            imageLoad(img_occlusion, pixelCoord + ivec2(-1, -1)).r
+            imageLoad(img_source, pixelCoord + ivec2(+1, +1)).r,
+            imageLoad(img_source, pixelCoord + ivec2(+1, -1)).r,
+            imageLoad(img_source, pixelCoord + ivec2(-1, +1)).r,
+            imageLoad(img_source, pixelCoord + ivec2(-1, -1)).r
         );
 
         float occlusion = 0.55 * occlusionCenter
@@ -41,7 +49,7 @@ void main()
         imageStore(img_occlusion, pixelCoord, vec4(occlusion));
 
 #else
-        // Alternative and better but slower blur:
+        // Better but slower blur:
         const int k = 2;
 
         float o = 0.0;
@@ -55,7 +63,7 @@ void main()
                 float weight = 1.0 + float(k*k) - length(vec2(i, j));
                 totalWeight += weight;
 
-                o += weight * imageLoad(img_occlusion, pixelCoord + ivec2(i, j)).r;
+                o += weight * imageLoad(img_source, pixelCoord + ivec2(i, j)).r;
             }
         }
         o /= totalWeight;
@@ -0,0 +1,57 @@
+#version 460
+
+#include <shader_locations.h>
+
+//
+// Compares the occlusion of the SSAO performance mode against the full resolution reference, see SSAOPass
+//
+
+layout(
+    local_size_x = 16,
+    local_size_y = 16
+) in;
+
+layout(binding = 0, r16f) restrict readonly uniform image2D img_occlusion;
+layout(binding = 1, r16f) restrict readonly uniform image2D img_reference;
+
+restrict PredefinedShaderStorageBlock(SSAOComparisonBlock)
+{
+    // Sum of absolute differences, in 1/255 units
+    uint absoluteDifferenceSum;
+
+    // Number of pixels that differ by more than 0.1
+    uint largeDifferenceCount;
+};
+
+shared uint localDifferenceSum;
+shared uint localLargeDifferenceCount;
+
+void main()
+{
+    if (gl_LocalInvocationIndex == 0)
+    {
+        localDifferenceSum = 0;
+        localLargeDifferenceCount = 0;
+    }
+    barrier();
+
+    ivec2 pixelCoord = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 imagePx = imageSize(img_occlusion);
+    if (pixelCoord.x < imagePx.x && pixelCoord.y < imagePx.y)
+    {
+        float difference = abs(imageLoad(img_occlusion, pixelCoord).r - imageLoad(img_reference, pixelCoord).r);
+        atomicAdd(localDifferenceSum, uint(round(clamp(difference, 0.0, 1.0) * 255.0)));
+        if (difference > 0.1)
+        {
+            atomicAdd(localLargeDifferenceCount, 1u);
+        }
+    }
+
+    barrier();
+
+    if (gl_LocalInvocationIndex == 0)
+    {
+        atomicAdd(absoluteDifferenceSum, localDifferenceSum);
+        atomicAdd(largeDifferenceCount, localLargeDifferenceCount);
+    }
+}
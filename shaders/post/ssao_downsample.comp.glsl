@@ -0,0 +1,53 @@
+#version 460
+
+#include <shader_locations.h>
+#include <scene_uniforms.h>
+
+//
+// Downsamples the g-buffer depth & normals to half resolution for the SSAO performance mode. Every half resolution
+// pixel takes one of its four full resolution pixels (instead of an average, which would describe no actual surface),
+// alternating between the closest and the farthest in a checkerboard pattern so that both sides of depth edges exist.
+//
+
+layout(
+    local_size_x = 8,
+    local_size_y = 8
+) in;
+
+PredefinedUniformBlock(SceneUniformBlock, scene);
+
+PredefinedUniform(sampler2D, u_g_buffer_norm_vel);
+PredefinedUniform(sampler2D, u_g_buffer_depth);
+
+layout(binding = 0, r32f)    restrict writeonly uniform image2D img_half_depth;
+layout(binding = 1, rg16f)   restrict writeonly uniform image2D img_half_normal;
+
+void main()
+{
+    ivec2 pixelCoord = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 imagePx = imageSize(img_half_depth);
+
+    if (pixelCoord.x < imagePx.x && pixelCoord.y < imagePx.y)
+    {
+        ivec2 fullSize = scene.render_size;
+        bool takeClosest = ((pixelCoord.x + pixelCoord.y) & 1) == 0;
+
+        ivec2 selectedCoord = pixelCoord * 2;
+        float selectedDepth = texelFetch(u_g_buffer_depth, selectedCoord, 0).r;
+        for (int i = 1; i < 4; ++i)
+        {
+            ivec2 coord = min(pixelCoord * 2 + ivec2(i & 1, i >> 1), fullSize - 1);
+            float depth = texelFetch(u_g_buffer_depth, coord, 0).r;
+            if (takeClosest ? (depth < selectedDepth) : (depth > selectedDepth))
+            {
+                selectedDepth = depth;
+                selectedCoord = coord;
+            }
+        }
+
+        vec2 packedNormal = texelFetch(u_g_buffer_norm_vel, selectedCoord, 0).xy;
+
+        imageStore(img_half_depth, pixelCoord, vec4(selectedDepth));
+        imageStore(img_half_normal, pixelCoord, vec4(packedNormal, 0.0, 0.0));
+    }
+}
@@ -0,0 +1,64 @@
+#version 460
+
+#include <shader_locations.h>
+#include <camera_uniforms.h>
+#include <scene_uniforms.h>
+
+//
+// Accumulates the half resolution occlusion over time, reprojected with the g-buffer velocities. The history also
+// stores the view depth of every pixel, which is used to reject history from other surfaces (i.e. disocclusions).
+//
+
+layout(
+    local_size_x = 8,
+    local_size_y = 8
+) in;
+
+PredefinedUniformBlock(CameraUniformBlock, camera);
+PredefinedUniformBlock(SceneUniformBlock, scene);
+
+PredefinedUniform(sampler2D, u_g_buffer_norm_vel);
+uniform sampler2D u_history_texture;
+
+uniform float u_history_blend = 0.15;
+uniform bool u_first_frame = true;
+
+layout(binding = 0, rg16f) restrict writeonly uniform image2D img_history_out;
+layout(binding = 1, r16f)  restrict readonly  uniform image2D img_occlusion;
+layout(binding = 2, r32f)  restrict readonly  uniform image2D img_half_depth;
+
+float linearizeDepth(float nonLinearDepth)
+{
+    float projectionA = camera.near_far.z;
+    float projectionB = camera.near_far.w;
+    return projectionB / (nonLinearDepth - projectionA);
+}
+
+void main()
+{
+    ivec2 pixelCoord = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 renderPx = (scene.render_size + 1) / 2;
+
+    if (pixelCoord.x < renderPx.x && pixelCoord.y < renderPx.y)
+    {
+        float occlusion = imageLoad(img_occlusion, pixelCoord).r;
+        float viewDepth = linearizeDepth(imageLoad(img_half_depth, pixelCoord).r);
+
+        vec2 uv = (vec2(pixelCoord) + 0.5) / vec2(renderPx);
+        vec2 velocity = textureLod(u_g_buffer_norm_vel, uv * scene.render_scale, 0.0).zw;
+        vec2 historyUv = uv - velocity;
+
+        // (the history was rendered into the region of the previous frame, which differs while the render scale changes)
+        ivec2 prevRenderPx = (scene.prev_render_size + 1) / 2;
+        vec2 historyUvScale = vec2(prevRenderPx) / vec2(imageSize(img_occlusion));
+        vec2 history = textureLod(u_history_texture, historyUv * historyUvScale, 0.0).rg;
+
+        bool insideScreen = all(greaterThanEqual(historyUv, vec2(0.0))) && all(lessThanEqual(historyUv, vec2(1.0)));
+        bool sameSurface = abs(history.g - viewDepth) < 0.05 * viewDepth;
+        bool useHistory = !u_first_frame && insideScreen && sameSurface;
+
+        // (select instead of blending with a zero weight, since the history can be uninitialized on the first frame)
+        float accumulated = useHistory ? mix(history.r, occlusion, u_history_blend) : occlusion;
+        imageStore(img_history_out, pixelCoord, vec4(accumulated, viewDepth, 0.0, 0.0));
+    }
+}
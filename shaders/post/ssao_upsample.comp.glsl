@@ -0,0 +1,81 @@
+#version 460
+
+#include <shader_locations.h>
+#include <camera_uniforms.h>
+
+//
+// Joint bilateral upsample of the half resolution occlusion to full resolution: the four closest half resolution
+// pixels are weighted both by distance (like bilinear filtering) and by how close their depths are to this pixel's.
+//
+
+layout(
+    local_size_x = 8,
+    local_size_y = 8
+) in;
+
+PredefinedUniformBlock(CameraUniformBlock, camera);
+
+PredefinedUniform(sampler2D, u_g_buffer_depth);
+
+layout(binding = 0, r16f)  restrict writeonly uniform image2D img_occlusion;
+layout(binding = 1, rg16f) restrict readonly  uniform image2D img_half_occlusion;
+
+float linearizeDepth(float nonLinearDepth)
+{
+    float projectionA = camera.near_far.z;
+    float projectionB = camera.near_far.w;
+    return projectionB / (nonLinearDepth - projectionA);
+}
+
+void main()
+{
+    ivec2 pixelCoord = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 imagePx = imageSize(img_occlusion);
+
+    if (pixelCoord.x < imagePx.x && pixelCoord.y < imagePx.y)
+    {
+        float depth = texelFetch(u_g_buffer_depth, pixelCoord, 0).r;
+        if (depth >= 1.0)
+        {
+            imageStore(img_occlusion, pixelCoord, vec4(1.0));
+            return;
+        }
+
+        float viewDepth = linearizeDepth(depth);
+        float depthTolerance = 0.02 * viewDepth;
+
+        ivec2 halfPx = imageSize(img_half_occlusion);
+        vec2 halfCoord = (vec2(pixelCoord) + 0.5) / 2.0 - 0.5;
+        ivec2 baseCoord = ivec2(floor(halfCoord));
+        vec2 bilinear = halfCoord - vec2(baseCoord);
+
+        float occlusion = 0.0;
+        float totalWeight = 0.0;
+
+        float closestDepthDifference = 1.0e30;
+        float closestOcclusion = 1.0;
+
+        for (int i = 0; i < 4; ++i)
+        {
+            ivec2 offset = ivec2(i & 1, i >> 1);
+            vec2 tap = imageLoad(img_half_occlusion, clamp(baseCoord + offset, ivec2(0), halfPx - 1)).rg;
+
+            vec2 bilinearWeights = mix(1.0 - bilinear, bilinear, vec2(offset));
+            float depthDifference = abs(tap.g - viewDepth);
+            float weight = bilinearWeights.x * bilinearWeights.y * exp(-depthDifference / depthTolerance);
+
+            occlusion += weight * tap.r;
+            totalWeight += weight;
+
+            if (depthDifference < closestDepthDifference)
+            {
+                closestDepthDifference = depthDifference;
+                closestOcclusion = tap.r;
+            }
+        }
+
+        // (if no tap is on the same surface, e.g. for thin features, take the one that is closest in depth)
+        occlusion = (totalWeight > 0.0001) ? occlusion / totalWeight : closestOcclusion;
+        imageStore(img_occlusion, pixelCoord, vec4(occlusion));
+    }
+}
@@ -28,16 +28,29 @@ THE SOFTWARE.
 */
 
 #include <common.glsl>
+#include <light_formats.h>
+#include <scene_uniforms.h>
+#include <camera_uniforms.h>
+#include <shader_locations.h>
+#include <temporal_upsample.glsl>
+
+//
+// Resolves TAA at the output resolution, i.e. the size of img_dst. With dynamic resolution the source only has
+// scene.render_size pixels, in which case the current frame is reconstructed from the closest jittered samples.
+//
 
 layout(
     local_size_x = 32,
     local_size_y = 32
 ) in;
 
-layout(binding = 1, rgba32f) restrict readonly  uniform image2D img_src;
+PredefinedUniformBlock(CameraUniformBlock, camera);
+PredefinedUniformBlock(SceneUniformBlock, scene);
+
+layout(binding = 1, LIGHT_BUFFER_IMAGE_FORMAT) restrict readonly  uniform image2D img_src;
 layout(binding = 2, rgba16f) restrict readonly  uniform image2D img_norm_vel;
 
-layout(binding = 0, rgba32f) restrict writeonly uniform image2D   img_dst;
+layout(binding = 0, TAA_HISTORY_IMAGE_FORMAT) restrict writeonly uniform image2D   img_dst;
 layout(binding = 0)                             uniform sampler2D u_history_texture;
 
 
@@ -47,32 +60,44 @@ uniform bool u_first_frame = true;
 void main()
 {
     ivec2 pixelCoord = ivec2(gl_GlobalInvocationID.xy);
-    ivec2 imgSize = ivec2(imageSize(img_src).xy);
+    ivec2 imgSize = ivec2(imageSize(img_dst).xy);
 
     if (pixelCoord.x < imgSize.x && pixelCoord.y < imgSize.y)
     {
+        ivec2 renderSize = scene.render_size;
+        bool upsampling = any(notEqual(renderSize, imgSize));
+
+        vec2 pixelUv = (vec2(pixelCoord) + 0.5) / vec2(imgSize);
+
+        // (at the output resolution this is always the pixel itself, since the jitter is less than half a pixel)
+        vec2 sampleOffset;
+        ivec2 renderCoord = closestRenderPixel(pixelUv, renderSize, camera.frustum_jitter.zw, sampleOffset);
+
+        vec3 neighbourhood[9];
+        vec3 reconstructed = vec3(0.0);
+        float totalWeight = 0.0;
+
+        for (int i = 0; i < 9; ++i)
+        {
+            ivec2 offset = ivec2(i % 3 - 1, i / 3 - 1);
+            ivec2 coord = clamp(renderCoord + offset, ivec2(0), renderSize - 1);
+            neighbourhood[i] = imageLoad(img_src, coord).rgb;
+
+            float weight = upsampleSampleWeight(sampleOffset - vec2(offset));
+            reconstructed += weight * neighbourhood[i];
+            totalWeight += weight;
+        }
+
+        vec3 currSample = upsampling ? reconstructed / totalWeight : neighbourhood[4];
         vec3 color;
 
         if (u_first_frame)
         {
             // first frame, no blending at all
-            color = imageLoad(img_src, pixelCoord).rgb;
+            color = currSample;
         }
         else
         {
-            vec3 neighbourhood[9];
-
-            // TODO: Implement edge clamp!?
-            neighbourhood[0] = imageLoad(img_src, pixelCoord + ivec2(-1, -1)).rgb;
-            neighbourhood[1] = imageLoad(img_src, pixelCoord + ivec2( 0, -1)).rgb;
-            neighbourhood[2] = imageLoad(img_src, pixelCoord + ivec2(+1, -1)).rgb;
-            neighbourhood[3] = imageLoad(img_src, pixelCoord + ivec2(-1,  0)).rgb;
-            neighbourhood[4] = imageLoad(img_src, pixelCoord + ivec2( 0,  0)).rgb;
-            neighbourhood[5] = imageLoad(img_src, pixelCoord + ivec2(+1,  0)).rgb;
-            neighbourhood[6] = imageLoad(img_src, pixelCoord + ivec2(-1, +1)).rgb;
-            neighbourhood[7] = imageLoad(img_src, pixelCoord + ivec2( 0, +1)).rgb;
-            neighbourhood[8] = imageLoad(img_src, pixelCoord + ivec2(+1, +1)).rgb;
-
             vec3 nmin = neighbourhood[0];
             vec3 nmax = neighbourhood[0];
             for(int i = 1; i < 9; ++i)
@@ -81,20 +106,25 @@ void main()
                 nmax = max(nmax, neighbourhood[i]);
             }
 
-            vec2 velocity = imageLoad(img_norm_vel, pixelCoord).zw;
-            vec2 pixelUv = (vec2(pixelCoord) + 0.5) / vec2(imgSize);
+            vec2 velocity = imageLoad(img_norm_vel, renderCoord).zw;
             vec2 histUv = pixelUv - velocity;
 
             // sample from history buffer, with neighbourhood clamping.
             vec3 histSample = textureLod(u_history_texture, histUv, 0).rgb;
             histSample = clamp(histSample, nmin, nmax);
 
+            // when upsampling, trust the current frame less the further its closest sample is from this pixel
+            float historyBlend = u_history_blend;
+            if (upsampling)
+            {
+                historyBlend *= upsampleSampleWeight(sampleOffset);
+            }
+
             bvec2 a = greaterThan(histUv, vec2(1.0));
             bvec2 b = lessThan(histUv, vec2(0.0));
             // if history sample is outside screen, switch to aliased image as a fallback.
-            float blend = any(bvec2(any(a), any(b))) ? 1.0 : u_history_blend;
+            float blend = any(bvec2(any(a), any(b))) ? 1.0 : historyBlend;
 
-            vec3 currSample = neighbourhood[4];
             // finally, blend current and clamped history sample.
             color = mix(histSample, currSample, vec3(blend));
         }
@@ -8,6 +8,13 @@ struct SceneUniforms
 
     float running_time;
     float delta_time;
+
+    // The part of the g-buffer & light buffer that is rendered to, for dynamic resolution (see RenderPipeline)
+    ivec2 render_size;
+    vec2 render_scale;
+
+    // The render size of the previous frame, which is the extent of any history rendered at the render resolution
+    ivec2 prev_render_size;
 };
 
 #endif // SCENE_UNIFORMS_H
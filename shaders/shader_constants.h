@@ -3,6 +3,24 @@
 
 #define SHADOW_MAP_SEGMENT_MAX_COUNT (16)
 
+// Max number of shadow cascades for a directional light (limited by DirectionalLight::cascadeSplits)
+#define SHADOW_CASCADE_MAX_COUNT (4)
+
+// The view space froxel grid (screen tiles times exponential depth slices) that point & spot lights are binned in
+#define LIGHT_CLUSTER_COUNT_X (16)
+#define LIGHT_CLUSTER_COUNT_Y (9)
+#define LIGHT_CLUSTER_COUNT_Z (24)
+#define LIGHT_CLUSTER_COUNT (LIGHT_CLUSTER_COUNT_X * LIGHT_CLUSTER_COUNT_Y * LIGHT_CLUSTER_COUNT_Z)
+
+// Max number of lights that affect a single cluster, any more than this are ignored
+#define LIGHT_CLUSTER_MAX_LIGHTS (256)
+
+// The luminance histogram for automatic exposure. Bin 0 is for (practically) black pixels, which are ignored, and the
+// rest cover the log2 luminance range linearly.
+#define EXPOSURE_HISTOGRAM_BIN_COUNT (256)
+#define EXPOSURE_HISTOGRAM_MIN_LOG2_LUMINANCE (-14.0)
+#define EXPOSURE_HISTOGRAM_MAX_LOG2_LUMINANCE (+10.0)
+
 // How many samples (points in unit sphere) to be defined in the SphereSampleBuffer UBO
 #define SPHERE_SAMPLES_COUNT (4096)
 
@@ -20,5 +38,6 @@
 #define TONEMAP_OP_REINHARD    (1)
 #define TONEMAP_OP_UNCHARTED_2 (2)
 #define TONEMAP_OP_CLAMP       (3)
+#define TONEMAP_OP_COUNT       (4)
 
 #endif // SHADER_CONSTANTS_H
@@ -67,6 +67,7 @@
 
 #define LOC_u_world_from_local      101
 #define LOC_u_projection_from_world 102
+#define LOC_u_material_index        103
 
 ///////////////////////////////////////////////////////////////////////////////
 // Uniform block bindings
@@ -96,6 +97,22 @@
 
 #define BINDING_SphereSampleBuffer 10
 
+///////////////////////////////////////////////////////////////////////////////
+// Shader storage block bindings
+
+#define PredefinedShaderStorageBinding(name) SSBO_BINDING_##name
+#define PredefinedShaderStorageBlock(name) layout(std430, binding = PredefinedShaderStorageBinding(name)) buffer name
+
+//
+
+#define SSBO_BINDING_MaterialTableBlock   0
+#define SSBO_BINDING_TextureFeedbackBlock 1
+#define SSBO_BINDING_PointLightBlock      2
+#define SSBO_BINDING_SpotLightBlock       3
+#define SSBO_BINDING_LightClusterBlock    4
+#define SSBO_BINDING_ExposureBlock        5
+#define SSBO_BINDING_SSAOComparisonBlock  6
+
 ///////////////////////////////////////////////////////////////////////////////
 
 #endif // SHADER_LOCATIONS_H
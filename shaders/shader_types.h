@@ -23,8 +23,35 @@ struct DirectionalLight
 	// x = softness, yzw = unused
 	vec4 softness;
 
-	// x = index, yzw = unused
+	// x = index of the first cascade's segment (or -1 if none), y = cascade count, zw = unused
 	ivec4 shadowMapSegmentIndex;
+
+	// The view space depth where each cascade ends
+	vec4 cascadeSplits;
+};
+
+struct PointLight
+{
+	// xyz = position, w = range (where the light has faded out completely)
+	vec4 worldPosition;
+	vec4 viewPosition;
+
+	Color color;
+};
+
+struct SpotLight
+{
+	// xyz = position, w = range (where the light has faded out completely)
+	vec4 worldPosition;
+	vec4 viewPosition;
+
+	vec4 worldDirection;
+	vec4 viewDirection;
+
+	Color color;
+
+	// x = cos(outer angle), y = cos(inner angle), z = sin(outer angle), w = unused
+	vec4 cone;
 };
 
 #endif // SHADER_TYPES_H
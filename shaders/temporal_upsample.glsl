@@ -0,0 +1,32 @@
+#ifndef TEMPORAL_UPSAMPLE_GLSL
+#define TEMPORAL_UPSAMPLE_GLSL
+
+//
+// Helpers for resolving TAA from the render resolution to a higher output resolution (see dynamic resolution in
+// RenderPipeline). The samples of a frame are at the render pixel centers offset by the frustum jitter, so over a few
+// frames the history accumulates samples at many sub-pixel positions, which is what makes up for the lower resolution.
+//
+
+// The render pixel with the (jittered) sample closest to the output pixel at the given uv. Also returns the offset from
+// that sample to the output pixel center, in render pixels. At the edges the closest sample can be outside of the render
+// region, in which case the pixel is clamped to it (and the offset is to the clamped pixel's sample).
+ivec2 closestRenderPixel(vec2 outputUv, ivec2 renderSize, vec2 jitterNdc, out vec2 sampleOffset)
+{
+    vec2 jitterPixels = jitterNdc * 0.5 * vec2(renderSize);
+    vec2 renderPosition = outputUv * vec2(renderSize);
+
+    ivec2 pixel = ivec2(floor(renderPosition + jitterPixels));
+    pixel = clamp(pixel, ivec2(0), renderSize - 1);
+    sampleOffset = renderPosition - (vec2(pixel) + 0.5 - jitterPixels);
+
+    return pixel;
+}
+
+// Weight of a sample at the given offset (in render pixels) when reconstructing the current frame at an output pixel.
+// A Gaussian fit of the Blackman-Harris window, like in "High Quality Temporal Supersampling" (Karis, 2014).
+float upsampleSampleWeight(vec2 offset)
+{
+    return exp(-2.29 * dot(offset, offset));
+}
+
+#endif // TEMPORAL_UPSAMPLE_GLSL
@@ -13,24 +13,25 @@ BasicMaterial::ProgramLoaded(GLuint program)
 	this->program = program;
 	if (program)
 	{
-		modelMatrixLocation = glGetUniformLocation(program, "u_world_from_local");
-		prevModelMatrixLocation = glGetUniformLocation(program, "u_prev_world_from_local");
-		normalMatrixLocation = glGetUniformLocation(program, "u_world_from_tangent");
-
-		baseColorLocation = glGetUniformLocation(program, "u_base_color");
-		roughnessLocation = glGetUniformLocation(program, "u_roughness");
-		metallicLocation = glGetUniformLocation(program, "u_metallic");
+		modelMatrixLocation = ShaderSystem::GetUniformLocation(program, "u_world_from_local");
+		prevModelMatrixLocation = ShaderSystem::GetUniformLocation(program, "u_prev_world_from_local");
+		normalMatrixLocation = ShaderSystem::GetUniformLocation(program, "u_world_from_tangent");
 	}
 }
 
+void
+BasicMaterial::WriteMaterialData(MaterialData& data) const
+{
+	data = {};
+	data.map_atlas_layers = glm::ivec4(-1);
+	data.base_color = glm::vec4(baseColor, 1.0f);
+	data.properties = glm::vec4(roughness, metallic, 0.0f, 0.0f);
+}
+
 void
 BasicMaterial::BindUniforms(Transform& transform, const Transform& prevTransform) const
 {
 	glUniformMatrix4fv(modelMatrixLocation, 1, GL_FALSE, glm::value_ptr(transform.matrix));
 	glUniformMatrix4fv(prevModelMatrixLocation, 1, GL_FALSE, glm::value_ptr(prevTransform.matrix));
 	glUniformMatrix3fv(normalMatrixLocation, 1, GL_FALSE, glm::value_ptr(transform.normalMatrix));
-
-	glUniform3fv(baseColorLocation, 1, glm::value_ptr(baseColor));
-	glUniform1f(roughnessLocation, roughness);
-	glUniform1f(metallicLocation, metallic);
 }
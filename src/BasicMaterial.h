@@ -14,14 +14,11 @@ struct BasicMaterial : public Material
 	float metallic;
 
 	void ProgramLoaded(GLuint program) override;
+	void WriteMaterialData(MaterialData& data) const override;
 	void BindUniforms(Transform& transform, const Transform& prevTransform) const override;
 
 private:
 
-	GLint baseColorLocation;
-	GLint roughnessLocation;
-	GLint metallicLocation;
-
 	GLint modelMatrixLocation;
 	GLint prevModelMatrixLocation;
 	GLint normalMatrixLocation;
@@ -0,0 +1,89 @@
+#include "Benchmark.h"
+
+#include <cassert>
+
+void
+Benchmark::Start(int stepCount, int framesPerStep, int warmupFrames)
+{
+	assert(stepCount > 0 && framesPerStep > 0);
+
+	running = true;
+	this->stepCount = stepCount;
+	this->framesPerStep = framesPerStep;
+	this->warmupFrames = warmupFrames;
+
+	step = 0;
+	frame = 0;
+	for (double& value : accumulated) value = 0.0;
+}
+
+bool
+Benchmark::AddFrame(double value0, double value1)
+{
+	if (!running)
+	{
+		return false;
+	}
+
+	frame += 1;
+	if (frame <= warmupFrames)
+	{
+		return false;
+	}
+
+	accumulated[0] += value0;
+	accumulated[1] += value1;
+	if (frame < warmupFrames + framesPerStep)
+	{
+		return false;
+	}
+
+	for (int i = 0; i < MAX_VALUES; ++i)
+	{
+		average[i] = accumulated[i] / framesPerStep;
+		accumulated[i] = 0.0;
+	}
+
+	step += 1;
+	frame = 0;
+	running = step < stepCount;
+
+	return true;
+}
+
+bool
+Benchmark::IsRunning() const
+{
+	return running;
+}
+
+bool
+Benchmark::IsStartOfStep() const
+{
+	return running && frame == 0;
+}
+
+int
+Benchmark::Step() const
+{
+	return step;
+}
+
+int
+Benchmark::CompletedStep() const
+{
+	return step - 1;
+}
+
+int
+Benchmark::FramesPerStep() const
+{
+	return framesPerStep;
+}
+
+double
+Benchmark::Average(int index) const
+{
+	assert(index >= 0 && index < MAX_VALUES);
+	return average[index];
+}
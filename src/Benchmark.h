@@ -0,0 +1,43 @@
+#pragma once
+
+//
+// The steps of a benchmark, where each step first runs some warmup frames (e.g. for changed resources and the delayed
+// GPU timers to settle) and then averages the measurements of a number of frames. The user runs the steps, and feeds
+// the measurements of every frame to AddFrame.
+//
+class Benchmark
+{
+public:
+
+	static const int MAX_VALUES{ 2 };
+
+	void Start(int stepCount, int framesPerStep, int warmupFrames = 10);
+
+	// Adds the measurements of a frame. Returns true if it completed a step, and then the averages of the completed step
+	// are available from Average, and the benchmark has moved on to the next step (or isn't running after the last one).
+	bool AddFrame(double value0, double value1 = 0.0);
+
+	bool IsRunning() const;
+
+	// Whether no frames have been added to the current step yet, e.g. for setting up the step
+	bool IsStartOfStep() const;
+
+	int Step() const;
+	int CompletedStep() const;
+	int FramesPerStep() const;
+
+	double Average(int index = 0) const;
+
+private:
+
+	bool running{ false };
+	int stepCount{ 0 };
+	int framesPerStep{ 0 };
+	int warmupFrames{ 0 };
+
+	int step{ 0 };
+	int frame{ 0 };
+	double accumulated[MAX_VALUES]{};
+	double average[MAX_VALUES]{};
+
+};
@@ -1,57 +1,112 @@
 #include "BloomPass.h"
 
+#include <imgui.h>
+
+#include "GLState.h"
+#include "Logging.h"
 #include "GuiSystem.h"
 #include "ShaderSystem.h"
 #include "FullscreenQuad.h"
 
 #include "shader_locations.h"
 
+// Each step is run with both paths, first the raster and then the compute path
+static const glm::ivec2 benchmarkSizes[] = { { 1920, 1080 }, { 3840, 2160 } };
+static const int benchmarkStepCount = 2 * sizeof(benchmarkSizes) / sizeof(benchmarkSizes[0]);
+
 void
 BloomPass::Draw(const LightBuffer& lightBuffer)
 {
-	static int lastW = 0;
-	static int lastH = 0;
-	if (lastW != lightBuffer.width || lastH != lightBuffer.height)
+	if (benchmark.IsRunning())
 	{
-		Setup(lightBuffer.width, lightBuffer.height);
-		lastW = lightBuffer.width;
-		lastH = lightBuffer.height;
+		useComputePath = (benchmark.Step() % 2) == 1;
 	}
 
-	glDisable(GL_BLEND);
-	glDisable(GL_DEPTH_TEST);
+	glm::ivec2 size = benchmark.IsRunning() ? benchmarkSizes[benchmark.Step() / 2] : glm::ivec2(lightBuffer.width, lightBuffer.height);
+	if (size.x != width || size.y != height)
+	{
+		Setup(size.x, size.y);
+	}
 
-	// Render light buffer to mip0 of the sampling texture
+	// (only the compute path can expose the light buffer while reading it)
+	bool computePath = useComputePath || (applyExposure && !benchmark.IsRunning());
+
+	if (timer.Begin(computePath))
 	{
-		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, downsamplingFramebuffers[0]);
-		glUseProgram(*blitProgram);
-		glBindTextureUnit(0, lightBuffer.lightTexture);
-		FullscreenQuad::Draw();
+		double elapsedMs = timer.LatestMs();
+		(timer.LatestVariant() ? computeMs : rasterMs) = elapsedMs;
+
+		if (benchmark.IsRunning())
+		{
+			UpdateBenchmark(elapsedMs);
+		}
+	}
+
+	if (computePath)
+	{
+		DrawCompute(lightBuffer);
+	}
+	else
+	{
+		DrawRaster(lightBuffer);
 	}
 
-	glBindTextureUnit(0, downsamplingTexture);
+	timer.End();
 
-	static std::vector<glm::ivec2> targetSizes;
-	targetSizes.resize(numDownsamples + 1);
+	// Make alias for the bloom results texture
+	bloomResults = upsamplingTexture;
 
-	targetSizes[0] = { lightBuffer.width, lightBuffer.height };
+	if (ImGui::CollapsingHeader("Bloom"))
+	{
+		ImGui::Checkbox("Single pass compute downsample", &useComputePath);
+		ImGui::SliderFloat("Threshold", &threshold, 0.0f, 10.0f);
+		ImGui::Text("GPU time: %.3f ms compute, %.3f ms raster (at %dx%d)", computeMs, rasterMs, width, height);
+
+		if (benchmark.IsRunning())
+		{
+			ImGui::Text("Benchmarking ...");
+		}
+		else if (ImGui::Button("Benchmark at 1080p & 4K"))
+		{
+			StartBenchmark();
+		}
+
+		for (const BenchmarkResult& result : benchmarkResults)
+		{
+			ImGui::Text("%dx%d %-7s %.3f ms", result.size.x, result.size.y, result.computePath ? "compute" : "raster", result.gpuMs);
+		}
+	}
+}
+
+void
+BloomPass::DrawRaster(const LightBuffer& lightBuffer)
+{
+	GLState::Disable(GL_BLEND);
+	GLState::Disable(GL_DEPTH_TEST);
+
+	// Render light buffer to mip0 of the sampling texture
+	{
+		GLState::BindFramebuffer(downsamplingFramebuffers[0]);
+		GLState::Viewport(0, 0, width, height);
+		GLState::UseProgram(*blitProgram);
+		glProgramUniform2f(*blitProgram, blitUvScaleLoc, float(lightBuffer.renderWidth) / lightBuffer.width, float(lightBuffer.renderHeight) / lightBuffer.height);
+		GLState::BindTextureUnit(0, lightBuffer.lightTexture);
+		FullscreenQuad::Draw();
+	}
+
+	GLState::BindTextureUnit(0, downsamplingTexture);
 
 	// Iteratively downsample down to the lowest mip level
 	{
-		glUseProgram(*downsampleProgram);
+		GLState::UseProgram(*downsampleProgram);
 
 		for (int targetMip = 1; targetMip <= numDownsamples; ++targetMip)
 		{
-			// See answer for NPOT texture mip sizes: https://computergraphics.stackexchange.com/a/1444
-			// I.e., use integer division and discard the rest. Using NPOT textures won't be optimal for
-			// this task, but hopefully it works fine anyway.
-			targetSizes[targetMip] = targetSizes[targetMip - 1] / glm::ivec2(2);
-			
 			int width = targetSizes[targetMip].x;
 			int height = targetSizes[targetMip].y;
 
-			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, downsamplingFramebuffers[targetMip]);
-			glViewport(0, 0, width, height);
+			GLState::BindFramebuffer(downsamplingFramebuffers[targetMip]);
+			GLState::Viewport(0, 0, width, height);
 
 			glProgramUniform2f(*downsampleProgram, dsTargetTexelSizeLoc, 1.0f / width, 1.0f / height);
 			glProgramUniform1i(*downsampleProgram, dsTargetLodLoc, targetMip);
@@ -62,27 +117,27 @@ BloomPass::Draw(const LightBuffer& lightBuffer)
 
 	// Iteratively upsample back to mip0
 	{
-		glUseProgram(*upsampleProgram);
+		GLState::UseProgram(*upsampleProgram);
 		glProgramUniform1f(*upsampleProgram, usBlurRadiusLoc, blurRadius);
 
 		for (int targetMip = numDownsamples - 1; targetMip >= 0; --targetMip)
 		{
 			if (targetMip == numDownsamples - 1)
 			{
-				glProgramUniform1i(*upsampleProgram, glGetUniformLocation(*upsampleProgram, "u_texture_to_blur"), 0);
+				glProgramUniform1i(*upsampleProgram, usTextureToBlurLoc, 0);
 			}
 			else
 			{
 				// Yes, this is the same texture that we draw to but we don't draw to the same mip as we read from
-				glProgramUniform1i(*upsampleProgram, glGetUniformLocation(*upsampleProgram, "u_texture_to_blur"), 1);
-				glBindTextureUnit(1, upsamplingTexture);
+				glProgramUniform1i(*upsampleProgram, usTextureToBlurLoc, 1);
+				GLState::BindTextureUnit(1, upsamplingTexture);
 			}
 
 			int width = targetSizes[targetMip].x;
 			int height = targetSizes[targetMip].y;
 
-			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, upsamplingFramebuffers[targetMip]);
-			glViewport(0, 0, width, height);
+			GLState::BindFramebuffer(upsamplingFramebuffers[targetMip]);
+			GLState::Viewport(0, 0, width, height);
 
 			glProgramUniform1f(*upsampleProgram, usTexelAspectLoc, float(width) / float(height));
 			glProgramUniform1i(*upsampleProgram, usTargetLodLoc, targetMip);
@@ -91,21 +146,136 @@ BloomPass::Draw(const LightBuffer& lightBuffer)
 		}
 	}
 
-	glEnable(GL_DEPTH_TEST);
-	glViewport(0, 0, lightBuffer.width, lightBuffer.height);
+	GLState::Enable(GL_DEPTH_TEST);
+	GLState::Viewport(0, 0, lightBuffer.width, lightBuffer.height);
+}
 
-	// Make alias for the bloom results texture
-	bloomResults = upsamplingTexture;
+void
+BloomPass::DrawCompute(const LightBuffer& lightBuffer)
+{
+	// The whole pyramid in a single dispatch, where every work group covers a 64x64 tile of mip 0
+	{
+		GLState::UseProgram(*computeDownsampleProgram);
+		glProgramUniform1f(*computeDownsampleProgram, cdsThresholdLoc, threshold);
+		glProgramUniform1i(*computeDownsampleProgram, cdsApplyExposureLoc, applyExposure);
+		glProgramUniform2f(*computeDownsampleProgram, cdsUvScaleLoc, float(lightBuffer.renderWidth) / lightBuffer.width, float(lightBuffer.renderHeight) / lightBuffer.height);
+
+		GLState::BindTextureUnit(0, lightBuffer.lightTexture);
+		for (int level = 0; level <= numDownsamples; ++level)
+		{
+			glBindImageTexture(level, downsamplingTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+		}
+
+		glDispatchCompute((width + 63) / 64, (height + 63) / 64, 1);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	}
+
+	// Upsample back to mip 0, where every level needs the neighbours from the whole level below it
+	{
+		GLState::UseProgram(*computeUpsampleProgram);
+		glProgramUniform1f(*computeUpsampleProgram, cusBlurRadiusLoc, blurRadius);
+
+		GLState::BindTextureUnit(0, downsamplingTexture);
+		GLState::BindTextureUnit(1, upsamplingTexture);
+
+		for (int targetMip = numDownsamples - 1; targetMip >= 0; --targetMip)
+		{
+			// (the lowest level is blurred from the downsampled texture, the rest from the level below it)
+			int textureToBlur = (targetMip == numDownsamples - 1) ? 0 : 1;
+			glProgramUniform1i(*computeUpsampleProgram, cusTextureToBlurLoc, textureToBlur);
+
+			int width = targetSizes[targetMip].x;
+			int height = targetSizes[targetMip].y;
+
+			glProgramUniform1f(*computeUpsampleProgram, cusTexelAspectLoc, float(width) / float(height));
+			glProgramUniform1i(*computeUpsampleProgram, cusTargetLodLoc, targetMip);
+			glBindImageTexture(0, upsamplingTexture, targetMip, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+
+			glDispatchCompute((width + 7) / 8, (height + 7) / 8, 1);
+			glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+		}
+	}
+}
+
+void
+BloomPass::StartBenchmark(int framesPerStep)
+{
+	if (benchmark.IsRunning())
+	{
+		return;
+	}
+
+	benchmark.Start(benchmarkStepCount, framesPerStep);
+	benchmarkOriginalPath = useComputePath;
+	benchmarkResults.clear();
+}
+
+void
+BloomPass::UpdateBenchmark(double gpuMs)
+{
+	if (!benchmark.AddFrame(gpuMs))
+	{
+		return;
+	}
+
+	BenchmarkResult result;
+	result.size = benchmarkSizes[benchmark.CompletedStep() / 2];
+	result.computePath = (benchmark.CompletedStep() % 2) == 1;
+	result.gpuMs = benchmark.Average();
+	benchmarkResults.push_back(result);
+
+	if (benchmark.IsRunning())
+	{
+		return;
+	}
+
+	useComputePath = benchmarkOriginalPath;
+
+	Log("Bloom benchmark (average GPU time over %d frames):\n", benchmark.FramesPerStep());
+	for (const BenchmarkResult& result : benchmarkResults)
+	{
+		Log("  %dx%d %-7s %.3f ms\n", result.size.x, result.size.y, result.computePath ? "compute" : "raster", result.gpuMs);
+	}
 }
 
 void BloomPass::Setup(int width, int height)
 {
-	ShaderSystem::AddProgram(&blitProgram, "quad.vert.glsl", "etc/blit.frag.glsl", this);
-	ShaderSystem::AddProgram(&downsampleProgram, "quad.vert.glsl", "post/bloom_downsample.frag.glsl", this);
-	ShaderSystem::AddProgram(&upsampleProgram, "quad.vert.glsl", "post/bloom_upsample.frag.glsl", this);
+	if (!blitProgram)
+	{
+		ShaderSystem::AddProgram(&blitProgram, "quad.vert.glsl", "etc/blit.frag.glsl", this);
+		ShaderSystem::AddProgram(&downsampleProgram, "quad.vert.glsl", "post/bloom_downsample.frag.glsl", this);
+		ShaderSystem::AddProgram(&upsampleProgram, "quad.vert.glsl", "post/bloom_upsample.frag.glsl", this);
+
+		// (the single pass downsample has the number of levels built in)
+		if (numDownsamples != 6)
+		{
+			LogError("The compute bloom downsample only supports exactly 6 downsamples!");
+		}
+
+		ShaderSystem::AddComputeProgram(&computeDownsampleProgram, "post/bloom_downsample.comp.glsl", this);
+		ShaderSystem::AddComputeProgram(&computeUpsampleProgram, "post/bloom_upsample.comp.glsl", this);
+	}
+
+	this->width = width;
+	this->height = height;
 
 	int numLevelsNeeded = numDownsamples + 1;
 
+	// See answer for NPOT texture mip sizes: https://computergraphics.stackexchange.com/a/1444
+	// I.e., use integer division and discard the rest. Using NPOT textures won't be optimal for
+	// this task, but hopefully it works fine anyway.
+	targetSizes.resize(numLevelsNeeded);
+	targetSizes[0] = { width, height };
+	for (int level = 1; level < numLevelsNeeded; ++level)
+	{
+		targetSizes[level] = targetSizes[level - 1] / glm::ivec2(2);
+	}
+
+	GLState::DeleteTextures(1, &downsamplingTexture);
+	GLState::DeleteTextures(1, &upsamplingTexture);
+	GLState::DeleteFramebuffers(GLsizei(downsamplingFramebuffers.size()), downsamplingFramebuffers.data());
+	GLState::DeleteFramebuffers(GLsizei(upsamplingFramebuffers.size()), upsamplingFramebuffers.data());
+
 	glCreateTextures(GL_TEXTURE_2D, 1, &downsamplingTexture);
 	{
 		glTextureStorage2D(downsamplingTexture, numLevelsNeeded, GL_RGBA16F, width, height);
@@ -153,21 +323,40 @@ void BloomPass::ProgramLoaded(GLuint program)
 	if (blitProgram && program == *blitProgram)
 	{
 		glProgramUniform1i(program, PredefinedUniformLocation(u_texture), 0);
+		blitUvScaleLoc = ShaderSystem::GetUniformLocation(program, "u_uv_scale");
 	}
 
 	if (downsampleProgram && program == *downsampleProgram)
 	{
 		glProgramUniform1i(program, PredefinedUniformLocation(u_texture), 0);
-		dsTargetTexelSizeLoc = glGetUniformLocation(program, "u_target_texel_size");
-		dsTargetLodLoc = glGetUniformLocation(program, "u_target_lod");
+		dsTargetTexelSizeLoc = ShaderSystem::GetUniformLocation(program, "u_target_texel_size");
+		dsTargetLodLoc = ShaderSystem::GetUniformLocation(program, "u_target_lod");
 	}
 
 	if (upsampleProgram && program == *upsampleProgram)
 	{
 		glProgramUniform1i(program, PredefinedUniformLocation(u_texture), 0);
-		usTexelAspectLoc = glGetUniformLocation(program, "u_texel_aspect");
-		usBlurRadiusLoc = glGetUniformLocation(program, "u_blur_radius");
-		usTargetLodLoc = glGetUniformLocation(program, "u_target_lod");
+		usTexelAspectLoc = ShaderSystem::GetUniformLocation(program, "u_texel_aspect");
+		usBlurRadiusLoc = ShaderSystem::GetUniformLocation(program, "u_blur_radius");
+		usTargetLodLoc = ShaderSystem::GetUniformLocation(program, "u_target_lod");
+		usTextureToBlurLoc = ShaderSystem::GetUniformLocation(program, "u_texture_to_blur");
+	}
+
+	if (computeDownsampleProgram && program == *computeDownsampleProgram)
+	{
+		glProgramUniform1i(program, PredefinedUniformLocation(u_texture), 0);
+		cdsThresholdLoc = ShaderSystem::GetUniformLocation(program, "u_threshold");
+		cdsApplyExposureLoc = ShaderSystem::GetUniformLocation(program, "u_apply_exposure");
+		cdsUvScaleLoc = ShaderSystem::GetUniformLocation(program, "u_uv_scale");
+	}
+
+	if (computeUpsampleProgram && program == *computeUpsampleProgram)
+	{
+		glProgramUniform1i(program, PredefinedUniformLocation(u_texture), 0);
+		cusTexelAspectLoc = ShaderSystem::GetUniformLocation(program, "u_texel_aspect");
+		cusBlurRadiusLoc = ShaderSystem::GetUniformLocation(program, "u_blur_radius");
+		cusTargetLodLoc = ShaderSystem::GetUniformLocation(program, "u_target_lod");
+		cusTextureToBlurLoc = ShaderSystem::GetUniformLocation(program, "u_texture_to_blur");
 	}
 
 }
@@ -4,8 +4,12 @@
 
 #include <vector>
 
+#include <glm/glm.hpp>
+
 #include "ShaderDependant.h"
 #include "LightBuffer.h"
+#include "GpuTimer.h"
+#include "Benchmark.h"
 
 class BloomPass : ShaderDepandant
 {
@@ -14,10 +18,23 @@ public:
 	void Draw(const LightBuffer& lightBuffer);
 	void ProgramLoaded(GLuint program) override;
 
+	// Measures both paths with the bloom rendered at 1080p and 4K (regardless of the size of the light buffer)
+	void StartBenchmark(int framesPerStep = 100);
+
 	const int numDownsamples = 6;
 
 	float blurRadius = 0.001f;
 
+	// Pixels darker than this don't contribute to the bloom (compute path only)
+	float threshold = 0.0f;
+
+	// A single dispatch for the whole downsample pyramid and one dispatch per upsample level, or the original chain of
+	// full-screen draws with one framebuffer per level
+	bool useComputePath = true;
+
+	// Expose the light buffer while downsampling it, for when it isn't already exposed. Implies the compute path.
+	bool applyExposure = false;
+
 	// accessible alias of downsamplingTexture for getting the results
 	GLuint bloomResults;
 
@@ -25,21 +42,59 @@ private:
 
 	void Setup(int width, int height);
 
-	GLuint *blitProgram;
+	void DrawRaster(const LightBuffer& lightBuffer);
+	void DrawCompute(const LightBuffer& lightBuffer);
+
+	void UpdateBenchmark(double gpuMs);
 
-	GLuint downsamplingTexture;
-	GLuint upsamplingTexture;
+	int width{ 0 };
+	int height{ 0 };
+	std::vector<glm::ivec2> targetSizes{};
 
-	GLuint *downsampleProgram;
+	GLuint *blitProgram{ nullptr };
+	GLint blitUvScaleLoc;
+
+	GLuint downsamplingTexture{ 0 };
+	GLuint upsamplingTexture{ 0 };
+
+	GLuint *downsampleProgram{ nullptr };
 	GLint dsTargetTexelSizeLoc;
 	GLint dsTargetLodLoc;
 
-	GLuint *upsampleProgram;
+	GLuint *upsampleProgram{ nullptr };
 	GLint usTexelAspectLoc;
 	GLint usBlurRadiusLoc;
 	GLint usTargetLodLoc;
+	GLint usTextureToBlurLoc;
+
+	GLuint *computeDownsampleProgram{ nullptr };
+	GLint cdsThresholdLoc;
+	GLint cdsApplyExposureLoc;
+	GLint cdsUvScaleLoc;
+
+	GLuint *computeUpsampleProgram{ nullptr };
+	GLint cusTexelAspectLoc;
+	GLint cusBlurRadiusLoc;
+	GLint cusTargetLodLoc;
+	GLint cusTextureToBlurLoc;
 
 	std::vector<GLuint> downsamplingFramebuffers;
 	std::vector<GLuint> upsamplingFramebuffers;
 
+	// The variant is whether the compute path was timed
+	GpuTimer timer{};
+	double computeMs{ 0.0 };
+	double rasterMs{ 0.0 };
+
+	struct BenchmarkResult
+	{
+		glm::ivec2 size;
+		bool computePath;
+		double gpuMs;
+	};
+
+	Benchmark benchmark{};
+	bool benchmarkOriginalPath{ true };
+	std::vector<BenchmarkResult> benchmarkResults{};
+
 };
@@ -30,7 +30,8 @@ void CameraBase::CommitToGpu()
 	vec4 nearFar = vec4(zNear, zFar, projA, projB);
 	cameraBuffer.memory.near_far = nearFar;
 
-	cameraBuffer.memory.frustum_jitter = vec4(frustumJitterUv, 0.0f, 0.0f);
+	// (the jitter of this frame is saved as the previous one as soon as it's applied)
+	cameraBuffer.memory.frustum_jitter = vec4(frustumJitterUv, prevFrustumJitterUv);
 
 	cameraBuffer.memory.aperture = aperture;
 	cameraBuffer.memory.shutter_speed = shutterSpeed;
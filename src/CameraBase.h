@@ -36,6 +36,11 @@ public:
 	const mat4& GetProjectionMatrix() const { return projectionFromView; }
 	mat4 GetViewProjectionMatrix() const { return GetProjectionMatrix() * GetViewMatrix(); }
 
+	float GetNear() const { return zNear; }
+	float GetFar() const { return zFar; }
+	float GetFieldOfView() const { return fieldOfView; }
+	float GetAspectRatio() const { return float(targetPixelsWidth) / float(targetPixelsHeight); }
+
 protected:
 
 	vec3 position{};
@@ -15,47 +15,67 @@ CompleteMaterial::ProgramLoaded(GLuint program)
 	this->program = program;
 	if (program)
 	{
-		modelMatrixLocation = glGetUniformLocation(program, "u_world_from_local");
-		prevModelMatrixLocation = glGetUniformLocation(program, "u_prev_world_from_local");
-		normalMatrixLocation = glGetUniformLocation(program, "u_world_from_tangent");
-
-		baseColorLocation = glGetUniformLocation(program, "u_base_color");
-		roughnessMapLocation = glGetUniformLocation(program, "u_roughness_map");
-		metallicMapLocation = glGetUniformLocation(program, "u_metallic_map");
-		normalMapLocation = glGetUniformLocation(program, "u_normal_map");
+		modelMatrixLocation = ShaderSystem::GetUniformLocation(program, "u_world_from_local");
+		prevModelMatrixLocation = ShaderSystem::GetUniformLocation(program, "u_prev_world_from_local");
+		normalMatrixLocation = ShaderSystem::GetUniformLocation(program, "u_world_from_tangent");
 	}
 }
 
-void
-CompleteMaterial::BindUniforms(Transform& transform, const Transform& prevTransform) const
+static void
+WriteMaterialMap(GLuint texture, glm::uvec2& handle, glm::vec4& atlasRect, int& atlasLayer)
 {
-	glUniformMatrix4fv(modelMatrixLocation, 1, GL_FALSE, glm::value_ptr(transform.matrix));
-	glUniformMatrix4fv(prevModelMatrixLocation, 1, GL_FALSE, glm::value_ptr(prevTransform.matrix));
-	glUniformMatrix3fv(normalMatrixLocation, 1, GL_FALSE, glm::value_ptr(transform.normalMatrix));
+	GLuint64 residentHandle = TextureSystem::GetResidentHandle(texture);
+	handle = glm::uvec2(uint32_t(residentHandle & 0xFFFFFFFF), uint32_t(residentHandle >> 32));
 
+	TextureSystem::AtlasRegion region;
+	if (TextureSystem::GetAtlasRegion(texture, region))
+	{
+		atlasRect = glm::vec4(region.offset[0], region.offset[1], region.scale[0], region.scale[1]);
+		atlasLayer = region.layer;
+	}
+	else
+	{
+		atlasRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+		atlasLayer = -1;
+	}
+}
+
+void
+CompleteMaterial::WriteMaterialData(MaterialData& data) const
+{
 	if (!baseColorTexture)
 	{
 		baseColorTexture = TextureSystem::LoadLdrImage("assets/default/base_color.png");
 	}
 
-	const GLuint baseColorUnit = 0;
-	glBindTextureUnit(baseColorUnit, baseColorTexture);
-	glUniform1i(baseColorLocation, baseColorUnit);
-
 	if (!normalMap)
 	{
 		normalMap = TextureSystem::LoadDataTexture("assets/default/normal.png");
 	}
 
-	const GLuint normalMapUnit = 1;
-	glBindTextureUnit(normalMapUnit, normalMap);
-	glUniform1i(normalMapLocation, normalMapUnit);
+	// While textures are loading they have no handle, and the shader uses these values instead
+	data.base_color = glm::vec4(200.0f / 255.0f);
+	data.properties = glm::vec4(0.5f, 0.0f, 0.0f, 0.0f);
+
+	WriteMaterialMap(baseColorTexture, data.base_color_map, data.base_color_map_rect, data.map_atlas_layers.x);
+	WriteMaterialMap(normalMap, data.normal_map, data.normal_map_rect, data.map_atlas_layers.y);
+	WriteMaterialMap(roughnessMap, data.roughness_map, data.roughness_map_rect, data.map_atlas_layers.z);
+	WriteMaterialMap(metallicMap, data.metallic_map, data.metallic_map_rect, data.map_atlas_layers.w);
+}
 
-	const GLuint roughnessMapUnit = 2;
-	glBindTextureUnit(roughnessMapUnit, roughnessMap);
-	glUniform1i(roughnessMapLocation, roughnessMapUnit);
+void
+CompleteMaterial::RequestTextureResolution(int log2Resolution) const
+{
+	TextureSystem::RequestStreamingResolution(baseColorTexture, log2Resolution);
+	TextureSystem::RequestStreamingResolution(normalMap, log2Resolution);
+	TextureSystem::RequestStreamingResolution(roughnessMap, log2Resolution);
+	TextureSystem::RequestStreamingResolution(metallicMap, log2Resolution);
+}
 
-	const GLuint metallicMapUnit = 3;
-	glBindTextureUnit(metallicMapUnit, metallicMap);
-	glUniform1i(metallicMapLocation, metallicMapUnit);
+void
+CompleteMaterial::BindUniforms(Transform& transform, const Transform& prevTransform) const
+{
+	glUniformMatrix4fv(modelMatrixLocation, 1, GL_FALSE, glm::value_ptr(transform.matrix));
+	glUniformMatrix4fv(prevModelMatrixLocation, 1, GL_FALSE, glm::value_ptr(prevTransform.matrix));
+	glUniformMatrix3fv(normalMatrixLocation, 1, GL_FALSE, glm::value_ptr(transform.normalMatrix));
 }
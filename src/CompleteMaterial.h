@@ -16,15 +16,12 @@ struct CompleteMaterial : public Material
 	mutable GLuint metallicMap{};
 
 	void ProgramLoaded(GLuint program) override;
+	void WriteMaterialData(MaterialData& data) const override;
+	void RequestTextureResolution(int log2Resolution) const override;
 	void BindUniforms(Transform& transform, const Transform& prevTransform) const override;
 
 private:
 
-	GLint baseColorLocation;
-	GLint roughnessMapLocation;
-	GLint metallicMapLocation;
-	GLint normalMapLocation;
-
 	GLint modelMatrixLocation;
 	GLint prevModelMatrixLocation;
 	GLint normalMatrixLocation;
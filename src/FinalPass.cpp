@@ -2,6 +2,7 @@
 
 #include <imgui.h>
 
+#include "GLState.h"
 #include "GuiSystem.h"
 #include "PerformOnce.h"
 #include "ShaderSystem.h"
@@ -11,118 +12,284 @@
 
 #include "shader_locations.h"
 #include "shader_constants.h"
+#include "light_formats.h"
 
 void
 FinalPass::Draw(const GBuffer& gBuffer, const LightBuffer& lightBuffer, Scene& scene, bool *useTaa)
 {
-	PerformOnce(logLumTexture = TextureSystem::CreateTexture(1024, 1024, GL_R32F));
-	PerformOnce(currentLumTexture = TextureSystem::CreateTexture(1, 1, GL_R32F));
+	PerformOnce(
+		// The histogram bins followed by the adapted luminance, all starting out as zero
+		size_t exposureBufferSize = (EXPOSURE_HISTOGRAM_BIN_COUNT + 1) * sizeof(GLuint);
+		glCreateBuffers(1, &exposureBuffer);
+		glNamedBufferStorage(exposureBuffer, exposureBufferSize, nullptr, GL_DYNAMIC_STORAGE_BIT);
+		glClearNamedBufferData(exposureBuffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PredefinedShaderStorageBinding(ExposureBlock), exposureBuffer);
+	);
 
-	PerformOnce(ShaderSystem::AddComputeProgram(&logLumProgram, "post/log_luminance.comp.glsl", this));
+	PerformOnce(ShaderSystem::AddComputeProgram(&histogramProgram, "post/luminance_histogram.comp.glsl", this));
 	{
-		glBindTextureUnit(0, lightBuffer.lightTexture);
-		glBindImageTexture(1, logLumTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		// (directly from the light buffer, at render resolution)
+		int xGroups = int(ceil(lightBuffer.renderWidth / 16.0f));
+		int yGroups = int(ceil(lightBuffer.renderHeight / 16.0f));
 
-		glUseProgram(*logLumProgram);
-		glDispatchCompute(32, 32, 1); //(32 * 32 = 1024)
+		glBindImageTexture(0, lightBuffer.lightTexture, 0, GL_FALSE, 0, GL_READ_ONLY, LIGHT_BUFFER_INTERNAL_FORMAT);
 
-		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-		glGenerateTextureMipmap(logLumTexture);
+		GLState::UseProgram(*histogramProgram);
+		glDispatchCompute(xGroups, yGroups, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
 	}
 
-	PerformOnce(ShaderSystem::AddComputeProgram(&exposureProgram, "post/expose.comp.glsl", this));
+	PerformOnce(ShaderSystem::AddComputeProgram(&meteringProgram, "post/exposure_from_histogram.comp.glsl", this));
 	{
-		int xGroups = int(ceil(lightBuffer.width / 32.0f));
-		int yGroups = int(ceil(lightBuffer.height / 32.0f));
+		static Uniform<float> lowPercentile("u_low_percentile", 0.5f);
+		static Uniform<float> highPercentile("u_high_percentile", 0.95f);
 
-		glBindImageTexture(0, lightBuffer.lightTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
-		glBindImageTexture(1, logLumTexture, 10, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
-		glBindImageTexture(2, currentLumTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
+		if (ImGui::CollapsingHeader("Automatic exposure"))
+		{
+			ImGui::SliderFloat("Low percentile", &lowPercentile.value, 0.0f, 1.0f, "%.2f");
+			ImGui::SliderFloat("High percentile", &highPercentile.value, 0.0f, 1.0f, "%.2f");
+			highPercentile.value = glm::max(highPercentile.value, lowPercentile.value);
 
-		glUseProgram(*exposureProgram);
-		glDispatchCompute(xGroups, yGroups, 1);
-		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-	}
+			ImGui::Text("Luminance histogram: %d bins, log2 luminance %.0f to %.0f", EXPOSURE_HISTOGRAM_BIN_COUNT,
+			            EXPOSURE_HISTOGRAM_MIN_LOG2_LUMINANCE, EXPOSURE_HISTOGRAM_MAX_LOG2_LUMINANCE);
+		}
 
-	// TODO: Fixme, this is chaos
-	*useTaa = taaPass.enabled;
-	taaPass.Draw(lightBuffer, gBuffer);
-	bloomPass.Draw(lightBuffer);
+		UpdateUniformsIfNeeded(*meteringProgram, lowPercentile, highPercentile);
+
+		GLState::UseProgram(*meteringProgram);
+		glDispatchCompute(1, 1, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	}
 
-	PerformOnce(ShaderSystem::AddProgram(&finalProgram, "quad.vert.glsl", "post/final.frag.glsl", this));
+	if (ImGui::CollapsingHeader("Postprocess"))
 	{
-		static Uniform<float> vignette("u_vignette_falloff", 0.25f);
-		static Uniform<float> gamma("u_gamma", 2.2f);
-		static Uniform<float> bloomAmount("u_bloom_amount", 0.04f);
-		static Uniform<int>   tonemapOperator("u_tonemap_operator_selector", TONEMAP_OP_ACES);
+		ImGui::Checkbox("Fused post pass", &useFusedPass);
+
+		ImGui::Text("GPU time: separate passes %.3f ms, fused pass %.3f ms", separateMs, fusedMs);
+		ImGui::Text("Full resolution traffic (estimated, excl. bloom pyramid): separate %.1f MB, fused %.1f MB",
+		            EstimatedTrafficBytes(lightBuffer, false, taaPass.enabled) / (1024.0 * 1024.0),
+		            EstimatedTrafficBytes(lightBuffer, true, taaPass.enabled) / (1024.0 * 1024.0));
+
+		ImGui::SliderFloat("Vignette amount", &vignette.value, 0.0f, 2.0f, "%.2f");
+		ImGui::SliderFloat("Bloom blend", &bloomAmount.value, 0.0f, 1.0f, "%.6f", 4.0f);
+		ImGui::SliderFloat("Gamma", &gamma.value, 0.1f, 4.0f, "%.1f");
 
-		if (ImGui::CollapsingHeader("Postprocess"))
+		// Tonemapping operator combo box selector
 		{
-			ImGui::SliderFloat("Vignette amount", &vignette.value, 0.0f, 2.0f, "%.2f");
-			ImGui::SliderFloat("Bloom blend", &bloomAmount.value, 0.0f, 1.0f, "%.6f", 4.0f);
-			ImGui::SliderFloat("Gamma", &gamma.value, 0.1f, 4.0f, "%.1f");
+			// NOTE: This has to line up with the tonemapping operators in shader_constants.glsl. Obviously not
+			// very nice or neat, but I don't intend on changing these much or adding more operators. This feature
+			// mostly exist so it's possible to compare them a bit etc... It will work for now! :)
+			const char *items[] = { "ACES", "Reinhard", "Uncharted 2", "Clamp" };
 
-			// Tonemapping operator combo box selector
+			if (ImGui::BeginCombo("Tonemapping operator", items[tonemapOperator]))
 			{
-				// NOTE: This has to line up with the tonemapping operators in shader_constants.glsl. Obviously not
-				// very nice or neat, but I don't intend on changing these much or adding more operators. This feature
-				// mostly exist so it's possible to compare them a bit etc... It will work for now! :)
-				const char *items[] = { "ACES", "Reinhard", "Uncharted 2", "Clamp" };
-
-				if (ImGui::BeginCombo("Tonemapping operator", items[tonemapOperator.value]))
+				for (int i = 0; i < IM_ARRAYSIZE(items); ++i)
 				{
-					for (int i = 0; i < IM_ARRAYSIZE(items); ++i)
+					bool isSelected = i == tonemapOperator;
+					if (ImGui::Selectable(items[i], isSelected))
+					{
+						tonemapOperator = i;
+					}
+					if (isSelected)
 					{
-						bool isSelected = i == tonemapOperator.value;
-						if (ImGui::Selectable(items[i], isSelected))
-						{
-							tonemapOperator.value = i;
-						}
-						if (isSelected)
-						{
-							ImGui::SetItemDefaultFocus();
-						}
+						ImGui::SetItemDefaultFocus();
 					}
-					ImGui::EndCombo();
 				}
+				ImGui::EndCombo();
 			}
+		}
 
-			if (ImGui::TreeNode("Camera"))
-			{
-				scene.mainCamera->DrawEditorGui();
-				ImGui::TreePop();
-			}
+		if (ImGui::TreeNode("Camera"))
+		{
+			scene.mainCamera->DrawEditorGui();
+			ImGui::TreePop();
+		}
+	}
+
+	// Add all permutations up front, where the ones that aren't selected are compiled in the background. The GUI above
+	// has already made this frame's selection, so a newly selected permutation is waited for here.
+	for (int op = 0; op < TONEMAP_OP_COUNT; ++op)
+	{
+		bool selected = op == tonemapOperator;
+		if (!finalPrograms[op] || (selected && !useFusedPass && !*finalPrograms[op]))
+		{
+			std::string defines = "TONEMAP_OPERATOR=" + std::to_string(op);
+			ShaderSystem::AddProgramPermutation(&finalPrograms[op], "quad.vert.glsl", "post/final.frag.glsl", defines, this, selected && !useFusedPass);
+		}
+		if (!fusedPrograms[op] || (selected && useFusedPass && !*fusedPrograms[op]))
+		{
+			std::string defines = "TONEMAP_OPERATOR=" + std::to_string(op);
+			ShaderSystem::AddComputeProgramPermutation(&fusedPrograms[op], "post/fused_post.comp.glsl", defines, this, selected && useFusedPass);
+		}
+	}
+
+	if (timer.Begin(useFusedPass))
+	{
+		(timer.LatestVariant() ? fusedMs : separateMs) = timer.LatestMs();
+	}
+
+	// TODO: Fixme, this is chaos
+	*useTaa = taaPass.enabled;
+
+	GLuint historyTexture = 0;
+	bool firstTaaFrame = true;
+	bool taaEnabled = false;
+
+	if (useFusedPass)
+	{
+		// Exposure & TAA are done in the fused pass, so the bloom has to expose the light buffer by itself
+		taaEnabled = taaPass.AdvanceFrame(lightBuffer, &historyTexture, &firstTaaFrame);
+		bloomPass.applyExposure = true;
+		bloomPass.Draw(lightBuffer);
+	}
+	else
+	{
+		PerformOnce(ShaderSystem::AddComputeProgram(&exposureProgram, "post/expose.comp.glsl", this));
+		{
+			int xGroups = int(ceil(lightBuffer.renderWidth / 32.0f));
+			int yGroups = int(ceil(lightBuffer.renderHeight / 32.0f));
+
+			glBindImageTexture(0, lightBuffer.lightTexture, 0, GL_FALSE, 0, GL_READ_WRITE, LIGHT_BUFFER_INTERNAL_FORMAT);
+
+			GLState::UseProgram(*exposureProgram);
+			glDispatchCompute(xGroups, yGroups, 1);
+			glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
 		}
 
-		vignette.UpdateUniformIfNeeded(*finalProgram);
-		gamma.UpdateUniformIfNeeded(*finalProgram);
-		bloomAmount.UpdateUniformIfNeeded(*finalProgram);
-		tonemapOperator.UpdateUniformIfNeeded(*finalProgram);
+		taaPass.Draw(lightBuffer, gBuffer);
+		bloomPass.applyExposure = false;
+		bloomPass.Draw(lightBuffer);
 	}
 
-	glDisable(GL_BLEND);
-	glDisable(GL_DEPTH_TEST);
+	if (useFusedPass)
+	{
+		if (lightBuffer.width != outputWidth || lightBuffer.height != outputHeight)
+		{
+			CreateOutputTarget(lightBuffer.width, lightBuffer.height);
+		}
+
+		GLuint fusedProgram = *fusedPrograms[tonemapOperator];
+		taaEnabledUniform.value = taaEnabled;
+		firstTaaFrameUniform.value = firstTaaFrame;
+		UpdateUniformsIfNeeded(fusedProgram, vignette, gamma, bloomAmount, taaPass.historyBlend, taaEnabledUniform, firstTaaFrameUniform);
+
+		GLState::UseProgram(fusedProgram);
+
+		GLState::BindTextureUnit(0, historyTexture);
+		GLState::BindTextureUnit(1, bloomPass.bloomResults);
 
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
-	glViewport(0, 0, lightBuffer.width, lightBuffer.height);
+		// (with TAA disabled the history isn't written, but the image must still be bound to something)
+		GLuint historyOutput = taaEnabled ? taaPass.outputTexture : lightBuffer.taaHistoryTextures[0];
+		glBindImageTexture(0, historyOutput, 0, GL_FALSE, 0, GL_WRITE_ONLY, TAA_HISTORY_INTERNAL_FORMAT);
+		glBindImageTexture(1, lightBuffer.lightTexture, 0, GL_FALSE, 0, GL_READ_ONLY, LIGHT_BUFFER_INTERNAL_FORMAT);
+		glBindImageTexture(2, gBuffer.normVelTexture, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA16F);
+		glBindImageTexture(3, outputTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
 
-	glUseProgram(*finalProgram);
+		int xGroups = int(ceil(lightBuffer.width / 16.0f));
+		int yGroups = int(ceil(lightBuffer.height / 16.0f));
+		glDispatchCompute(xGroups, yGroups, 1);
+		glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+
+		// (compute shaders can't write to the default framebuffer)
+		glBlitNamedFramebuffer(outputFramebuffer, 0,
+		                       0, 0, lightBuffer.width, lightBuffer.height,
+		                       0, 0, lightBuffer.width, lightBuffer.height,
+		                       GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+		GLState::BindFramebuffer(0);
+		GLState::Viewport(0, 0, lightBuffer.width, lightBuffer.height);
+	}
+	else
 	{
-		glBindTextureUnit(0, taaPass.outputTexture);	
-		glBindTextureUnit(1, bloomPass.bloomResults);
-		glBindTextureUnit(2, logLumTexture);
+		UpdateUniformsIfNeeded(*finalPrograms[tonemapOperator], vignette, gamma, bloomAmount);
+
+		GLState::Disable(GL_BLEND);
+		GLState::Disable(GL_DEPTH_TEST);
 
-		FullscreenQuad::Draw();
+		GLState::BindFramebuffer(0);
+		GLState::Viewport(0, 0, lightBuffer.width, lightBuffer.height);
+
+		GLState::UseProgram(*finalPrograms[tonemapOperator]);
+		{
+			GLState::BindTextureUnit(0, taaPass.outputTexture);
+			GLState::BindTextureUnit(1, bloomPass.bloomResults);
+
+			FullscreenQuad::Draw();
+		}
+
+		GLState::Enable(GL_DEPTH_TEST);
 	}
 
-	glEnable(GL_DEPTH_TEST);
+	timer.End();
 }
 
 void FinalPass::ProgramLoaded(GLuint program)
 {
-	if (finalProgram && program == *finalProgram)
+	for (GLuint *finalProgram : finalPrograms)
 	{
-		glProgramUniform1i(*finalProgram, PredefinedUniformLocation(u_texture), 0);
-		glProgramUniform1i(*finalProgram, glGetUniformLocation(*finalProgram, "u_bloom_texture"), 1);
+		if (finalProgram && program == *finalProgram)
+		{
+			glProgramUniform1i(program, PredefinedUniformLocation(u_texture), 0);
+			glProgramUniform1i(program, ShaderSystem::GetUniformLocation(program, "u_bloom_texture"), 1);
+		}
 	}
+
+	for (GLuint *fusedProgram : fusedPrograms)
+	{
+		if (fusedProgram && program == *fusedProgram)
+		{
+			glProgramUniform1i(program, ShaderSystem::GetUniformLocation(program, "u_history_texture"), 0);
+			glProgramUniform1i(program, ShaderSystem::GetUniformLocation(program, "u_bloom_texture"), 1);
+		}
+	}
+}
+
+void
+FinalPass::CreateOutputTarget(int width, int height)
+{
+	outputWidth = width;
+	outputHeight = height;
+
+	GLState::DeleteTextures(1, &outputTexture);
+	outputTexture = TextureSystem::CreateTexture(width, height, GL_RGBA8, GL_NEAREST, GL_NEAREST, false);
+
+	if (!outputFramebuffer)
+	{
+		glCreateFramebuffers(1, &outputFramebuffer);
+	}
+
+	glNamedFramebufferTexture(outputFramebuffer, GL_COLOR_ATTACHMENT0, outputTexture, 0);
+	glNamedFramebufferReadBuffer(outputFramebuffer, GL_COLOR_ATTACHMENT0);
+}
+
+double
+FinalPass::EstimatedTrafficBytes(const LightBuffer& lightBuffer, bool fused, bool taa) const
+{
+	// Every texel read or written once, assuming the neighbourhood reads of the TAA hit the cache. The light buffer &
+	// velocities are at the render resolution and the rest at output resolution (which only differ with dynamic
+	// resolution). The bloom pyramid reads the light buffer once in both cases, so it isn't counted.
+	double light = TextureSystem::BytesPerTexel(LIGHT_BUFFER_INTERNAL_FORMAT);
+	double history = TextureSystem::BytesPerTexel(TAA_HISTORY_INTERNAL_FORMAT);
+	double velocity = TextureSystem::BytesPerTexel(GL_RGBA16F);
+	double bloom = TextureSystem::BytesPerTexel(GL_RGBA16F);
+	double ldr = TextureSystem::BytesPerTexel(GL_RGBA8);
+
+	double renderBytesPerPixel;
+	double outputBytesPerPixel;
+	if (fused)
+	{
+		// Fused pass (+ TAA history), then a blit to the default framebuffer
+		renderBytesPerPixel = light + (taa ? velocity : 0.0);
+		outputBytesPerPixel = (taa ? 2.0 * history : 0.0) + bloom + ldr + 2.0 * ldr;
+	}
+	else
+	{
+		// In-place exposure, TAA and then the final pass reading its result
+		renderBytesPerPixel = 2.0 * light + (taa ? light + velocity : light);
+		outputBytesPerPixel = (taa ? 3.0 * history : 0.0) + bloom + ldr;
+	}
+
+	double renderPixels = double(lightBuffer.renderWidth) * double(lightBuffer.renderHeight);
+	double outputPixels = double(lightBuffer.width) * double(lightBuffer.height);
+	return renderBytesPerPixel * renderPixels + outputBytesPerPixel * outputPixels;
 }
@@ -3,11 +3,15 @@
 #include <glad/glad.h>
 
 #include "ShaderDependant.h"
+#include "UniformValue.h"
 #include "TemporalAAPass.h"
 #include "LightBuffer.h"
 #include "BloomPass.h"
 #include "GBuffer.h"
 #include "Scene.h"
+#include "GpuTimer.h"
+
+#include "shader_constants.h"
 
 class FinalPass : ShaderDepandant
 {
@@ -16,16 +20,46 @@ public:
 	void Draw(const GBuffer& gBuffer, const LightBuffer& lightBuffer, Scene& scene, bool *useTaa);
 	void ProgramLoaded(GLuint program) override;
 
+	// Exposure, TAA resolve, bloom composite & tonemapping in a single compute pass, instead of one pass each
+	bool useFusedPass = true;
+
 private:
 
+	void CreateOutputTarget(int width, int height);
+	double EstimatedTrafficBytes(const LightBuffer& lightBuffer, bool fused, bool taa) const;
+
 	BloomPass bloomPass;
 	TemporalAAPass taaPass;
 
-	GLuint logLumTexture{ 0 };
-	GLuint currentLumTexture{ 0 };
+	// EXPOSURE_HISTOGRAM_BIN_COUNT bins followed by the adapted luminance, see exposure.glsl
+	GLuint exposureBuffer{ 0 };
 
+	GLuint *histogramProgram{ 0 };
+	GLuint *meteringProgram{ 0 };
 	GLuint *exposureProgram{ 0 };
-	GLuint *logLumProgram{ 0 };
-	GLuint *finalProgram{ 0 };
+
+	// One program permutation per tonemapping operator (TONEMAP_OPERATOR in the shader)
+	int tonemapOperator = TONEMAP_OP_ACES;
+	GLuint *finalPrograms[TONEMAP_OP_COUNT]{};
+	GLuint *fusedPrograms[TONEMAP_OP_COUNT]{};
+
+	Uniform<float> vignette{ "u_vignette_falloff", 0.25f };
+	Uniform<float> gamma{ "u_gamma", 2.2f };
+	Uniform<float> bloomAmount{ "u_bloom_amount", 0.04f };
+
+	// (fused pass only)
+	Uniform<int> taaEnabledUniform{ "u_taa_enabled", 1 };
+	Uniform<int> firstTaaFrameUniform{ "u_first_frame", 1 };
+
+	// The fused pass writes to this, which is then blitted to the default framebuffer
+	GLuint outputTexture{ 0 };
+	GLuint outputFramebuffer{ 0 };
+	int outputWidth{ 0 };
+	int outputHeight{ 0 };
+
+	// From exposure to final output, where the variant is whether the fused pass was timed
+	GpuTimer timer{};
+	double separateMs{ 0.0 };
+	double fusedMs{ 0.0 };
 
 };
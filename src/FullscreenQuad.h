@@ -2,6 +2,8 @@
 
 #include <glad/glad.h>
 
+#include "GLState.h"
+
 // Well, actually a triangle, but this name is more descriptive...
 class FullscreenQuad
 {
@@ -21,13 +23,8 @@ public:
 			glCreateVertexArrays(1, &emptyVertexArray);
 		}
 
-		GLint lastBoundVertexArray;
-		glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &lastBoundVertexArray);
-
-		glBindVertexArray(emptyVertexArray);
+		GLState::BindVertexArray(emptyVertexArray);
 		glDrawArrays(GL_TRIANGLES, 0, 3);
-
-		glBindVertexArray(lastBoundVertexArray);
 	}
 	
 };
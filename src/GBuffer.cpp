@@ -2,29 +2,37 @@
 
 #include <imgui.h>
 
+#include "GLState.h"
 #include "Logging.h"
 #include "GuiSystem.h"
 #include "ShaderSystem.h"
 #include "TextureSystem.h"
 
 #include "shader_locations.h"
+#include "gbuffer_formats.h"
+#include "light_formats.h"
 
 void
 GBuffer::RecreateGpuResources(int width, int height)
 {
 	this->width = width;
 	this->height = height;
+	this->renderWidth = width;
+	this->renderHeight = height;
 
 	// Docs: "glDeleteTextures silently ignores 0's and names that do not correspond to existing textures."
-	glDeleteTextures(1, &albedoTexture);
-	glDeleteTextures(1, &materialTexture);
-	glDeleteTextures(1, &normVelTexture);
-	glDeleteTextures(1, &depthTexture);
+	GLState::DeleteTextures(1, &albedoTexture);
+	GLState::DeleteTextures(1, &materialTexture);
+	GLState::DeleteTextures(1, &normVelTexture);
+	GLState::DeleteTextures(1, &depthTexture);
 
 	albedoTexture = TextureSystem::CreateTexture(width, height, GL_RGBA8, GL_NEAREST, GL_NEAREST, false);
-	materialTexture = TextureSystem::CreateTexture(width, height, GL_RGBA8, GL_NEAREST, GL_NEAREST, false);
 	normVelTexture = TextureSystem::CreateTexture(width, height, GL_RGBA16F, GL_NEAREST, GL_NEAREST, false);
-	depthTexture = TextureSystem::CreateTexture(width, height, GL_DEPTH_COMPONENT32F, GL_NEAREST, GL_NEAREST, false);
+	depthTexture = TextureSystem::CreateTexture(width, height, GBUFFER_DEPTH_INTERNAL_FORMAT, GL_NEAREST, GL_NEAREST, false);
+
+#if GBUFFER_LAYOUT != GBUFFER_LAYOUT_PACKED
+	materialTexture = TextureSystem::CreateTexture(width, height, GBUFFER_MATERIAL_INTERNAL_FORMAT, GL_NEAREST, GL_NEAREST, false);
+#endif
 
 	// Setup the swizzle for the depth textures so all color channels are depth
 	GLenum depthSwizzle[] = { GL_RED, GL_RED, GL_RED, GL_ALPHA };
@@ -36,7 +44,11 @@ GBuffer::RecreateGpuResources(int width, int height)
 
 		GLenum drawBuffers[] = {
 			PredefinedOutputLocation(o_g_buffer_albedo),
+#if GBUFFER_LAYOUT != GBUFFER_LAYOUT_PACKED
 			PredefinedOutputLocation(o_g_buffer_material),
+#else
+			GL_NONE,
+#endif
 			PredefinedOutputLocation(o_g_buffer_norm_vel)
 		};
 		int numDrawBuffers = sizeof(drawBuffers) / sizeof(GLenum);
@@ -46,8 +58,10 @@ GBuffer::RecreateGpuResources(int width, int height)
 	GLenum albedoAttachment = PredefinedOutputLocation(o_g_buffer_albedo);
 	glNamedFramebufferTexture(framebuffer, albedoAttachment, albedoTexture, 0);
 
+#if GBUFFER_LAYOUT != GBUFFER_LAYOUT_PACKED
 	int materialAttachment = PredefinedOutputLocation(o_g_buffer_material);
 	glNamedFramebufferTexture(framebuffer, materialAttachment, materialTexture, 0);
+#endif
 
 	int normVelAttachment = PredefinedOutputLocation(o_g_buffer_norm_vel);
 	glNamedFramebufferTexture(framebuffer, normVelAttachment, normVelTexture, 0);
@@ -77,7 +91,7 @@ GBuffer::RenderToDebugTextures() const
 		GLuint filter = *ShaderSystem::AddComputeProgram("etc/visualize_normals.comp.glsl");
 		glBindImageTexture(1, debugNormalTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
 
-		glUseProgram(filter);
+		GLState::UseProgram(filter);
 		glDispatchCompute((width + 32 - 1) / 32, (height + 32 - 1) / 32, 1);
 	}
 
@@ -86,7 +100,7 @@ GBuffer::RenderToDebugTextures() const
 		GLuint filter = *ShaderSystem::AddComputeProgram("etc/visualize_velocity.comp.glsl");
 		glBindImageTexture(1, debugVelocityTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
 
-		glUseProgram(filter);
+		GLState::UseProgram(filter);
 		glDispatchCompute((width + 32 - 1) / 32, (height + 32 - 1) / 32, 1);
 	}
 }
@@ -100,13 +114,47 @@ GBuffer::RenderGui(const std::string& message) const
 
 		ImGui::Text("Albedo:");
 		GuiSystem::Texture(albedoTexture);
-		ImGui::Text("Material:");
-		GuiSystem::Texture(materialTexture);
+		if (materialTexture)
+		{
+			ImGui::Text("Material:");
+			GuiSystem::Texture(materialTexture);
+		}
 		ImGui::Text("Normals (debug view):");
 		GuiSystem::Texture(debugNormalTexture);
 		ImGui::Text("Velocity (debug view):");
 		GuiSystem::Texture(debugVelocityTexture);
 		ImGui::Text("Depth:");
 		GuiSystem::Texture(depthTexture);
+
+		// Traffic of a single light pass, i.e. reading the g-buffer and blending into the light buffer, for each
+		// layout at the current render size. The selected layout is marked.
+		struct Layout { const char *name; int layout; GLenum material; };
+		static const Layout layouts[] = {
+			{ "Separate",     GBUFFER_LAYOUT_SEPARATE,     GL_RGBA8 },
+			{ "Material RG8", GBUFFER_LAYOUT_MATERIAL_RG8, GL_RG8   },
+			{ "Packed",       GBUFFER_LAYOUT_PACKED,       GL_NONE  }
+		};
+
+		double pixelsInMb = double(renderWidth) * double(renderHeight) / (1024.0 * 1024.0);
+		int lightBytes = 2 * TextureSystem::BytesPerTexel(LIGHT_BUFFER_INTERNAL_FORMAT);
+
+		ImGui::Text("Light pass traffic (g-buffer read + light buffer blend):");
+		for (const Layout& layout : layouts)
+		{
+			int baseBytes = TextureSystem::BytesPerTexel(GL_RGBA8) + TextureSystem::BytesPerTexel(GL_RGBA16F);
+			if (layout.material != GL_NONE) baseBytes += TextureSystem::BytesPerTexel(layout.material);
+
+			int bytes32 = baseBytes + TextureSystem::BytesPerTexel(GL_DEPTH_COMPONENT32F) + lightBytes;
+			int bytes16 = baseBytes + TextureSystem::BytesPerTexel(GL_DEPTH_COMPONENT16) + lightBytes;
+
+			bool selected = layout.layout == GBUFFER_LAYOUT;
+			bool selected32 = selected && GBUFFER_DEPTH_FORMAT == GBUFFER_DEPTH_32F;
+			bool selected16 = selected && GBUFFER_DEPTH_FORMAT == GBUFFER_DEPTH_16;
+
+			ImGui::Text("%s %-12s  depth32F: %2d B/px (%5.1f MB)%s  depth16: %2d B/px (%5.1f MB)%s",
+			            selected ? ">" : " ", layout.name,
+			            bytes32, bytes32 * pixelsInMb, selected32 ? "*" : " ",
+			            bytes16, bytes16 * pixelsInMb, selected16 ? "*" : " ");
+		}
 	}
 }
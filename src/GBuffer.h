@@ -9,18 +9,24 @@ struct GBuffer
 	int width;
 	int height;
 
+	// The part of the textures that is rendered to, i.e. smaller than width x height with dynamic resolution
+	int renderWidth;
+	int renderHeight;
+
 	GLuint framebuffer;
 
-	// RGBA8: RGB - albedo, A - unused (TODO: emissive?)
+	// See gbuffer_formats.h for the available layouts
+
+	// RGBA8: RGB - albedo, A - unused, or packed roughness & metallic with GBUFFER_LAYOUT_PACKED
 	GLuint albedoTexture = 0;
 
-	// RGBA8: R - roughness, G - metallic, BA - unused
+	// GBUFFER_MATERIAL_INTERNAL_FORMAT: R - roughness, G - metallic, BA - unused (zero with GBUFFER_LAYOUT_PACKED)
 	GLuint materialTexture = 0;
 
 	// RGBA16F: RG - octahedral mapped normal, BA - screen space velocity
 	GLuint normVelTexture = 0;
 
-	// DEPTH_COMPONENT32: projected non-linear depth
+	// GBUFFER_DEPTH_INTERNAL_FORMAT: projected non-linear depth
 	GLuint depthTexture = 0;
 
 	////////////////////////////
@@ -0,0 +1,317 @@
+#include "GLState.h"
+
+//
+// Data
+//
+
+#define UNKNOWN_ENUM GLenum(~0u)
+#define UNKNOWN_NAME GLuint(~0u)
+#define NUM_CACHED_TEXTURE_UNITS 32
+
+// Capabilities that are cached, others are always passed through
+static const GLenum cachedCapabilities[] = { GL_BLEND, GL_CULL_FACE, GL_DEPTH_TEST, GL_SCISSOR_TEST };
+#define NUM_CACHED_CAPABILITIES (sizeof(cachedCapabilities) / sizeof(cachedCapabilities[0]))
+
+struct State
+{
+	int capabilities[NUM_CACHED_CAPABILITIES]; // (-1 if unknown)
+
+	GLenum cullFace;
+	GLenum frontFace;
+	GLenum polygonMode;
+
+	GLenum depthFunc;
+	int depthMask;
+	int colorMask;
+
+	GLenum blendSourceFactor;
+	GLenum blendDestinationFactor;
+	GLenum blendEquation;
+
+	GLint viewport[4];
+
+	GLuint framebuffer;
+	GLuint program;
+	GLuint vertexArray;
+	GLuint textureUnits[NUM_CACHED_TEXTURE_UNITS];
+};
+
+State
+UnknownState()
+{
+	State unknown;
+
+	for (int& capability : unknown.capabilities) capability = -1;
+
+	unknown.cullFace = UNKNOWN_ENUM;
+	unknown.frontFace = UNKNOWN_ENUM;
+	unknown.polygonMode = UNKNOWN_ENUM;
+
+	unknown.depthFunc = UNKNOWN_ENUM;
+	unknown.depthMask = -1;
+	unknown.colorMask = -1;
+
+	unknown.blendSourceFactor = UNKNOWN_ENUM;
+	unknown.blendDestinationFactor = UNKNOWN_ENUM;
+	unknown.blendEquation = UNKNOWN_ENUM;
+
+	for (GLint& value : unknown.viewport) value = -1;
+
+	unknown.framebuffer = UNKNOWN_NAME;
+	unknown.program = UNKNOWN_NAME;
+	unknown.vertexArray = UNKNOWN_NAME;
+	for (GLuint& texture : unknown.textureUnits) texture = UNKNOWN_NAME;
+
+	return unknown;
+}
+
+// (the initial state is considered unknown, so the first call of each kind is always issued)
+static State state = UnknownState();
+
+static GLState::Stats currentStats{};
+static GLState::Stats lastFrameStats{};
+
+//
+// Internal API
+//
+
+bool
+NeedsUpdate(bool changed)
+{
+	if (changed) currentStats.issuedCalls += 1;
+	else currentStats.avoidedCalls += 1;
+	return changed;
+}
+
+template<typename T>
+bool
+UpdateValue(T& cached, T value)
+{
+	if (NeedsUpdate(cached != value))
+	{
+		cached = value;
+		return true;
+	}
+	return false;
+}
+
+bool
+UpdateCapability(GLenum capability, bool enabled)
+{
+	for (size_t i = 0; i < NUM_CACHED_CAPABILITIES; ++i)
+	{
+		if (cachedCapabilities[i] == capability)
+		{
+			return UpdateValue(state.capabilities[i], enabled ? 1 : 0);
+		}
+	}
+
+	return NeedsUpdate(true);
+}
+
+template<typename T>
+void
+ForgetBindings(T *cached, size_t cachedCount, GLsizei count, const GLuint *names)
+{
+	for (GLsizei i = 0; i < count; ++i)
+	{
+		for (size_t j = 0; j < cachedCount; ++j)
+		{
+			if (cached[j] == names[i]) cached[j] = UNKNOWN_NAME;
+		}
+	}
+}
+
+//
+// Public API
+//
+
+void
+GLState::NewFrame()
+{
+	lastFrameStats = currentStats;
+	currentStats = {};
+}
+
+void
+GLState::Invalidate()
+{
+	state = UnknownState();
+}
+
+void
+GLState::Enable(GLenum capability)
+{
+	if (UpdateCapability(capability, true))
+	{
+		glEnable(capability);
+	}
+}
+
+void
+GLState::Disable(GLenum capability)
+{
+	if (UpdateCapability(capability, false))
+	{
+		glDisable(capability);
+	}
+}
+
+void
+GLState::CullFace(GLenum mode)
+{
+	if (UpdateValue(state.cullFace, mode))
+	{
+		glCullFace(mode);
+	}
+}
+
+void
+GLState::FrontFace(GLenum mode)
+{
+	if (UpdateValue(state.frontFace, mode))
+	{
+		glFrontFace(mode);
+	}
+}
+
+void
+GLState::PolygonMode(GLenum mode)
+{
+	if (UpdateValue(state.polygonMode, mode))
+	{
+		glPolygonMode(GL_FRONT_AND_BACK, mode);
+	}
+}
+
+void
+GLState::DepthFunc(GLenum func)
+{
+	if (UpdateValue(state.depthFunc, func))
+	{
+		glDepthFunc(func);
+	}
+}
+
+void
+GLState::DepthMask(GLboolean flag)
+{
+	if (UpdateValue(state.depthMask, flag ? 1 : 0))
+	{
+		glDepthMask(flag);
+	}
+}
+
+void
+GLState::ColorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha)
+{
+	int mask = (red ? 1 : 0) | (green ? 2 : 0) | (blue ? 4 : 0) | (alpha ? 8 : 0);
+	if (UpdateValue(state.colorMask, mask))
+	{
+		glColorMask(red, green, blue, alpha);
+	}
+}
+
+void
+GLState::BlendFunc(GLenum sourceFactor, GLenum destinationFactor)
+{
+	bool changed = state.blendSourceFactor != sourceFactor || state.blendDestinationFactor != destinationFactor;
+	if (NeedsUpdate(changed))
+	{
+		state.blendSourceFactor = sourceFactor;
+		state.blendDestinationFactor = destinationFactor;
+		glBlendFunc(sourceFactor, destinationFactor);
+	}
+}
+
+void
+GLState::BlendEquation(GLenum mode)
+{
+	if (UpdateValue(state.blendEquation, mode))
+	{
+		glBlendEquation(mode);
+	}
+}
+
+void
+GLState::Viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	GLint* viewport = state.viewport;
+	bool changed = viewport[0] != x || viewport[1] != y || viewport[2] != width || viewport[3] != height;
+	if (NeedsUpdate(changed))
+	{
+		viewport[0] = x;
+		viewport[1] = y;
+		viewport[2] = width;
+		viewport[3] = height;
+		glViewport(x, y, width, height);
+	}
+}
+
+void
+GLState::BindFramebuffer(GLuint framebuffer)
+{
+	if (UpdateValue(state.framebuffer, framebuffer))
+	{
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+	}
+}
+
+void
+GLState::UseProgram(GLuint program)
+{
+	if (UpdateValue(state.program, program))
+	{
+		glUseProgram(program);
+	}
+}
+
+void
+GLState::BindVertexArray(GLuint vertexArray)
+{
+	if (UpdateValue(state.vertexArray, vertexArray))
+	{
+		glBindVertexArray(vertexArray);
+	}
+}
+
+void
+GLState::BindTextureUnit(GLuint unit, GLuint texture)
+{
+	if (unit >= NUM_CACHED_TEXTURE_UNITS)
+	{
+		NeedsUpdate(true);
+		glBindTextureUnit(unit, texture);
+	}
+	else if (UpdateValue(state.textureUnits[unit], texture))
+	{
+		glBindTextureUnit(unit, texture);
+	}
+}
+
+void
+GLState::DeleteTextures(GLsizei count, const GLuint *textures)
+{
+	ForgetBindings(state.textureUnits, NUM_CACHED_TEXTURE_UNITS, count, textures);
+	glDeleteTextures(count, textures);
+}
+
+void
+GLState::DeleteFramebuffers(GLsizei count, const GLuint *framebuffers)
+{
+	ForgetBindings(&state.framebuffer, 1, count, framebuffers);
+	glDeleteFramebuffers(count, framebuffers);
+}
+
+void
+GLState::DeleteVertexArrays(GLsizei count, const GLuint *vertexArrays)
+{
+	ForgetBindings(&state.vertexArray, 1, count, vertexArrays);
+	glDeleteVertexArrays(count, vertexArrays);
+}
+
+GLState::Stats
+GLState::GetFrameStats()
+{
+	return lastFrameStats;
+}
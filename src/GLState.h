@@ -0,0 +1,53 @@
+#pragma once
+
+#include <glad/glad.h>
+
+//
+// A thin cache of the GL state that the passes keep setting (capabilities, depth, blend, viewport, and bindings) which
+// skips calls that wouldn't change anything. All code that changes this state should go through here, or else call
+// Invalidate() afterwards so that the cache doesn't go out of sync with the context.
+//
+namespace GLState
+{
+	// Call once per frame, which also makes the previous frame's stats available
+	void NewFrame();
+
+	// Forget all cached state, so that the next call of each kind is issued regardless
+	void Invalidate();
+
+	void Enable(GLenum capability);
+	void Disable(GLenum capability);
+
+	void CullFace(GLenum mode);
+	void FrontFace(GLenum mode);
+	void PolygonMode(GLenum mode); // (for GL_FRONT_AND_BACK)
+
+	void DepthFunc(GLenum func);
+	void DepthMask(GLboolean flag);
+	void ColorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha);
+
+	void BlendFunc(GLenum sourceFactor, GLenum destinationFactor);
+	void BlendEquation(GLenum mode);
+
+	void Viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+	void BindFramebuffer(GLuint framebuffer); // (binds to GL_DRAW_FRAMEBUFFER)
+	void UseProgram(GLuint program);
+	void BindVertexArray(GLuint vertexArray);
+	void BindTextureUnit(GLuint unit, GLuint texture);
+
+	// Deleting an object unbinds it, and the name can then be reused by a new object, so deletes of objects that might be
+	// bound must go through these so that the cache forgets about them.
+	void DeleteTextures(GLsizei count, const GLuint *textures);
+	void DeleteFramebuffers(GLsizei count, const GLuint *framebuffers);
+	void DeleteVertexArrays(GLsizei count, const GLuint *vertexArrays);
+
+	struct Stats
+	{
+		int issuedCalls;
+		int avoidedCalls;
+	};
+
+	// Returns the stats of the last complete frame
+	Stats GetFrameStats();
+}
@@ -0,0 +1,300 @@
+#include "GLValidation.h"
+
+#include <chrono>
+
+#include <imgui.h>
+
+#include "Logging.h"
+#include "Benchmark.h"
+
+#ifdef __linux__
+ #include <execinfo.h>
+ #include <unistd.h>
+#endif
+
+//
+// Data
+//
+
+#define CALL_HISTORY_LENGTH 16
+#define BENCHMARK_WARMUP_FRAMES 20
+
+static GLValidation::Mode currentMode = GLValidation::Mode::Off;
+static int sampleInterval = 60;
+static int frameIndex = 0;
+
+// Whether errors are currently checked after every call (i.e. always in full mode, and for sampled frames)
+static bool checkingCalls = false;
+
+// The most recent GL calls, which gives some context for where an error happened
+static const char *callHistory[CALL_HISTORY_LENGTH] = {};
+static int callHistoryIndex = 0;
+
+static std::chrono::high_resolution_clock::time_point frameStartTime;
+
+// One step per mode
+static Benchmark benchmark{};
+static GLValidation::Mode benchmarkOriginalMode;
+static bool benchmarkHasResults = false;
+static double benchmarkAverageMs[int(GLValidation::Mode::Count)];
+
+//
+// Internal API
+//
+
+void
+LogCallSite(const char *name)
+{
+	Log("  in call to '%s', most recent calls first:\n", name);
+	for (int i = 1; i < CALL_HISTORY_LENGTH; ++i)
+	{
+		int index = (callHistoryIndex - 1 - i + CALL_HISTORY_LENGTH) % CALL_HISTORY_LENGTH;
+		if (callHistory[index]) Log("    %s\n", callHistory[index]);
+	}
+
+#ifdef __linux__
+	// (function names require linking with -rdynamic, otherwise only addresses are shown)
+	void *frames[32];
+	int frameCount = backtrace(frames, 32);
+	Log("  backtrace:\n");
+	fflush(stdout);
+	backtrace_symbols_fd(frames, frameCount, STDOUT_FILENO);
+#endif
+}
+
+void
+gl_debug_message_callback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar *message, const void *userParam)
+{
+	Log("GL debug message: %s\n", message);
+
+	// With synchronous debug output the callback is called from within the offending call
+	if (checkingCalls && type == GL_DEBUG_TYPE_ERROR)
+	{
+		int index = (callHistoryIndex - 1 + CALL_HISTORY_LENGTH) % CALL_HISTORY_LENGTH;
+		LogCallSite(callHistory[index] ? callHistory[index] : "<unknown>");
+	}
+}
+
+void
+glad_noop_callback(const char *name, void *funcptr, int argCount, ...)
+{
+}
+
+void
+glad_pre_callback(const char *name, void *funcptr, int argCount, ...)
+{
+	callHistory[callHistoryIndex] = name;
+	callHistoryIndex = (callHistoryIndex + 1) % CALL_HISTORY_LENGTH;
+}
+
+void
+glad_post_callback(const char *name, void *funcptr, int argCount, ...)
+{
+	// Use the "raw" glad_glGetError to avoid an recursive loop
+	GLenum errorCode = glad_glGetError();
+
+	if (errorCode != GL_NO_ERROR)
+	{
+		const char *errorName;
+		switch (errorCode)
+		{
+		case GL_INVALID_ENUM:
+			errorName = "GL_INVALID_ENUM";
+			break;
+		case GL_INVALID_VALUE:
+			errorName = "GL_INVALID_VALUE";
+			break;
+		case GL_INVALID_OPERATION:
+			errorName = "GL_INVALID_OPERATION";
+			break;
+		case GL_OUT_OF_MEMORY:
+			errorName = "GL_OUT_OF_MEMORY";
+			break;
+		case GL_INVALID_FRAMEBUFFER_OPERATION:
+			errorName = "GL_INVALID_FRAMEBUFFER_OPERATION";
+			break;
+		default:
+			errorName = "UnknownError";
+			break;
+		}
+
+		Log("%s error (0x%03x) in '%s'\n", errorName, errorCode, name);
+		LogCallSite(name);
+		LogError("Aborting due to GL error\n");
+	}
+}
+
+void
+SetCallChecking(bool enabled)
+{
+	if (enabled == checkingCalls)
+	{
+		return;
+	}
+
+	checkingCalls = enabled;
+
+	if (enabled)
+	{
+		glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+		glad_set_pre_callback(glad_pre_callback);
+		glad_set_post_callback(glad_post_callback);
+	}
+	else
+	{
+		glad_set_pre_callback(glad_noop_callback);
+		glad_set_post_callback(glad_noop_callback);
+		glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+	}
+}
+
+void
+UpdateBenchmark(double frameMs)
+{
+	if (!benchmark.AddFrame(frameMs))
+	{
+		return;
+	}
+
+	benchmarkAverageMs[benchmark.CompletedStep()] = benchmark.Average();
+
+	if (benchmark.IsRunning())
+	{
+		GLValidation::SetMode(GLValidation::Mode(benchmark.Step()));
+		return;
+	}
+
+	benchmarkHasResults = true;
+	GLValidation::SetMode(benchmarkOriginalMode);
+
+	Log("GL validation benchmark (average CPU frame time over %d frames):\n", benchmark.FramesPerStep());
+	for (int i = 0; i < int(GLValidation::Mode::Count); ++i)
+	{
+		double overhead = benchmarkAverageMs[i] - benchmarkAverageMs[int(GLValidation::Mode::Off)];
+		Log("  %-8s %.3f ms (%+.3f ms)\n", GLValidation::ModeName(GLValidation::Mode(i)), benchmarkAverageMs[i], overhead);
+	}
+}
+
+//
+// Public API
+//
+
+void
+GLValidation::Init(Mode mode)
+{
+	glDebugMessageCallback(gl_debug_message_callback, nullptr);
+	glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, true);
+	glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, nullptr, false);
+
+	// (make sure that the state is applied, regardless of the initial values)
+	checkingCalls = true;
+	SetCallChecking(false);
+
+	SetMode(mode);
+}
+
+void
+GLValidation::SetMode(Mode mode)
+{
+	currentMode = mode;
+
+	if (mode == Mode::Off) glDisable(GL_DEBUG_OUTPUT);
+	else glEnable(GL_DEBUG_OUTPUT);
+
+	SetCallChecking(mode == Mode::Full);
+}
+
+GLValidation::Mode
+GLValidation::GetMode()
+{
+	return currentMode;
+}
+
+const char *
+GLValidation::ModeName(Mode mode)
+{
+	switch (mode)
+	{
+	case Mode::Off: return "Off";
+	case Mode::Async: return "Async";
+	case Mode::Sampled: return "Sampled";
+	case Mode::Full: return "Full";
+	default: return "Unknown";
+	}
+}
+
+void
+GLValidation::BeginFrame()
+{
+	frameIndex += 1;
+
+	if (currentMode == Mode::Sampled)
+	{
+		SetCallChecking(frameIndex % sampleInterval == 0);
+	}
+
+	frameStartTime = std::chrono::high_resolution_clock::now();
+}
+
+void
+GLValidation::EndFrame()
+{
+	if (benchmark.IsRunning())
+	{
+		auto duration = std::chrono::high_resolution_clock::now() - frameStartTime;
+		UpdateBenchmark(std::chrono::duration<double, std::milli>(duration).count());
+	}
+}
+
+void
+GLValidation::StartBenchmark(int framesPerMode)
+{
+	if (benchmark.IsRunning())
+	{
+		return;
+	}
+
+	benchmark.Start(int(Mode::Count), framesPerMode, BENCHMARK_WARMUP_FRAMES);
+	benchmarkOriginalMode = currentMode;
+
+	SetMode(Mode(benchmark.Step()));
+}
+
+void
+GLValidation::DrawGui()
+{
+	if (ImGui::CollapsingHeader("GL validation"))
+	{
+		if (benchmark.IsRunning())
+		{
+			ImGui::Text("Benchmarking mode '%s' ...", ModeName(currentMode));
+			return;
+		}
+
+		int mode = int(currentMode);
+		const char *items[] = { ModeName(Mode::Off), ModeName(Mode::Async), ModeName(Mode::Sampled), ModeName(Mode::Full) };
+		if (ImGui::Combo("Mode", &mode, items, int(Mode::Count)))
+		{
+			SetMode(Mode(mode));
+		}
+
+		if (currentMode == Mode::Sampled)
+		{
+			ImGui::SliderInt("Sample interval", &sampleInterval, 1, 300, "every %.0f frames");
+		}
+
+		if (ImGui::Button("Benchmark modes"))
+		{
+			StartBenchmark();
+		}
+
+		if (benchmarkHasResults)
+		{
+			for (int i = 0; i < int(Mode::Count); ++i)
+			{
+				double overhead = benchmarkAverageMs[i] - benchmarkAverageMs[int(Mode::Off)];
+				ImGui::Text("%-8s %.3f ms (%+.3f ms)", ModeName(Mode(i)), benchmarkAverageMs[i], overhead);
+			}
+		}
+	}
+}
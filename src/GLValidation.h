@@ -0,0 +1,42 @@
+#pragma once
+
+#include <glad/glad.h>
+
+//
+// GL error checking & debug output. Checking for errors after every call (with glGetError) and synchronous debug output
+// both serialize the driver, so they are only used in the modes that need them:
+//
+//   Off:     nothing is checked
+//   Async:   debug output is enabled, but the driver may report messages late and from another thread
+//   Sampled: like async, but every Nth frame is checked like in full mode
+//   Full:    glGetError after every call, synchronous debug output, and the call site is captured on errors
+//
+namespace GLValidation
+{
+	enum class Mode
+	{
+		Off,
+		Async,
+		Sampled,
+		Full,
+		Count
+	};
+
+	// Requires a current context
+	void Init(Mode mode);
+
+	void SetMode(Mode mode);
+	Mode GetMode();
+	const char* ModeName(Mode mode);
+
+	// Call at the start of every frame and before swapping buffers. The time in between is what's measured for the
+	// benchmark, so that e.g. waiting for vsync doesn't hide the overhead.
+	void BeginFrame();
+	void EndFrame();
+
+	// Runs each mode for the given number of frames and reports the average CPU frame time per mode. The mode that was
+	// active when the benchmark started is restored when it's done.
+	void StartBenchmark(int framesPerMode = 200);
+
+	void DrawGui();
+}
@@ -6,10 +6,12 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <imgui.h>
 
+#include "GLState.h"
 #include "Maths.h"
 #include "Logging.h"
 #include "Material.h"
 #include "GuiSystem.h"
+#include "TextureSystem.h"
 #include "TransformSystem.h"
 
 #include "shader_locations.h"
@@ -53,7 +55,10 @@ GeometryPass::Draw(const GBuffer& gBuffer, Scene& scene)
 
 	const uint8_t magenta[] = { 255, 0, 255, 255 };
 	glClearTexImage(gBuffer.albedoTexture, 0, GL_RGBA, GL_UNSIGNED_BYTE, magenta);
-	glClearTexImage(gBuffer.materialTexture, 0, GL_RGBA, GL_UNSIGNED_BYTE, magenta);
+	if (gBuffer.materialTexture)
+	{
+		glClearTexImage(gBuffer.materialTexture, 0, GL_RGBA, GL_UNSIGNED_BYTE, magenta);
+	}
 
 	const float clear[] = { 0.0f, 0.0f, 0.0f, 0.0f };
 	glClearTexImage(gBuffer.normVelTexture, 0, GL_RGBA, GL_FLOAT, clear);
@@ -61,42 +66,42 @@ GeometryPass::Draw(const GBuffer& gBuffer, Scene& scene)
 	const float farDepth = 1.0f;
 	glClearTexImage(gBuffer.depthTexture, 0, GL_DEPTH_COMPONENT, GL_FLOAT, &farDepth);
 
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, gBuffer.framebuffer);
-	glViewport(0, 0, gBuffer.width, gBuffer.height);
+	GLState::BindFramebuffer(gBuffer.framebuffer);
+	GLState::Viewport(0, 0, gBuffer.renderWidth, gBuffer.renderHeight);
 
-	glEnable(GL_CULL_FACE);
-	glCullFace(GL_BACK);
-	glFrontFace(GL_CW);
+	GLState::Enable(GL_CULL_FACE);
+	GLState::CullFace(GL_BACK);
+	GLState::FrontFace(GL_CW);
 
-	glEnable(GL_DEPTH_TEST);
-	glDepthFunc(GL_LEQUAL);
+	GLState::Enable(GL_DEPTH_TEST);
+	GLState::DepthFunc(GL_LEQUAL);
 
-	glPolygonMode(GL_FRONT_AND_BACK, wireframeRendering ? GL_LINE : GL_FILL);
+	GLState::PolygonMode(wireframeRendering ? GL_LINE : GL_FILL);
 
 	if (performDepthPrepass)
 	{
-		glDepthMask(true);
-		glColorMask(false, false, false, false);
+		GLState::DepthMask(true);
+		GLState::ColorMask(false, false, false, false);
 
 		if (!depthOnlyProgram)
 		{
 			ShaderSystem::AddProgram("material/depth_only", this);
 		}
 
-		glUseProgram(depthOnlyProgram);
+		GLState::UseProgram(depthOnlyProgram);
 		for (const Model& model : geometryToRender)
 		{
 			// TODO: Use linear uniform buffer for transforms instead? Would be very performant in this case!
 			Transform& transform = TransformSystem::Get(model.transformID);
 			glUniformMatrix4fv(modelMatrixLocation, 1, false, glm::value_ptr(transform.matrix));
 
-			if (model.material->cullBackfaces) glEnable(GL_CULL_FACE);
-			else glDisable(GL_CULL_FACE);
+			if (model.material->cullBackfaces) GLState::Enable(GL_CULL_FACE);
+			else GLState::Disable(GL_CULL_FACE);
 
 			model.Draw();
 		}
 
-		glColorMask(true, true, true, true);
+		GLState::ColorMask(true, true, true, true);
 	}
 
 	// Sort geometry so that we can optimize the number of shader program switches, i.e. calling glUseProgram
@@ -104,8 +109,8 @@ GeometryPass::Draw(const GBuffer& gBuffer, Scene& scene)
 
 	if (performDepthPrepass)
 	{
-		glDepthMask(false);
-		glDepthFunc(GL_EQUAL);
+		GLState::DepthMask(false);
+		GLState::DepthFunc(GL_EQUAL);
 	}
 
 	int numDrawCalls = 0;
@@ -123,16 +128,17 @@ GeometryPass::Draw(const GBuffer& gBuffer, Scene& scene)
 
 		if (program != lastProgram)
 		{
-			glUseProgram(program);
+			GLState::UseProgram(program);
 			lastProgram = program;
 		}
 
 		Transform& transform = TransformSystem::Get(model.transformID);
 		const Transform& prevTransform = TransformSystem::GetPrevious(model.transformID);
 		model.material->BindUniforms(transform, prevTransform);
+		glUniform1i(PredefinedUniformLocation(u_material_index), model.material->materialIndex);
 
-		if (model.material->cullBackfaces) glEnable(GL_CULL_FACE);
-		else glDisable(GL_CULL_FACE);
+		if (model.material->cullBackfaces) GLState::Enable(GL_CULL_FACE);
+		else GLState::Disable(GL_CULL_FACE);
 
 		model.Draw();
 
@@ -140,10 +146,10 @@ GeometryPass::Draw(const GBuffer& gBuffer, Scene& scene)
 		numTriangles += TriangleCount(model);
 	}
 
-	glDepthMask(true);
-	glDepthFunc(GL_LEQUAL);
-	glEnable(GL_CULL_FACE);
-	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	GLState::DepthMask(true);
+	GLState::DepthFunc(GL_LEQUAL);
+	GLState::Enable(GL_CULL_FACE);
+	GLState::PolygonMode(GL_FILL);
 
 	if (ImGui::CollapsingHeader("Geometry pass"))
 	{
@@ -153,11 +159,23 @@ GeometryPass::Draw(const GBuffer& gBuffer, Scene& scene)
 		if (performDepthPrepass) ImGui::Text("Draw calls: %d (with depth-prepass)", 2 * numDrawCalls);
 		else ImGui::Text("Draw calls: %d", numDrawCalls);
 		ImGui::Text("Triangles:  %d", numTriangles);
+
+		ImGui::Text("Atlased textures: %d", TextureSystem::GetAtlasTextureCount());
+
+		auto streaming = TextureSystem::GetStreamingStats();
+		if (streaming.streamedTextureCount > 0)
+		{
+			const float MB = 1024.0f * 1024.0f;
+			ImGui::Separator();
+			ImGui::Text("Streamed textures: %d", streaming.streamedTextureCount);
+			ImGui::Text("Resident: %.1f MB of %.1f MB (budget %.1f MB)", streaming.residentBytes / MB, streaming.fullResolutionBytes / MB, streaming.budget / MB);
+			ImGui::Text("Uploads last frame: %d", streaming.uploadsLastFrame);
+		}
 	}
 }
 
 void GeometryPass::ProgramLoaded(GLuint program)
 {
 	depthOnlyProgram = program;
-	modelMatrixLocation = glGetUniformLocation(depthOnlyProgram, "u_world_from_local");
+	modelMatrixLocation = ShaderSystem::GetUniformLocation(depthOnlyProgram, "u_world_from_local");
 }
@@ -0,0 +1,68 @@
+#include "GpuTimer.h"
+
+#include <cassert>
+
+bool
+GpuTimer::Begin(int variant)
+{
+	if (!queries[0][0])
+	{
+		glCreateQueries(GL_TIMESTAMP, 2 * MAX_TIMESTAMPS, &queries[0][0]);
+	}
+
+	int queryIndex = frameIndex++ % 2;
+
+	// (the timestamps of the slot were written two frames ago, if at all)
+	int count = timestampCount[queryIndex];
+	bool hasResult = count >= 2;
+	if (hasResult)
+	{
+		GLuint64 timestamps[MAX_TIMESTAMPS];
+		for (int i = 0; i < count; ++i)
+		{
+			glGetQueryObjectui64v(queries[queryIndex][i], GL_QUERY_RESULT, &timestamps[i]);
+		}
+		for (int i = 0; i < count - 1; ++i)
+		{
+			latestMs[i] = double(timestamps[i + 1] - timestamps[i]) / 1e6;
+		}
+		latestVariant = variants[queryIndex];
+	}
+
+	glQueryCounter(queries[queryIndex][0], GL_TIMESTAMP);
+	timestampCount[queryIndex] = 1;
+	variants[queryIndex] = variant;
+
+	return hasResult;
+}
+
+void
+GpuTimer::Split()
+{
+	int queryIndex = (frameIndex - 1) % 2;
+	assert(timestampCount[queryIndex] > 0 && timestampCount[queryIndex] < MAX_TIMESTAMPS - 1);
+
+	glQueryCounter(queries[queryIndex][timestampCount[queryIndex]++], GL_TIMESTAMP);
+}
+
+void
+GpuTimer::End()
+{
+	int queryIndex = (frameIndex - 1) % 2;
+	assert(timestampCount[queryIndex] > 0 && timestampCount[queryIndex] < MAX_TIMESTAMPS);
+
+	glQueryCounter(queries[queryIndex][timestampCount[queryIndex]++], GL_TIMESTAMP);
+}
+
+double
+GpuTimer::LatestMs(int interval) const
+{
+	assert(interval >= 0 && interval < MAX_TIMESTAMPS - 1);
+	return latestMs[interval];
+}
+
+int
+GpuTimer::LatestVariant() const
+{
+	return latestVariant;
+}
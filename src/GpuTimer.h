@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glad/glad.h>
+
+//
+// GL_TIMESTAMP queries around a range of GPU work. The timestamps of a frame are read back two frames later, by when
+// they should be available, so reading them doesn't stall on the GPU. The range can be split into multiple intervals
+// (e.g. culling & shading), and a variant can be passed to Begin to know e.g. which of two paths the result is for.
+//
+class GpuTimer
+{
+public:
+
+	static const int MAX_TIMESTAMPS{ 4 };
+
+	// Reads back the timestamps from two frames ago and writes the first timestamp of this frame. Returns true if there
+	// was a result to read, which is then available from LatestMs & LatestVariant until the next call.
+	bool Begin(int variant = 0);
+
+	// Ends the current interval and starts the next one
+	void Split();
+
+	void End();
+
+	// The GPU time of the given interval of the latest result (with no splits, interval 0 is the whole range)
+	double LatestMs(int interval = 0) const;
+	int LatestVariant() const;
+
+private:
+
+	GLuint queries[2][MAX_TIMESTAMPS]{};
+	int timestampCount[2]{};
+	int variants[2]{};
+	uint64_t frameIndex{ 0 };
+
+	double latestMs[MAX_TIMESTAMPS - 1]{};
+	int latestVariant{ 0 };
+
+};
@@ -5,6 +5,7 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "GLState.h"
 #include "ShaderSystem.h"
 
 #include "shader_locations.h"
@@ -40,7 +41,7 @@ GuiSystem::Init(GLFWwindow *targetWindow)
 	// Setup GUI vertex array and buffers
 
 	glCreateVertexArrays(1, &vertexArray);
-	glBindVertexArray(vertexArray);
+	GLState::BindVertexArray(vertexArray);
 
 	glCreateBuffers(1, &vertexBuffer);
 	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
@@ -57,7 +58,7 @@ GuiSystem::Init(GLFWwindow *targetWindow)
 	glCreateBuffers(1, &indexBuffer);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
 
-	glBindVertexArray(0);
+	GLState::BindVertexArray(0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
@@ -125,10 +126,10 @@ GuiSystem::Init(GLFWwindow *targetWindow)
 void
 GuiSystem::Destroy()
 {
-	glDeleteVertexArrays(1, &vertexArray);
+	GLState::DeleteVertexArrays(1, &vertexArray);
 	glDeleteBuffers(1, &vertexBuffer);
 	glDeleteBuffers(1, &indexBuffer);
-	glDeleteTextures(1, &fontTexture);
+	GLState::DeleteTextures(1, &fontTexture);
 
 	for (int i = 0; i < ImGuiMouseCursor_COUNT; ++i)
 	{
@@ -232,16 +233,16 @@ GuiSystem::RenderDrawData(ImDrawData *data)
 	data->ScaleClipRects(io.DisplayFramebufferScale);
 
 	// Setup render state: alpha-blending enabled, no face culling, no depth testing, scissor enabled, polygon fill
-	glEnable(GL_BLEND);
-	glBlendEquation(GL_FUNC_ADD);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glDisable(GL_CULL_FACE);
-	glDisable(GL_DEPTH_TEST);
-	glEnable(GL_SCISSOR_TEST);
-	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	GLState::Enable(GL_BLEND);
+	GLState::BlendEquation(GL_FUNC_ADD);
+	GLState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLState::Disable(GL_CULL_FACE);
+	GLState::Disable(GL_DEPTH_TEST);
+	GLState::Enable(GL_SCISSOR_TEST);
+	GLState::PolygonMode(GL_FILL);
 
 	// Setup viewport, orthographic projection matrix
-	glViewport(0, 0, (GLsizei)fbWidth, (GLsizei)fbHeight);
+	GLState::Viewport(0, 0, (GLsizei)fbWidth, (GLsizei)fbHeight);
 	glm::mat4 projection = glm::mat4{
 		2.0f / io.DisplaySize.x, 0.0f,                   0.0f, 0.0f,
 		0.0f,                  2.0f / -io.DisplaySize.y, 0.0f, 0.0f,
@@ -249,9 +250,9 @@ GuiSystem::RenderDrawData(ImDrawData *data)
 		-1.0f,                 1.0f,                   0.0f, 1.0f
 	};
 
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
-	glBindVertexArray(vertexArray);
-	glUseProgram(*shaderProgram);
+	GLState::BindFramebuffer(0);
+	GLState::BindVertexArray(vertexArray);
+	GLState::UseProgram(*shaderProgram);
 
 	GLint textureUnit = 0;
 	glUniform1i(PredefinedUniformLocation(u_gui_texture), textureUnit);
@@ -288,7 +289,7 @@ GuiSystem::RenderDrawData(ImDrawData *data)
 					glScissor((int)clip_rect.x, (int)(fbHeight - clip_rect.w), (int)(clip_rect.z - clip_rect.x), (int)(clip_rect.w - clip_rect.y));
 
 					// Bind texture, Draw
-					glBindTextureUnit(textureUnit, (GLuint)(intptr_t)pcmd->TextureId);
+					GLState::BindTextureUnit(textureUnit, (GLuint)(intptr_t)pcmd->TextureId);
 					glDrawElements(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, idx_buffer_offset);
 				}
 			}
@@ -296,13 +297,13 @@ GuiSystem::RenderDrawData(ImDrawData *data)
 		}
 	}
 
-	// Restore to a "sane default" ... yeah, not great.
-	glDisable(GL_SCISSOR_TEST);
-	glDisable(GL_BLEND);
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_CULL_FACE);
+	// Restore the defaults that the passes assume (which is cheap through the state cache, as long as they match)
+	GLState::Disable(GL_SCISSOR_TEST);
+	GLState::Disable(GL_BLEND);
+	GLState::Enable(GL_DEPTH_TEST);
+	GLState::Enable(GL_CULL_FACE);
 
-	glBindVertexArray(0);
+	GLState::BindVertexArray(0);
 }
 
 bool
@@ -6,7 +6,9 @@
 
 #include <imgui.h>
 
+#include "GLState.h"
 #include "GuiSystem.h"
+#include "GLValidation.h"
 #include "TransformSystem.h"
 #include "MaterialSystem.h"
 #include "TextureSystem.h"
@@ -69,6 +71,12 @@ App::Settings IBLDemo::Setup()
 
 void IBLDemo::Init()
 {
+	// Stream the mip levels of the scene textures, as requested by the texture feedback
+	TextureSystem::SetStreamingBudget(256 * 1024 * 1024);
+
+	// Pack the many small material textures into shared atlases
+	TextureSystem::SetAtlasMaxTextureSize(256);
+
 	ModelSystem::LoadModel("assets/generic/sphere.obj", [&](std::vector<Model> models) {
 
 		assert(models.size() == 1);
@@ -194,8 +202,26 @@ void IBLDemo::Init()
 	sun.softness.x = 2.3f;
 	scene.directionalLights.push_back(sun);
 
+	// A few colored point lights around the spheres, and a spot light on the gun
+	for (int i = 0; i < 6; ++i)
+	{
+		float angle = glm::two_pi<float>() * float(i) / 6.0f;
+
+		PointLight pointLight;
+		pointLight.worldPosition = glm::vec4(8.0f + 14.0f * std::cos(angle), 6.0f + 3.0f * float(i % 2), -4.0f + 14.0f * std::sin(angle), 16.0f);
+		pointLight.color = Color(0.5f + 0.5f * std::cos(angle), 0.5f + 0.5f * std::cos(angle + 2.1f), 0.5f + 0.5f * std::cos(angle + 4.2f), 0.7f);
+		scene.pointLights.push_back(pointLight);
+	}
+
+	SpotLight spotLight;
+	spotLight.worldPosition = glm::vec4(38.0f, 25.0f, -22.0f, 40.0f);
+	spotLight.worldDirection = glm::vec4(glm::normalize(glm::vec3(0.0f, -15.0f, 12.0f)), 0.0f);
+	spotLight.color = Color(1.0f, 0.9f, 0.75f, 0.85f);
+	spotLight.cone = glm::vec4(std::cos(glm::radians(25.0f)), std::cos(glm::radians(18.0f)), std::sin(glm::radians(25.0f)), 0.0f);
+	scene.spotLights.push_back(spotLight);
+
 	//scene.skyProbe.radiance = TextureSystem::LoadHdrImage("assets/env/rooftop_night/sky_2k.hdr");
-	scene.skyProbe.radiance = TextureSystem::LoadHdrImage("assets/env/aero_lab/aerodynamics_workshop_8k.hdr");
+	scene.skyProbe.radiance = TextureSystem::LoadHdrImage("assets/env/aero_lab/aerodynamics_workshop_8k.hdr", GL_R11F_G11F_B10F);
 	//scene.skyProbe.radiance = TextureSystem::CreatePlaceholder(255, 255, 255);
 
 	scene.mainCamera.reset(new FpsCamera());
@@ -218,6 +244,9 @@ void IBLDemo::Draw(const Input& input, float deltaTime, float runningTime)
 {
 	ImGui::Begin("Prospect - IBL demo");
 	ImGui::Text("Frame time: %.1f ms", deltaTime * 1000);
+	GLState::Stats glStateStats = GLState::GetFrameStats();
+	ImGui::Text("GL state calls: %d issued, %d avoided", glStateStats.issuedCalls, glStateStats.avoidedCalls);
+	GLValidation::DrawGui();
 	if (input.WasKeyPressed(GLFW_KEY_HOME))
 	{
 		ImGui::SetWindowPos(ImVec2(0, 1));
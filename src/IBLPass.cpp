@@ -4,6 +4,7 @@
 
 #include <imgui.h>
 
+#include "GLState.h"
 #include "Scene.h"
 #include "GuiSystem.h"
 #include "ModelSystem.h"
@@ -20,7 +21,10 @@ IBLPass::Draw(const LightBuffer& lightBuffer, const GBuffer& gBuffer, const SSAO
 {
 	if (!iblProgram)
 	{
-		ShaderSystem::AddProgram("light/ibl", this);
+		ShaderSystem::AddProgram(&iblProgram, "light/ibl.vert.glsl", "light/ibl.frag.glsl", this);
+		ShaderSystem::AddComputeProgram(&resizeProgram, "etc/resize.comp.glsl", this);
+		ShaderSystem::AddComputeProgram(&filterRadianceProgram, "ibl/filter_radiance.comp.glsl", this);
+		ShaderSystem::AddComputeProgram(&createShProgram, "ibl/create_sh.comp.glsl", this);
 	}
 
 	if (!brdfIntegrationMap) { CreateBrdfIntegrationMap(); }
@@ -64,49 +68,66 @@ IBLPass::Draw(const LightBuffer& lightBuffer, const GBuffer& gBuffer, const SSAO
 		GuiSystem::Texture(brdfIntegrationMap, 1.0f);
 	}
 
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, lightBuffer.framebuffer);
-	glViewport(0, 0, lightBuffer.width, lightBuffer.height);
+	GLState::BindFramebuffer(lightBuffer.framebuffer);
+	GLState::Viewport(0, 0, lightBuffer.renderWidth, lightBuffer.renderHeight);
 
-	glUseProgram(iblProgram);
-	glDisable(GL_DEPTH_TEST);
+	GLState::UseProgram(*iblProgram);
+	GLState::Disable(GL_DEPTH_TEST);
 
-	glBindTextureUnit(0, gBuffer.albedoTexture);
-	glBindTextureUnit(1, gBuffer.materialTexture);
-	glBindTextureUnit(2, gBuffer.normVelTexture);
-	glBindTextureUnit(3, gBuffer.depthTexture);
+	GLState::BindTextureUnit(0, gBuffer.albedoTexture);
+	GLState::BindTextureUnit(1, gBuffer.materialTexture);
+	GLState::BindTextureUnit(2, gBuffer.normVelTexture);
+	GLState::BindTextureUnit(3, gBuffer.depthTexture);
 
-	glBindTextureUnit(5, scene.skyProbe.diffuseIrradianceSh);
-	glBindTextureUnit(6, scene.skyProbe.filteredRadiance);
-	glBindTextureUnit(7, brdfIntegrationMap);
+	GLState::BindTextureUnit(5, scene.skyProbe.diffuseIrradianceSh);
+	GLState::BindTextureUnit(6, scene.skyProbe.filteredRadiance);
+	GLState::BindTextureUnit(7, brdfIntegrationMap);
 
-	glBindTextureUnit(8, ssaoPass.occlusionTexture);
+	GLState::BindTextureUnit(8, ssaoPass.occlusionTexture);
 
 	FullscreenQuad::Draw();
 
-	glEnable(GL_DEPTH_TEST);
+	GLState::Enable(GL_DEPTH_TEST);
 }
 
 void
 IBLPass::ProgramLoaded(GLuint program)
 {
-	iblProgram = program;
+	if (iblProgram && program == *iblProgram)
+	{
+		glProgramUniform1i(program, PredefinedUniformLocation(u_g_buffer_albedo), 0);
+		glProgramUniform1i(program, PredefinedUniformLocation(u_g_buffer_material), 1);
+		glProgramUniform1i(program, PredefinedUniformLocation(u_g_buffer_norm_vel), 2);
+		glProgramUniform1i(program, PredefinedUniformLocation(u_g_buffer_depth), 3);
 
-	glProgramUniform1i(iblProgram, PredefinedUniformLocation(u_g_buffer_albedo), 0);
-	glProgramUniform1i(iblProgram, PredefinedUniformLocation(u_g_buffer_material), 1);
-	glProgramUniform1i(iblProgram, PredefinedUniformLocation(u_g_buffer_norm_vel), 2);
-	glProgramUniform1i(iblProgram, PredefinedUniformLocation(u_g_buffer_depth), 3);
+		GLint locIrradianceSh = ShaderSystem::GetUniformLocation(program, "u_irradiance_sh");
+		glProgramUniform1i(program, locIrradianceSh, 5);
 
-	GLint locIrradianceSh = glGetUniformLocation(iblProgram, "u_irradiance_sh");
-	glProgramUniform1i(iblProgram, locIrradianceSh, 5);
+		GLint locRadiance = ShaderSystem::GetUniformLocation(program, "u_radiance");
+		glProgramUniform1i(program, locRadiance, 6);
 
-	GLint locRadiance = glGetUniformLocation(iblProgram, "u_radiance");
-	glProgramUniform1i(iblProgram, locRadiance, 6);
+		GLint locBrdf = ShaderSystem::GetUniformLocation(program, "u_brdf_integration_map");
+		glProgramUniform1i(program, locBrdf, 7);
 
-	GLint locBrdf = glGetUniformLocation(iblProgram, "u_brdf_integration_map");
-	glProgramUniform1i(iblProgram, locBrdf, 7);
+		GLint locOcclusion = ShaderSystem::GetUniformLocation(program, "u_occlusion_texture");
+		glProgramUniform1i(program, locOcclusion, 8);
+	}
 
-	GLint locOcclusion = glGetUniformLocation(iblProgram, "u_occlusion_texture");
-	glProgramUniform1i(iblProgram, locOcclusion, 8);
+	if (resizeProgram && program == *resizeProgram)
+	{
+		glProgramUniform1i(program, ShaderSystem::GetUniformLocation(program, "u_source"), 0);
+	}
+
+	if (filterRadianceProgram && program == *filterRadianceProgram)
+	{
+		glProgramUniform1i(program, ShaderSystem::GetUniformLocation(program, "u_radiance"), 0);
+		roughnessLoc = ShaderSystem::GetUniformLocation(program, "u_roughness");
+	}
+
+	if (createShProgram && program == *createShProgram)
+	{
+		glProgramUniform1i(program, ShaderSystem::GetUniformLocation(program, "u_radiance"), 0);
+	}
 }
 
 void
@@ -128,7 +149,7 @@ IBLPass::CreateBrdfIntegrationMap()
 
 	GLuint program = *ShaderSystem::AddComputeProgram("ibl/brdf_map.comp.glsl");
 
-	glUseProgram(program);
+	GLState::UseProgram(program);
 	glDispatchCompute(size, size, 1);
 
 	// NOTE: This might not be required here, since we don't need the result immediatly
@@ -156,14 +177,11 @@ IBLPass::FilterProbe(Probe& probe)
 	glTextureParameteri(squareMap, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	glTextureParameteri(squareMap, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-	static GLuint *resizeProgram = ShaderSystem::AddComputeProgram("etc/resize.comp.glsl");
-
-	glProgramUniform1i(*resizeProgram, glGetUniformLocation(*resizeProgram, "u_source"), 0);
-	glBindTextureUnit(0, probe.radiance);
+	GLState::BindTextureUnit(0, probe.radiance);
 
 	glBindImageTexture(0, squareMap, 0, GL_FALSE, 0, GL_WRITE_ONLY, format);
 
-	glUseProgram(*resizeProgram);
+	GLState::UseProgram(*resizeProgram);
 	glDispatchCompute(IBL_RADIANCE_BASE_SIZE / 32, IBL_RADIANCE_BASE_SIZE / 32, 1);
 
 	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
@@ -182,19 +200,14 @@ IBLPass::FilterProbe(Probe& probe)
 		glTextureParameteri(filteredMap, GL_TEXTURE_WRAP_S, GL_REPEAT);
 		glTextureParameteri(filteredMap, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-		static GLuint *program = ShaderSystem::AddComputeProgram("ibl/filter_radiance.comp.glsl");
-		glUseProgram(*program);
-
-		glProgramUniform1i(*program, glGetUniformLocation(*program, "u_radiance"), 0);
-		glBindTextureUnit(0, squareMap);
-
-		GLint roughnessLocation = glGetUniformLocation(*program, "u_roughness");
+		GLState::UseProgram(*filterRadianceProgram);
+		GLState::BindTextureUnit(0, squareMap);
 
 		for (int level = 0; level < numLevels; ++level)
 		{
 			float roughness = float(level) / float(numLevels - 1);
 
-			glProgramUniform1f(*program, roughnessLocation, roughness);
+			glProgramUniform1f(*filterRadianceProgram, roughnessLoc, roughness);
 			glBindImageTexture(0, filteredMap, level, GL_FALSE, 0, GL_WRITE_ONLY, format);
 
 			int textureSize = IBL_RADIANCE_BASE_SIZE / int(pow(2, level));
@@ -217,8 +230,7 @@ IBLPass::FilterProbe(Probe& probe)
 		glTextureParameteri(shMap, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 		glTextureParameteri(shMap, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-		static GLuint *program = ShaderSystem::AddComputeProgram("ibl/create_sh.comp.glsl");
-		glUseProgram(*program);
+		GLState::UseProgram(*createShProgram);
 
 		if (!sphereSampleBuffer)
 		{
@@ -247,8 +259,7 @@ IBLPass::FilterProbe(Probe& probe)
 			glBindBufferBase(GL_UNIFORM_BUFFER, PredefinedUniformBlockBinding(SphereSampleBuffer), sphereSampleBuffer);
 		}
 
-		glProgramUniform1i(*program, glGetUniformLocation(*program, "u_radiance"), 0);
-		glBindTextureUnit(0, squareMap);
+		GLState::BindTextureUnit(0, squareMap);
 
 		glBindImageTexture(0, shMap, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA16F);
 
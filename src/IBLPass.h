@@ -21,7 +21,12 @@ private:
 	void CreateBrdfIntegrationMap();
 	void FilterProbe(Probe& probe);
 
-	GLuint iblProgram{ 0 };
+	GLuint *iblProgram{ nullptr };
+
+	GLuint *resizeProgram{ nullptr };
+	GLuint *filterRadianceProgram{ nullptr };
+	GLuint *createShProgram{ nullptr };
+	GLint roughnessLoc{ -1 };
 
 	GLuint brdfIntegrationMap{ 0 };
 	GLuint sphereSampleBuffer{ 0 };
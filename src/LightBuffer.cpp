@@ -1,19 +1,23 @@
 #include "LightBuffer.h"
 
+#include "GLState.h"
 #include "Logging.h"
 #include "TextureSystem.h"
 
 #include "shader_locations.h"
+#include "light_formats.h"
 
 void
 LightBuffer::RecreateGpuResources(int width, int height, const GBuffer& gBuffer)
 {
 	this->width = width;
 	this->height = height;
+	this->renderWidth = width;
+	this->renderHeight = height;
 
 	// Docs: "glDeleteTextures silently ignores 0's and names that do not correspond to existing textures."
-	glDeleteTextures(1, &lightTexture);
-	lightTexture = TextureSystem::CreateTexture(width, height, GL_RGBA32F, GL_NEAREST, GL_NEAREST);
+	GLState::DeleteTextures(1, &lightTexture);
+	lightTexture = TextureSystem::CreateTexture(width, height, LIGHT_BUFFER_INTERNAL_FORMAT, GL_NEAREST, GL_NEAREST);
 
 	if (!framebuffer)
 	{
@@ -34,7 +38,7 @@ LightBuffer::RecreateGpuResources(int width, int height, const GBuffer& gBuffer)
 
 	for (int i = 0; i < 2; ++i)
 	{
-		glDeleteTextures(1, &taaHistoryTextures[i]);
-		taaHistoryTextures[i] = TextureSystem::CreateTexture(width, height, GL_RGBA32F, GL_LINEAR, GL_LINEAR, false);
+		GLState::DeleteTextures(1, &taaHistoryTextures[i]);
+		taaHistoryTextures[i] = TextureSystem::CreateTexture(width, height, TAA_HISTORY_INTERNAL_FORMAT, GL_LINEAR, GL_LINEAR, false);
 	}
 }
@@ -9,12 +9,16 @@ struct LightBuffer
 	int width;
 	int height;
 
+	// The part of the textures that is rendered to, i.e. smaller than width x height with dynamic resolution
+	int renderWidth;
+	int renderHeight;
+
 	GLuint framebuffer;
 
-	// RGBA32F: RGB - accumulated light contribution, A - unused, for now
+	// LIGHT_BUFFER_INTERNAL_FORMAT: RGB - accumulated light contribution, A - unused, for now
 	GLuint lightTexture = 0;
 
-	// RGBA32F: RGB - history buffers for TAA, A - unused
+	// TAA_HISTORY_INTERNAL_FORMAT: RGB - history buffers for TAA, A - unused
 	GLuint taaHistoryTextures[2];
 
 	////////////////////////////
@@ -2,21 +2,31 @@
 
 #include <imgui.h>
 
+#include "GLState.h"
 #include "Scene.h"
 #include "GuiSystem.h"
+#include "ShaderSystem.h"
 #include "TextureSystem.h"
 #include "FullscreenQuad.h"
 
 using namespace glm;
 #include "shader_locations.h"
 #include "shader_types.h"
+#include "light_formats.h"
 
 void
 LightPass::Draw(const LightBuffer& lightBuffer, const GBuffer& gBuffer, const ShadowMap& shadowMap, Scene& scene)
 {
-	if (!directionalLightProgram)
+	// Add all permutations up front, where the ones that aren't selected are compiled in the background. Selecting a
+	// permutation that isn't ready yet will wait for it.
+	for (int filter = 0; filter < 2; ++filter)
 	{
-		ShaderSystem::AddProgram("light/directional", this);
+		bool selected = filter == shadowFilter;
+		if (!directionalLightPrograms[filter] || (selected && !*directionalLightPrograms[filter]))
+		{
+			std::string defines = "SHADOW_FILTER=" + std::to_string(filter);
+			ShaderSystem::AddProgramPermutation(&directionalLightPrograms[filter], "light/directional.vert.glsl", "light/directional.frag.glsl", defines, this, selected);
+		}
 	}
 
 	if (!directionalLightUniformBuffer)
@@ -27,53 +37,65 @@ LightPass::Draw(const LightBuffer& lightBuffer, const GBuffer& gBuffer, const Sh
 	}
 
 	// Bind the g-buffer
-	glBindTextureUnit(0, gBuffer.albedoTexture);
-	glBindTextureUnit(1, gBuffer.materialTexture);
-	glBindTextureUnit(2, gBuffer.normVelTexture);
-	glBindTextureUnit(3, gBuffer.depthTexture);
+	GLState::BindTextureUnit(0, gBuffer.albedoTexture);
+	GLState::BindTextureUnit(1, gBuffer.materialTexture);
+	GLState::BindTextureUnit(2, gBuffer.normVelTexture);
+	GLState::BindTextureUnit(3, gBuffer.depthTexture);
 
 	// Bind the shadow map
-	glBindTextureUnit(10, shadowMap.texture);
+	GLState::BindTextureUnit(10, shadowMap.texture);
 
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, lightBuffer.framebuffer);
-	glViewport(0, 0, lightBuffer.width, lightBuffer.height);
+	GLState::BindFramebuffer(lightBuffer.framebuffer);
+	GLState::Viewport(0, 0, lightBuffer.renderWidth, lightBuffer.renderHeight);
 
-	glUseProgram(directionalLightProgram);
-	{
-		assert(scene.directionalLights.size() == 1);
-		auto& dirLight = scene.directionalLights[0];
+	GLState::UseProgram(*directionalLightPrograms[shadowFilter]);
 
-		dirLight.viewDirecion = scene.mainCamera->GetViewMatrix() * dirLight.worldDirection;
-		glNamedBufferSubData(directionalLightUniformBuffer, 0, sizeof(DirectionalLight), &dirLight);
+	GLState::Enable(GL_BLEND);
+	GLState::BlendFunc(GL_ONE, GL_ONE);
+	GLState::BlendEquation(GL_FUNC_ADD);
 
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_ONE, GL_ONE);
-		glBlendEquation(GL_FUNC_ADD);
+	GLState::Disable(GL_DEPTH_TEST);
 
-		glDisable(GL_DEPTH_TEST);
+	// (there are usually very few directional lights, point & spot lights are handled by LocalLightPass)
+	for (DirectionalLight& dirLight : scene.directionalLights)
+	{
+		dirLight.viewDirecion = scene.mainCamera->GetViewMatrix() * dirLight.worldDirection;
+		glNamedBufferSubData(directionalLightUniformBuffer, 0, sizeof(DirectionalLight), &dirLight);
 
 		FullscreenQuad::Draw();
-
-		glEnable(GL_DEPTH_TEST);
-		glDisable(GL_BLEND);
 	}
 
+	GLState::Enable(GL_DEPTH_TEST);
+	GLState::Disable(GL_BLEND);
+
 	if (ImGui::CollapsingHeader("Light pass"))
 	{
-		ImGui::SliderFloat("Sun intensity", &scene.directionalLights[0].color.a, 0.0f, 1.0f);
-		ImGui::SliderFloat("Sun softness", &scene.directionalLights[0].softness.x, 0.0f, 7.0f);
+		if (!scene.directionalLights.empty())
+		{
+			ImGui::SliderFloat("Sun intensity", &scene.directionalLights[0].color.a, 0.0f, 1.0f);
+			ImGui::SliderFloat("Sun softness", &scene.directionalLights[0].softness.x, 0.0f, 7.0f);
+		}
+
+		const char *shadowFilters[] = { "Hard", "Soft" };
+		ImGui::Combo("Shadow filter", &shadowFilter, shadowFilters, IM_ARRAYSIZE(shadowFilters));
+
 		GuiSystem::Texture(lightBuffer.lightTexture);
+
+		// Memory (and bandwidth, for every full-screen read or write) compared to the RGBA32F baseline
+		float pixelsInMb = float(lightBuffer.width * lightBuffer.height) / (1024.0f * 1024.0f);
+		float baselineMb = pixelsInMb * TextureSystem::BytesPerTexel(GL_RGBA32F);
+		ImGui::Text("Light buffer: %.1f MB (%.1f MB as RGBA32F)", pixelsInMb * TextureSystem::BytesPerTexel(LIGHT_BUFFER_INTERNAL_FORMAT), baselineMb);
+		ImGui::Text("TAA history:  %.1f MB (%.1f MB as RGBA32F)", 2.0f * pixelsInMb * TextureSystem::BytesPerTexel(TAA_HISTORY_INTERNAL_FORMAT), 2.0f * baselineMb);
 	}
 }
 
 void LightPass::ProgramLoaded(GLuint program)
 {
-	directionalLightProgram = program;
-
-	glProgramUniform1i(directionalLightProgram, PredefinedUniformLocation(u_g_buffer_albedo), 0);
-	glProgramUniform1i(directionalLightProgram, PredefinedUniformLocation(u_g_buffer_material), 1);
-	glProgramUniform1i(directionalLightProgram, PredefinedUniformLocation(u_g_buffer_norm_vel), 2);
-	glProgramUniform1i(directionalLightProgram, PredefinedUniformLocation(u_g_buffer_depth), 3);
+	// (called for every permutation)
+	glProgramUniform1i(program, PredefinedUniformLocation(u_g_buffer_albedo), 0);
+	glProgramUniform1i(program, PredefinedUniformLocation(u_g_buffer_material), 1);
+	glProgramUniform1i(program, PredefinedUniformLocation(u_g_buffer_norm_vel), 2);
+	glProgramUniform1i(program, PredefinedUniformLocation(u_g_buffer_depth), 3);
 
-	glProgramUniform1i(directionalLightProgram, PredefinedUniformLocation(u_shadow_map), 10);
+	glProgramUniform1i(program, PredefinedUniformLocation(u_shadow_map), 10);
 }
@@ -19,7 +19,10 @@ public:
 
 private:
 
-	GLuint directionalLightProgram{ 0 };
+	// One program permutation per shadow filter (SHADOW_FILTER in the shader)
+	int shadowFilter = 1;
+	GLuint *directionalLightPrograms[2]{};
+
 	GLuint directionalLightUniformBuffer{ 0 };
 
 };
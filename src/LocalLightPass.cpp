@@ -0,0 +1,250 @@
+#include "LocalLightPass.h"
+
+#include <cmath>
+#include <random>
+
+#include <imgui.h>
+
+#include "GLState.h"
+#include "Logging.h"
+#include "ShaderSystem.h"
+#include "FullscreenQuad.h"
+
+using namespace glm;
+#include "shader_locations.h"
+#include "shader_constants.h"
+#include "shader_types.h"
+
+// The storage block header (the light count) is padded to the alignment of the light structs
+#define LIGHT_BUFFER_HEADER_SIZE 16
+
+static const int benchmarkLightCounts[] = { 1, 10, 100, 1000, 10000 };
+static const int benchmarkStepCount = sizeof(benchmarkLightCounts) / sizeof(benchmarkLightCounts[0]);
+
+template<typename LightType>
+static void
+UploadLightBuffer(const std::vector<LightType>& lights, GLuint& buffer, size_t& capacity, GLuint binding)
+{
+	if (!buffer || lights.size() > capacity)
+	{
+		capacity = glm::max(capacity * 2, glm::max(lights.size(), size_t(64)));
+
+		glDeleteBuffers(1, &buffer);
+		glCreateBuffers(1, &buffer);
+		glNamedBufferStorage(buffer, LIGHT_BUFFER_HEADER_SIZE + capacity * sizeof(LightType), nullptr, GL_DYNAMIC_STORAGE_BIT);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, buffer);
+	}
+
+	GLuint count = GLuint(lights.size());
+	glNamedBufferSubData(buffer, 0, sizeof(GLuint), &count);
+	if (count > 0)
+	{
+		glNamedBufferSubData(buffer, LIGHT_BUFFER_HEADER_SIZE, count * sizeof(LightType), lights.data());
+	}
+}
+
+void
+LocalLightPass::Draw(const LightBuffer& lightBuffer, const GBuffer& gBuffer, Scene& scene)
+{
+	if (!lightCullingProgram)
+	{
+		ShaderSystem::AddComputeProgram(&lightCullingProgram, "light/light_culling.comp.glsl");
+		ShaderSystem::AddProgram(&clusteredShadingProgram, "quad.vert.glsl", "light/clustered.frag.glsl", this);
+
+		size_t clusterBufferSize = sizeof(GLuint) * LIGHT_CLUSTER_COUNT * (1 + LIGHT_CLUSTER_MAX_LIGHTS);
+		glCreateBuffers(1, &clusterBuffer);
+		glNamedBufferStorage(clusterBuffer, clusterBufferSize, nullptr, 0);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PredefinedShaderStorageBinding(LightClusterBlock), clusterBuffer);
+	}
+
+	std::vector<PointLight>& pointLights = benchmark.IsRunning() ? benchmarkPointLights : scene.pointLights;
+	std::vector<SpotLight>& spotLights = benchmark.IsRunning() ? benchmarkSpotLights : scene.spotLights;
+
+	const mat4& viewFromWorld = scene.mainCamera->GetViewMatrix();
+	for (PointLight& light : pointLights)
+	{
+		light.viewPosition = viewFromWorld * vec4(vec3(light.worldPosition), 1.0f);
+	}
+	for (SpotLight& light : spotLights)
+	{
+		light.viewPosition = viewFromWorld * vec4(vec3(light.worldPosition), 1.0f);
+		light.viewDirection = viewFromWorld * light.worldDirection;
+	}
+
+	UploadLights(pointLights, spotLights);
+
+	if (timer.Begin())
+	{
+		cullingMs = timer.LatestMs(0);
+		shadingMs = timer.LatestMs(1);
+
+		if (benchmark.IsRunning())
+		{
+			UpdateBenchmark(cullingMs, shadingMs);
+		}
+	}
+
+	//
+	// Bin the lights into the clusters
+	//
+
+	GLState::UseProgram(*lightCullingProgram);
+	glDispatchCompute(LIGHT_CLUSTER_COUNT_X, LIGHT_CLUSTER_COUNT_Y, LIGHT_CLUSTER_COUNT_Z);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	timer.Split();
+
+	//
+	// Shade all pixels with the lights of their cluster
+	//
+
+	if (!pointLights.empty() || !spotLights.empty())
+	{
+		GLState::BindTextureUnit(0, gBuffer.albedoTexture);
+		GLState::BindTextureUnit(1, gBuffer.materialTexture);
+		GLState::BindTextureUnit(2, gBuffer.normVelTexture);
+		GLState::BindTextureUnit(3, gBuffer.depthTexture);
+
+		GLState::BindFramebuffer(lightBuffer.framebuffer);
+		GLState::Viewport(0, 0, lightBuffer.renderWidth, lightBuffer.renderHeight);
+
+		GLState::UseProgram(*clusteredShadingProgram);
+
+		GLState::Enable(GL_BLEND);
+		GLState::BlendFunc(GL_ONE, GL_ONE);
+		GLState::BlendEquation(GL_FUNC_ADD);
+
+		GLState::Disable(GL_DEPTH_TEST);
+
+		FullscreenQuad::Draw();
+
+		GLState::Enable(GL_DEPTH_TEST);
+		GLState::Disable(GL_BLEND);
+	}
+
+	timer.End();
+
+	if (ImGui::CollapsingHeader("Point & spot lights"))
+	{
+		ImGui::Text("Lights: %d point, %d spot", int(pointLights.size()), int(spotLights.size()));
+		ImGui::Text("Clusters: %dx%dx%d, max %d lights each", LIGHT_CLUSTER_COUNT_X, LIGHT_CLUSTER_COUNT_Y, LIGHT_CLUSTER_COUNT_Z, LIGHT_CLUSTER_MAX_LIGHTS);
+		ImGui::Text("Culling: %.3f ms, shading: %.3f ms", cullingMs, shadingMs);
+
+		if (benchmark.IsRunning())
+		{
+			ImGui::Text("Benchmarking %d lights ...", benchmarkLightCounts[benchmark.Step()]);
+		}
+		else if (ImGui::Button("Benchmark 1 to 10 000 lights"))
+		{
+			StartBenchmark();
+		}
+
+		for (const BenchmarkResult& result : benchmarkResults)
+		{
+			ImGui::Text("%5d lights: culling %.3f ms, shading %.3f ms", result.lightCount, result.cullingMs, result.shadingMs);
+		}
+	}
+
+	if (benchmark.IsStartOfStep())
+	{
+		// (generated here, so that the lights can be placed in front of the camera)
+		GenerateBenchmarkLights(scene, benchmarkLightCounts[benchmark.Step()]);
+	}
+}
+
+void
+LocalLightPass::ProgramLoaded(GLuint program)
+{
+	glProgramUniform1i(program, PredefinedUniformLocation(u_g_buffer_albedo), 0);
+	glProgramUniform1i(program, PredefinedUniformLocation(u_g_buffer_material), 1);
+	glProgramUniform1i(program, PredefinedUniformLocation(u_g_buffer_norm_vel), 2);
+	glProgramUniform1i(program, PredefinedUniformLocation(u_g_buffer_depth), 3);
+}
+
+void
+LocalLightPass::StartBenchmark(int framesPerStep)
+{
+	if (benchmark.IsRunning())
+	{
+		return;
+	}
+
+	benchmark.Start(benchmarkStepCount, framesPerStep);
+	benchmarkResults.clear();
+}
+
+void
+LocalLightPass::UploadLights(const std::vector<PointLight>& pointLights, const std::vector<SpotLight>& spotLights)
+{
+	UploadLightBuffer(pointLights, pointLightBuffer, pointLightCapacity, PredefinedShaderStorageBinding(PointLightBlock));
+	UploadLightBuffer(spotLights, spotLightBuffer, spotLightCapacity, PredefinedShaderStorageBinding(SpotLightBlock));
+}
+
+void
+LocalLightPass::GenerateBenchmarkLights(const Scene& scene, int count)
+{
+	benchmarkPointLights.clear();
+	benchmarkSpotLights.clear();
+
+	// (fixed seed, so that all runs measure the same lights)
+	std::mt19937 rng{ 12345 };
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	// Spread the lights out in a box in front of the camera, half of them point lights and half spot lights
+	mat4 worldFromView = glm::inverse(scene.mainCamera->GetViewMatrix());
+	for (int i = 0; i < count; ++i)
+	{
+		vec3 viewPosition = vec3(mix(-40.0f, 40.0f, unit(rng)), mix(-20.0f, 20.0f, unit(rng)), mix(2.0f, 80.0f, unit(rng)));
+		vec4 worldPosition = vec4(vec3(worldFromView * vec4(viewPosition, 1.0f)), mix(2.0f, 8.0f, unit(rng)));
+		Color color = Color(unit(rng), unit(rng), unit(rng), 0.6f);
+
+		if (i % 2 == 0)
+		{
+			PointLight light;
+			light.worldPosition = worldPosition;
+			light.color = color;
+			benchmarkPointLights.push_back(light);
+		}
+		else
+		{
+			vec3 direction = glm::normalize(vec3(unit(rng), unit(rng), unit(rng)) * 2.0f - 1.0f + vec3(0.0f, -1.0f, 0.0f));
+			float outerAngle = glm::radians(mix(15.0f, 45.0f, unit(rng)));
+
+			SpotLight light;
+			light.worldPosition = worldPosition;
+			light.worldDirection = vec4(direction, 0.0f);
+			light.color = color;
+			light.cone = vec4(std::cos(outerAngle), std::cos(0.8f * outerAngle), std::sin(outerAngle), 0.0f);
+			benchmarkSpotLights.push_back(light);
+		}
+	}
+}
+
+void
+LocalLightPass::UpdateBenchmark(double cullingMs, double shadingMs)
+{
+	if (!benchmark.AddFrame(cullingMs, shadingMs))
+	{
+		return;
+	}
+
+	BenchmarkResult result;
+	result.lightCount = benchmarkLightCounts[benchmark.CompletedStep()];
+	result.cullingMs = benchmark.Average(0);
+	result.shadingMs = benchmark.Average(1);
+	benchmarkResults.push_back(result);
+
+	if (benchmark.IsRunning())
+	{
+		return;
+	}
+
+	benchmarkPointLights.clear();
+	benchmarkSpotLights.clear();
+
+	Log("Point & spot light benchmark (average GPU time over %d frames):\n", benchmark.FramesPerStep());
+	for (const BenchmarkResult& result : benchmarkResults)
+	{
+		Log("  %5d lights: culling %.3f ms, shading %.3f ms\n", result.lightCount, result.cullingMs, result.shadingMs);
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "Scene.h"
+#include "GBuffer.h"
+#include "LightBuffer.h"
+#include "GpuTimer.h"
+#include "Benchmark.h"
+#include "ShaderDependant.h"
+
+//
+// Point & spot lights, using clustered shading. The lights are first binned into a view space froxel grid by a compute
+// pass, and then a single full-screen pass shades every pixel with only the lights of its cluster.
+//
+
+class LocalLightPass : ShaderDepandant
+{
+public:
+
+	void Draw(const LightBuffer& lightBuffer, const GBuffer& gBuffer, Scene& scene);
+	void ProgramLoaded(GLuint program) override;
+
+	// Measures culling & shading for 1 to 10 000 generated lights, which replace the scene lights while it's running
+	void StartBenchmark(int framesPerStep = 100);
+
+private:
+
+	void UploadLights(const std::vector<PointLight>& pointLights, const std::vector<SpotLight>& spotLights);
+	void GenerateBenchmarkLights(const Scene& scene, int count);
+	void UpdateBenchmark(double cullingMs, double shadingMs);
+
+	GLuint *lightCullingProgram{};
+	GLuint *clusteredShadingProgram{};
+
+	// Storage buffers, which are recreated when they are too small for the lights
+	GLuint pointLightBuffer{ 0 };
+	GLuint spotLightBuffer{ 0 };
+	size_t pointLightCapacity{ 0 };
+	size_t spotLightCapacity{ 0 };
+	GLuint clusterBuffer{ 0 };
+
+	// Split between the culling & the shading
+	GpuTimer timer{};
+	double cullingMs{ 0.0 };
+	double shadingMs{ 0.0 };
+
+	struct BenchmarkResult
+	{
+		int lightCount;
+		double cullingMs;
+		double shadingMs;
+	};
+
+	Benchmark benchmark{};
+	std::vector<PointLight> benchmarkPointLights{};
+	std::vector<SpotLight> benchmarkSpotLights{};
+	std::vector<BenchmarkResult> benchmarkResults{};
+
+};
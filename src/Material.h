@@ -5,14 +5,27 @@
 #include "ShaderSystem.h"
 #include "TransformSystem.h"
 
+#include <glm/glm.hpp>
+using namespace glm;
+#include "material_data.h"
+
 struct Material: public ShaderDepandant
 {
 	bool opaque = true;
 	bool cullBackfaces = true;
 
+	// Index into the GPU material table, assigned by the MaterialSystem
+	int materialIndex = 0;
+
 	GLuint program = 0;
 	virtual void ProgramLoaded(GLuint program) = 0;
 
+	// Called by the MaterialSystem when (re)building the material table
+	virtual void WriteMaterialData(MaterialData& data) const = 0;
+
+	// Called by the MaterialSystem with the resolution (as log2 of texels across) requested by the texture feedback
+	virtual void RequestTextureResolution(int /*log2Resolution*/) const {}
+
 	// Call before drawing with material
 	virtual void BindUniforms(Transform& transform, const Transform& prevTransform) const = 0;
 };
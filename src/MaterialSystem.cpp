@@ -1,7 +1,13 @@
 #include "MaterialSystem.h"
 
+#include <cstring>
+#include <algorithm>
+
+#include "Logging.h"
 #include "TextureSystem.h"
 
+#include "shader_locations.h"
+
 // Materials
 #include "BasicMaterial.h"
 #include "CompleteMaterial.h"
@@ -12,10 +18,164 @@
 
 static std::vector<Material *> managedMaterials{};
 
+// The material table, indexed by Material::materialIndex. The GPU copy is only updated when something has changed.
+static std::vector<MaterialData> materialTable{};
+static std::vector<MaterialData> gpuMaterialTable{};
+
+static GLuint materialTableBuffer = 0;
+static size_t materialTableCapacity = 0;
+
+// Texture feedback: the shaders write the requested texture resolution per material, which is copied to a ring of
+// readback buffers so that we never have to wait for the GPU when reading it back.
+#define FEEDBACK_READBACK_LATENCY 3
+
+struct FeedbackReadback
+{
+	GLuint buffer = 0;
+	const uint32_t *mapped = nullptr;
+	GLsync fence = nullptr;
+	size_t count = 0;
+};
+
+static GLuint feedbackBuffer = 0;
+static FeedbackReadback feedbackReadbacks[FEEDBACK_READBACK_LATENCY]{};
+static int nextFeedbackReadback = 0;
+
+//
+// Internal
+//
+
+void
+DeleteFeedbackBuffers()
+{
+	glDeleteBuffers(1, &feedbackBuffer);
+	feedbackBuffer = 0;
+
+	for (FeedbackReadback& readback : feedbackReadbacks)
+	{
+		if (readback.fence)
+		{
+			glDeleteSync(readback.fence);
+		}
+
+		// (deleting a buffer also unmaps it)
+		glDeleteBuffers(1, &readback.buffer);
+		readback = FeedbackReadback{};
+	}
+}
+
+void
+CreateFeedbackBuffers(size_t capacity)
+{
+	DeleteFeedbackBuffers();
+
+	GLsizeiptr size = capacity * sizeof(uint32_t);
+
+	glCreateBuffers(1, &feedbackBuffer);
+	glNamedBufferStorage(feedbackBuffer, size, nullptr, 0);
+	glClearNamedBufferData(feedbackBuffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PredefinedShaderStorageBinding(TextureFeedbackBlock), feedbackBuffer);
+
+	GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	for (FeedbackReadback& readback : feedbackReadbacks)
+	{
+		glCreateBuffers(1, &readback.buffer);
+		glNamedBufferStorage(readback.buffer, size, nullptr, flags);
+		readback.mapped = static_cast<const uint32_t *>(glMapNamedBufferRange(readback.buffer, 0, size, flags));
+	}
+}
+
+void
+ProcessTextureFeedback()
+{
+	// Consume the oldest readback, if the GPU is done with it
+	FeedbackReadback& oldest = feedbackReadbacks[nextFeedbackReadback];
+	if (oldest.fence)
+	{
+		GLenum status = glClientWaitSync(oldest.fence, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+		{
+			// Not yet done, so we will have to try again next frame
+			return;
+		}
+
+		glDeleteSync(oldest.fence);
+		oldest.fence = nullptr;
+
+		size_t count = std::min(oldest.count, managedMaterials.size());
+		for (size_t i = 0; i < count; ++i)
+		{
+			// Zero means that the material wasn't seen in that frame
+			if (oldest.mapped[i] > 0)
+			{
+				managedMaterials[i]->RequestTextureResolution(int(oldest.mapped[i]));
+			}
+		}
+	}
+
+	// Copy this frame's feedback (i.e., the last frame's rendering) and reset it for the next
+	glCopyNamedBufferSubData(feedbackBuffer, oldest.buffer, 0, 0, managedMaterials.size() * sizeof(uint32_t));
+	glClearNamedBufferData(feedbackBuffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+	oldest.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	oldest.count = managedMaterials.size();
+
+	nextFeedbackReadback = (nextFeedbackReadback + 1) % FEEDBACK_READBACK_LATENCY;
+}
+
 //
 // Public API
 //
 
+void
+MaterialSystem::Init()
+{
+	if (!GLAD_GL_ARB_bindless_texture)
+	{
+		LogError("Fatal error: the material system requires GL_ARB_bindless_texture\n");
+	}
+}
+
+void
+MaterialSystem::Update()
+{
+	materialTable.resize(managedMaterials.size());
+	for (size_t i = 0; i < managedMaterials.size(); ++i)
+	{
+		managedMaterials[i]->WriteMaterialData(materialTable[i]);
+	}
+
+	if (materialTable.empty())
+	{
+		return;
+	}
+
+	if (materialTable.size() > materialTableCapacity)
+	{
+		// Buffer storage is immutable, so grow by recreating the buffer
+		materialTableCapacity = std::max(size_t(64), 2 * materialTable.size());
+
+		glDeleteBuffers(1, &materialTableBuffer);
+		glCreateBuffers(1, &materialTableBuffer);
+		glNamedBufferStorage(materialTableBuffer, materialTableCapacity * sizeof(MaterialData), nullptr, GL_DYNAMIC_STORAGE_BIT);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PredefinedShaderStorageBinding(MaterialTableBlock), materialTableBuffer);
+
+		gpuMaterialTable.clear();
+
+		CreateFeedbackBuffers(materialTableCapacity);
+	}
+	else
+	{
+		ProcessTextureFeedback();
+	}
+
+	size_t tableSize = materialTable.size() * sizeof(MaterialData);
+	if (gpuMaterialTable.size() != materialTable.size() || memcmp(gpuMaterialTable.data(), materialTable.data(), tableSize) != 0)
+	{
+		gpuMaterialTable = materialTable;
+		glNamedBufferSubData(materialTableBuffer, 0, tableSize, gpuMaterialTable.data());
+	}
+}
+
 Material *
 MaterialSystem::CreateMaterial(const tinyobj::material_t& materialDescription, const std::string& baseDirectory)
 {
@@ -37,15 +197,12 @@ MaterialSystem::CreateMaterial(const tinyobj::material_t& materialDescription, c
 		mat->normalMap = TextureSystem::LoadDataTexture(baseDirectory + materialDescription.normal_texname);
 		mat->roughnessMap = TextureSystem::LoadDataTexture(baseDirectory + materialDescription.roughness_texname);
 
+		// Assume not metal if no map is specified. That doesn't need a placeholder texture, since without a texture the
+		// constant metallic value (of 0) from the material table is used.
 		if (hasMetallicMap)
 		{
 			mat->metallicMap = TextureSystem::LoadDataTexture(baseDirectory + materialDescription.metallic_texname);
 		}
-		else
-		{
-			// Assume not metal if no map is specified
-			mat->metallicMap = TextureSystem::CreatePlaceholder(0, 0, 0, 0);
-		}
 
 		material = mat;
 	}
@@ -64,13 +221,14 @@ MaterialSystem::CreateMaterial(const tinyobj::material_t& materialDescription, c
 		material = mat;
 	}
 
-	managedMaterials.push_back(material);
+	ManageMaterial(material);
 	return material;
 }
 
 void
 MaterialSystem::ManageMaterial(Material* material)
 {
+	material->materialIndex = int(managedMaterials.size());
 	managedMaterials.push_back(material);
 }
 
@@ -81,4 +239,7 @@ MaterialSystem::Destroy()
 	{
 		delete material;
 	}
+
+	glDeleteBuffers(1, &materialTableBuffer);
+	DeleteFeedbackBuffers();
 }
\ No newline at end of file
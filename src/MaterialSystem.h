@@ -8,6 +8,11 @@
 
 namespace MaterialSystem
 {
+	void Init();
+
+	// Must be called on a regular basis (e.g. in the beginning of every frame), updates the GPU material table
+	void Update();
+
 	Material *CreateMaterial(const tinyobj::material_t& materialDescription, const std::string& baseDirectory);
 
 	void ManageMaterial(Material* material);
@@ -5,6 +5,7 @@
 #include <glad/glad.h>
 
 #include "Maths.h"
+#include "GLState.h"
 #include "Material.h"
 
 struct Model
@@ -21,7 +22,7 @@ struct Model
 	{
 		if (vao)
 		{
-			glBindVertexArray(vao);
+			GLState::BindVertexArray(vao);
 			glDrawElements(GL_TRIANGLES, indexCount, indexType, nullptr);
 		}
 	}
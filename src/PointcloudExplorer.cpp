@@ -3,6 +3,7 @@
 #include <ios>
 #include <fstream>
 
+#include "GLState.h"
 #include "FpsCamera.h"
 #include "GuiSystem.h"
 #include "ShaderSystem.h"
@@ -189,7 +190,7 @@ void PointcloudExplorer::Init()
 void PointcloudExplorer::Resize(int width, int height)
 {
 	camera.Resize(width, height);
-	glViewport(0, 0, width, height);
+	GLState::Viewport(0, 0, width, height);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -202,21 +203,21 @@ void PointcloudExplorer::Draw(const Input& input, float deltaTime, float running
 
 	camera.Update(input, deltaTime);
 
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	GLState::BindFramebuffer(0);
 	glClearColor(0, 0, 0, 1.0f);
 	glClear(GL_COLOR_BUFFER_BIT);
 
-	glDisable(GL_DEPTH_TEST);
-	glDepthMask(GL_FALSE);
+	GLState::Disable(GL_DEPTH_TEST);
+	GLState::DepthMask(GL_FALSE);
 
-	//glDisable(GL_BLEND);
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glBlendEquation(GL_FUNC_ADD);
+	//GLState::Disable(GL_BLEND);
+	GLState::Enable(GL_BLEND);
+	GLState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLState::BlendEquation(GL_FUNC_ADD);
 
 	if (pointcloudProgram)
 	{
-		glUseProgram(*pointcloudProgram);
+		GLState::UseProgram(*pointcloudProgram);
 
 		ImGui::SliderFloat("Base scale", &data.base_scale, 0.0001f, 0.1f);
 
@@ -225,7 +226,7 @@ void PointcloudExplorer::Draw(const Input& input, float deltaTime, float running
 		data.projection_from_world = camera.GetProjectionMatrix() * camera.GetViewMatrix();
 		glNamedBufferSubData(dataBuffer, 0, sizeof(data), &data);
 
-		glBindVertexArray(vertexArray);
+		GLState::BindVertexArray(vertexArray);
 		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 14, pointcloud.pointCount);
 	}
 
@@ -1,6 +1,7 @@
 #include "RenderPipeline.h"
 
 #include <glm/glm.hpp>
+#include <imgui.h>
 
 #include "TextureSystem.h"
 #include "PerformOnce.h"
@@ -23,18 +24,57 @@ void RenderPipeline::Resize(int width, int height)
 void RenderPipeline::Render(Scene& scene, const Input& input, float deltaTime, float runningTime)
 {
 	PerformOnce(
-		shadowMapAtlas.RecreateGpuResources(8192);
 		sceneBuffer.BindBufferBase(BufferObjectType::Uniform, PredefinedUniformBlockBinding(SceneUniformBlock));
 		
 		blueNoiseTexture = TextureSystem::LoadBlueNoiseTextureArray("assets/blue_noise/64/");
 		glBindImageTexture(PredefinedImageBinding(BlueNoiseImage), blueNoiseTexture, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R8);
 	);
 
+	if (frameTimer.Begin())
+	{
+		gpuFrameMs = frameTimer.LatestMs();
+
+		// (the upsampling is done by the TAA, so without it there is no dynamic resolution)
+		if (settings.dynamicResolution && settings.useTaa && !resizeThisFrame)
+		{
+			UpdateRenderScale(gpuFrameMs);
+		}
+		else
+		{
+			renderScale = 1.0f;
+		}
+	}
+
+	int renderWidth = std::max(int(float(width) * renderScale + 0.5f), 1);
+	int renderHeight = std::max(int(float(height) * renderScale + 0.5f), 1);
+
+	gBuffer.renderWidth = renderWidth;
+	gBuffer.renderHeight = renderHeight;
+	lightBuffer.renderWidth = renderWidth;
+	lightBuffer.renderHeight = renderHeight;
+
+	if (ImGui::CollapsingHeader("Dynamic resolution"))
+	{
+		ImGui::Checkbox("Scale to target GPU time", &settings.dynamicResolution);
+		ImGui::SliderFloat("Target GPU time (ms)", &settings.targetGpuFrameMs, 4.0f, 50.0f, "%.1f");
+		ImGui::SliderFloat("Minimum scale", &settings.minRenderScale, 0.25f, 1.0f, "%.2f");
+
+		ImGui::Text("GPU frame time: %.2f ms", gpuFrameMs);
+		ImGui::Text("Render scale: %.2f (%dx%d of %dx%d)", renderScale, renderWidth, renderHeight, width, height);
+		if (!settings.useTaa)
+		{
+			ImGui::Text("(requires TAA, which does the upsampling)");
+		}
+	}
+
 	if (settings.useTaa)
 	{
 		// Generate jitter samples in pixel space, centered around 0, with offsets -0.5 to +0.5
 		glm::vec2 haltonSample = Halton(frameCount, 2, 3);
 		glm::vec2 offsetPixels = haltonSample - 0.5f;
+
+		// (the jitter is in render pixels, which are larger than output pixels with dynamic resolution)
+		offsetPixels *= glm::vec2(width, height) / glm::vec2(renderWidth, renderHeight);
 		scene.mainCamera->ApplyFrustumJitter(offsetPixels);
 	}
 	else
@@ -46,6 +86,11 @@ void RenderPipeline::Render(Scene& scene, const Input& input, float deltaTime, f
 	sceneBuffer.memory.running_time = runningTime;
 	sceneBuffer.memory.frame_count = frameCount;
 	sceneBuffer.memory.frame_count_noise = settings.useTaa ? frameCount % 64 : 0;
+	// (the buffer memory still holds the previous frame's size, which is zero for the first frame)
+	ivec2 prevRenderSize = sceneBuffer.memory.render_size;
+	sceneBuffer.memory.prev_render_size = (prevRenderSize.x > 0) ? prevRenderSize : ivec2(renderWidth, renderHeight);
+	sceneBuffer.memory.render_size = ivec2(renderWidth, renderHeight);
+	sceneBuffer.memory.render_scale = vec2(renderWidth, renderHeight) / vec2(width, height);
 	sceneBuffer.UpdateGpuBuffer();
 
 	scene.mainCamera->CommitToGpu();
@@ -57,11 +102,29 @@ void RenderPipeline::Render(Scene& scene, const Input& input, float deltaTime, f
 
 	iblPass.Draw(lightBuffer, gBuffer, ssaoPass, scene);
 	lightPass.Draw(lightBuffer, gBuffer, shadowMapAtlas, scene);
+	localLightPass.Draw(lightBuffer, gBuffer, scene);
 	skyPass.Draw(lightBuffer, gBuffer, scene);
 
 	gBuffer.RenderGui("before final");
 	finalPass.Draw(gBuffer, lightBuffer, scene, &settings.useTaa);
 
+	frameTimer.End();
+
 	frameCount += 1;
 	resizeThisFrame = false;
 }
+
+void RenderPipeline::UpdateRenderScale(double gpuFrameMs)
+{
+	// The GPU time is roughly proportional to the number of pixels, i.e. to the square of the scale. Aim slightly below
+	// the target so that small spikes don't immediately push it over, and ignore small differences so the resolution
+	// doesn't change constantly. Since the timings are from two frames ago, only move part of the way every frame.
+	const double headroom = 0.95;
+	double idealScale = renderScale * std::sqrt(headroom * settings.targetGpuFrameMs / std::max(gpuFrameMs, 0.001));
+	idealScale = glm::clamp(idealScale, double(settings.minRenderScale), 1.0);
+
+	if (std::abs(idealScale - renderScale) > 0.02)
+	{
+		renderScale = float(glm::mix(double(renderScale), idealScale, 0.1));
+	}
+}
@@ -9,8 +9,10 @@
 #include "FinalPass.h"
 #include "ShadowMap.h"
 #include "LightPass.h"
+#include "LocalLightPass.h"
 #include "ShadowPass.h"
 #include "BufferObject.h"
+#include "GpuTimer.h"
 
 class Input;
 struct Scene;
@@ -26,6 +28,13 @@ public:
 	struct
 	{
 		bool useTaa = true;
+
+		// Scale the render resolution (within the full size targets) to keep the GPU frame time at the target. Only
+		// used with TAA, which upsamples back to the output resolution.
+		bool dynamicResolution = false;
+		float targetGpuFrameMs = 16.0f;
+		float minRenderScale = 0.5f;
+
 		// TODO: Add more settings here!
 
 	} settings;
@@ -49,6 +58,7 @@ private:
 	GeometryPass geometryPass{};
 	ShadowPass shadowPass{};
 	LightPass lightPass{};
+	LocalLightPass localLightPass{};
 
 	IBLPass iblPass{};
 	SkyPass skyPass{};
@@ -56,7 +66,14 @@ private:
 	SSAOPass ssaoPass{};
 	FinalPass finalPass{};
 
+	void UpdateRenderScale(double gpuFrameMs);
+
 	bool resizeThisFrame = false;
 	unsigned int frameCount = 0;
 
+	float renderScale = 1.0f;
+
+	GpuTimer frameTimer{};
+	double gpuFrameMs{ 0.0 };
+
 };
@@ -8,6 +8,7 @@ using namespace glm;
 
 #include <imgui.h>
 
+#include "GLState.h"
 #include "GuiSystem.h"
 #include "ShaderSystem.h"
 #include "TextureSystem.h"
@@ -22,12 +23,7 @@ SSAOPass::Draw(const GBuffer& gBuffer)
 	static int lastH = 0;
 	if (lastW != gBuffer.width || lastH != gBuffer.height)
 	{
-		glDeleteTextures(1, &occlusionTexture);
-		occlusionTexture = TextureSystem::CreateTexture(gBuffer.width, gBuffer.height, GL_R16F, GL_NEAREST, GL_NEAREST);
-
-		// Setup the swizzle for the occlusion texture so it's gray scale
-		GLenum swizzle[] = { GL_RED, GL_RED, GL_RED, GL_ALPHA };
-		glTextureParameteriv(occlusionTexture, GL_TEXTURE_SWIZZLE_RGBA, (GLint *)swizzle);
+		CreateTextures(gBuffer.width, gBuffer.height);
 
 		lastW = gBuffer.width;
 		lastH = gBuffer.height;
@@ -36,12 +32,20 @@ SSAOPass::Draw(const GBuffer& gBuffer)
 	if (!ssaoProgram)
 	{
 		ShaderSystem::AddComputeProgram(&ssaoProgram, "post/ssao.comp.glsl", this);
-		ShaderSystem::AddComputeProgram(&ssaoBlurProgram, "post/ssao_blur.comp.glsl");
+		ShaderSystem::AddComputeProgram(&downsampleProgram, "post/ssao_downsample.comp.glsl", this);
+		ShaderSystem::AddComputeProgram(&temporalProgram, "post/ssao_temporal.comp.glsl", this);
+		ShaderSystem::AddComputeProgram(&bilateralBlurProgram, "post/ssao_bilateral_blur.comp.glsl", this);
+		ShaderSystem::AddComputeProgram(&upsampleProgram, "post/ssao_upsample.comp.glsl", this);
+		ShaderSystem::AddComputeProgram(&compareProgram, "post/ssao_compare.comp.glsl");
 
 		glCreateBuffers(1, &ssaoDataBuffer);
 		glNamedBufferStorage(ssaoDataBuffer, sizeof(SSAOData), nullptr, GL_DYNAMIC_STORAGE_BIT);
 		glBindBufferBase(GL_UNIFORM_BUFFER, PredefinedUniformBlockBinding(SSAODataBlock), ssaoDataBuffer);
 
+		GLuint zeros[2] = { 0, 0 };
+		glCreateBuffers(1, &comparisonBuffer);
+		glNamedBufferStorage(comparisonBuffer, sizeof(zeros), zeros, GL_DYNAMIC_STORAGE_BIT);
+
 		GenerateAndUpdateKernel();
 	}
 
@@ -55,12 +59,47 @@ SSAOPass::Draw(const GBuffer& gBuffer)
 		ImGui::SliderFloat("Kernel radius", &kernelRadius, 0.01f, 3.0f);
 		ImGui::SliderFloat("Intensity", &intensity, 0.0f, 20.0f);
 
-		ImGui::Checkbox("Apply blur", &applyBlur);
+		ImGui::Checkbox("Performance mode (half resolution)", &performanceMode);
+		if (performanceMode)
+		{
+			const char *sampleCounts[] = { "1", "2", "4", "8", "16" };
+			int sampleCountIndex = int(log2(float(performanceSamplesPerFrame)));
+			ImGui::Combo("Samples per frame", &sampleCountIndex, sampleCounts, IM_ARRAYSIZE(sampleCounts));
+			performanceSamplesPerFrame = 1 << sampleCountIndex;
+
+			ImGui::SliderFloat("History blend", &historyBlend, 0.01f, 1.0f);
+			ImGui::Checkbox("Compare against full resolution", &compareQuality);
+		}
+		else
+		{
+			ImGui::Checkbox("Apply blur", &applyBlur);
+
+			const char *blurQualities[] = { "Fast (3x3)", "Wide (5x5)" };
+			ImGui::Combo("Blur quality", &blurQuality, blurQualities, IM_ARRAYSIZE(blurQualities));
+		}
+
+		ImGui::Text("GPU time: full resolution %.3f ms, performance mode %.3f ms", fullResolutionMs, performanceModeMs);
+		if (performanceMode && compareQuality)
+		{
+			ImGui::Text("Mean difference: %.4f, pixels off by more than 0.1: %.2f%%", meanDifference, largeDifferencePercentage);
+		}
 
 		ImGui::Text("Occlusion:");
 		GuiSystem::Texture(occlusionTexture);
 	}
 
+	// Add all blur permutations, where the ones that aren't selected are compiled in the background. (this is done after
+	// the GUI, so that a newly selected permutation is waited for before it's used below)
+	for (int quality = 0; quality < 2; ++quality)
+	{
+		bool selected = quality == blurQuality;
+		if (!ssaoBlurPrograms[quality] || (selected && !*ssaoBlurPrograms[quality]))
+		{
+			std::string defines = "SSAO_BLUR_QUALITY=" + std::to_string(quality);
+			ShaderSystem::AddComputeProgramPermutation(&ssaoBlurPrograms[quality], "post/ssao_blur.comp.glsl", defines, nullptr, selected);
+		}
+	}
+
 	if (kernelRadius != ssaoData.kernel_radius)
 	{
 		glNamedBufferSubData(ssaoDataBuffer, offsetof(SSAOData, kernel_radius), sizeof(SSAOData::kernel_radius), &kernelRadius);
@@ -70,17 +109,122 @@ SSAOPass::Draw(const GBuffer& gBuffer)
 		glNamedBufferSubData(ssaoDataBuffer, offsetof(SSAOData, intensity), sizeof(SSAOData::intensity), &intensity);
 	}
 
-	int xGroups = int(ceil(gBuffer.width / 32.0f));
-	int yGroups = int(ceil(gBuffer.height / 32.0f));
+	if (timer.Begin(performanceMode))
+	{
+		(timer.LatestVariant() ? performanceModeMs : fullResolutionMs) = timer.LatestMs();
+	}
+
+	if (performanceMode)
+	{
+		DrawHalfResolution(gBuffer);
+	}
+	else
+	{
+		DrawFullResolution(gBuffer, occlusionTexture);
+		historyValid = false;
+	}
+
+	timer.End();
+
+	// (outside of the timed range)
+	if (performanceMode && compareQuality)
+	{
+		DrawFullResolution(gBuffer, referenceTexture);
+		CompareAgainstReference(gBuffer.renderWidth, gBuffer.renderHeight);
+	}
+}
+
+void
+SSAOPass::ProgramLoaded(GLuint program)
+{
+	if (ssaoProgram && program == *ssaoProgram)
+	{
+		glProgramUniform1i(*ssaoProgram, PredefinedUniformLocation(u_g_buffer_norm_vel), 0);
+		glProgramUniform1i(*ssaoProgram, PredefinedUniformLocation(u_g_buffer_depth), 1);
+		sampleCountLoc = ShaderSystem::GetUniformLocation(*ssaoProgram, "u_sample_count");
+		renderSizeLoc = ShaderSystem::GetUniformLocation(*ssaoProgram, "u_render_size");
+	}
+
+	if (downsampleProgram && program == *downsampleProgram)
+	{
+		glProgramUniform1i(*downsampleProgram, PredefinedUniformLocation(u_g_buffer_norm_vel), 0);
+		glProgramUniform1i(*downsampleProgram, PredefinedUniformLocation(u_g_buffer_depth), 1);
+	}
+
+	if (temporalProgram && program == *temporalProgram)
+	{
+		glProgramUniform1i(*temporalProgram, PredefinedUniformLocation(u_g_buffer_norm_vel), 0);
+		glProgramUniform1i(*temporalProgram, ShaderSystem::GetUniformLocation(*temporalProgram, "u_history_texture"), 1);
+		historyBlendLoc = ShaderSystem::GetUniformLocation(*temporalProgram, "u_history_blend");
+		firstFrameLoc = ShaderSystem::GetUniformLocation(*temporalProgram, "u_first_frame");
+	}
+
+	if (bilateralBlurProgram && program == *bilateralBlurProgram)
+	{
+		directionLoc = ShaderSystem::GetUniformLocation(*bilateralBlurProgram, "u_direction");
+	}
+
+	if (upsampleProgram && program == *upsampleProgram)
+	{
+		glProgramUniform1i(*upsampleProgram, PredefinedUniformLocation(u_g_buffer_depth), 1);
+	}
+}
+
+void
+SSAOPass::CreateTextures(int width, int height)
+{
+	GLuint textures[] = {
+		occlusionTexture, rawOcclusionTexture, referenceTexture,
+		halfDepthTexture, halfNormalTexture, halfOcclusionTexture,
+		historyTextures[0], historyTextures[1], blurTextures[0], blurTextures[1]
+	};
+	GLState::DeleteTextures(sizeof(textures) / sizeof(textures[0]), textures);
+
+	occlusionTexture = TextureSystem::CreateTexture(width, height, GL_R16F, GL_NEAREST, GL_NEAREST);
+	rawOcclusionTexture = TextureSystem::CreateTexture(width, height, GL_R16F, GL_NEAREST, GL_NEAREST, false);
+	referenceTexture = TextureSystem::CreateTexture(width, height, GL_R16F, GL_NEAREST, GL_NEAREST, false);
+
+	// Setup the swizzle for the occlusion texture so it's gray scale
+	GLenum swizzle[] = { GL_RED, GL_RED, GL_RED, GL_ALPHA };
+	glTextureParameteriv(occlusionTexture, GL_TEXTURE_SWIZZLE_RGBA, (GLint *)swizzle);
+
+	int halfWidth = (width + 1) / 2;
+	int halfHeight = (height + 1) / 2;
+
+	halfDepthTexture = TextureSystem::CreateTexture(halfWidth, halfHeight, GL_R32F, GL_NEAREST, GL_NEAREST, false);
+	halfNormalTexture = TextureSystem::CreateTexture(halfWidth, halfHeight, GL_RG16F, GL_NEAREST, GL_NEAREST, false);
+	halfOcclusionTexture = TextureSystem::CreateTexture(halfWidth, halfHeight, GL_R16F, GL_NEAREST, GL_NEAREST, false);
+
+	for (int i = 0; i < 2; ++i)
+	{
+		// (the history is sampled with reprojected uvs, so it's filtered)
+		historyTextures[i] = TextureSystem::CreateTexture(halfWidth, halfHeight, GL_RG16F, GL_LINEAR, GL_LINEAR, false);
+		glTextureParameteri(historyTextures[i], GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(historyTextures[i], GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		blurTextures[i] = TextureSystem::CreateTexture(halfWidth, halfHeight, GL_RG16F, GL_NEAREST, GL_NEAREST, false);
+	}
+
+	historyValid = false;
+}
+
+void
+SSAOPass::DrawFullResolution(const GBuffer& gBuffer, GLuint targetTexture)
+{
+	int xGroups = int(ceil(gBuffer.renderWidth / 32.0f));
+	int yGroups = int(ceil(gBuffer.renderHeight / 32.0f));
 
 	// Generate SSAO
 
-	glUseProgram(*ssaoProgram);
+	GLState::UseProgram(*ssaoProgram);
+	glProgramUniform1i(*ssaoProgram, sampleCountLoc, SSAO_KERNEL_SAMPLE_COUNT);
+	glProgramUniform2i(*ssaoProgram, renderSizeLoc, gBuffer.renderWidth, gBuffer.renderHeight);
 
-	glBindTextureUnit(0, gBuffer.normVelTexture);
-	glBindTextureUnit(1, gBuffer.depthTexture);
+	GLState::BindTextureUnit(0, gBuffer.normVelTexture);
+	GLState::BindTextureUnit(1, gBuffer.depthTexture);
 
-	glBindImageTexture(0, occlusionTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R16F);
+	GLuint ssaoTarget = applyBlur ? rawOcclusionTexture : targetTexture;
+	glBindImageTexture(0, ssaoTarget, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R16F);
 
 	glDispatchCompute(xGroups, yGroups, 1);
 	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
@@ -89,21 +233,121 @@ SSAOPass::Draw(const GBuffer& gBuffer)
 
 	if (applyBlur)
 	{
-		glUseProgram(*ssaoBlurProgram);
-		glBindImageTexture(0, occlusionTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R16F);
+		GLState::UseProgram(*ssaoBlurPrograms[blurQuality]);
+		glBindImageTexture(0, targetTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R16F);
+		glBindImageTexture(1, rawOcclusionTexture, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R16F);
 		glDispatchCompute(xGroups, yGroups, 1);
 		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
 	}
 }
 
 void
-SSAOPass::ProgramLoaded(GLuint program)
+SSAOPass::DrawHalfResolution(const GBuffer& gBuffer)
 {
-	if (ssaoProgram && program == *ssaoProgram)
-	{
-		glProgramUniform1i(*ssaoProgram, PredefinedUniformLocation(u_g_buffer_norm_vel), 0);
-		glProgramUniform1i(*ssaoProgram, PredefinedUniformLocation(u_g_buffer_depth), 1);
-	}
+	int halfWidth = (gBuffer.renderWidth + 1) / 2;
+	int halfHeight = (gBuffer.renderHeight + 1) / 2;
+
+	int xGroups = int(ceil(halfWidth / 8.0f));
+	int yGroups = int(ceil(halfHeight / 8.0f));
+
+	// Downsample depth & normals
+
+	GLState::UseProgram(*downsampleProgram);
+
+	GLState::BindTextureUnit(0, gBuffer.normVelTexture);
+	GLState::BindTextureUnit(1, gBuffer.depthTexture);
+
+	glBindImageTexture(0, halfDepthTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+	glBindImageTexture(1, halfNormalTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG16F);
+
+	glDispatchCompute(xGroups, yGroups, 1);
+	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+
+	// Generate SSAO, from the half resolution depth & normals and with a subset of the kernel
+
+	GLState::UseProgram(*ssaoProgram);
+	glProgramUniform1i(*ssaoProgram, sampleCountLoc, performanceSamplesPerFrame);
+	glProgramUniform2i(*ssaoProgram, renderSizeLoc, halfWidth, halfHeight);
+
+	GLState::BindTextureUnit(0, halfNormalTexture);
+	GLState::BindTextureUnit(1, halfDepthTexture);
+
+	glBindImageTexture(0, halfOcclusionTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R16F);
+
+	glDispatchCompute(int(ceil(halfWidth / 32.0f)), int(ceil(halfHeight / 32.0f)), 1);
+	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+	// Accumulate with the reprojected history
+
+	int previousHistoryIndex = historyIndex;
+	historyIndex = (historyIndex + 1) % 2;
+
+	GLState::UseProgram(*temporalProgram);
+	glProgramUniform1f(*temporalProgram, historyBlendLoc, historyBlend);
+	glProgramUniform1i(*temporalProgram, firstFrameLoc, historyValid ? GL_FALSE : GL_TRUE);
+
+	GLState::BindTextureUnit(0, gBuffer.normVelTexture);
+	GLState::BindTextureUnit(1, historyTextures[previousHistoryIndex]);
+
+	glBindImageTexture(0, historyTextures[historyIndex], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG16F);
+	glBindImageTexture(1, halfOcclusionTexture, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R16F);
+	glBindImageTexture(2, halfDepthTexture, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+
+	glDispatchCompute(xGroups, yGroups, 1);
+	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+	historyValid = true;
+
+	// Separable bilateral blur (the history itself is kept unblurred)
+
+	GLState::UseProgram(*bilateralBlurProgram);
+
+	glProgramUniform2i(*bilateralBlurProgram, directionLoc, 1, 0);
+	glBindImageTexture(0, blurTextures[0], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG16F);
+	glBindImageTexture(1, historyTextures[historyIndex], 0, GL_FALSE, 0, GL_READ_ONLY, GL_RG16F);
+	glDispatchCompute(int(ceil(halfWidth / 64.0f)), halfHeight, 1);
+	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+	glProgramUniform2i(*bilateralBlurProgram, directionLoc, 0, 1);
+	glBindImageTexture(0, blurTextures[1], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG16F);
+	glBindImageTexture(1, blurTextures[0], 0, GL_FALSE, 0, GL_READ_ONLY, GL_RG16F);
+	glDispatchCompute(int(ceil(halfHeight / 64.0f)), halfWidth, 1);
+	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+	// Upsample to full resolution
+
+	GLState::UseProgram(*upsampleProgram);
+
+	GLState::BindTextureUnit(1, gBuffer.depthTexture);
+
+	glBindImageTexture(0, occlusionTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R16F);
+	glBindImageTexture(1, blurTextures[1], 0, GL_FALSE, 0, GL_READ_ONLY, GL_RG16F);
+
+	glDispatchCompute(int(ceil(gBuffer.renderWidth / 8.0f)), int(ceil(gBuffer.renderHeight / 8.0f)), 1);
+	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+void
+SSAOPass::CompareAgainstReference(int width, int height)
+{
+	GLuint zeros[2] = { 0, 0 };
+	glNamedBufferSubData(comparisonBuffer, 0, sizeof(zeros), zeros);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PredefinedShaderStorageBinding(SSAOComparisonBlock), comparisonBuffer);
+
+	GLState::UseProgram(*compareProgram);
+
+	glBindImageTexture(0, occlusionTexture, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R16F);
+	glBindImageTexture(1, referenceTexture, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R16F);
+
+	glDispatchCompute(int(ceil(width / 16.0f)), int(ceil(height / 16.0f)), 1);
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+	// (this stalls until the comparison is done, but it's only a debug feature)
+	GLuint results[2];
+	glGetNamedBufferSubData(comparisonBuffer, 0, sizeof(results), results);
+
+	float pixelCount = float(width) * float(height);
+	meanDifference = float(results[0]) / 255.0f / pixelCount;
+	largeDifferencePercentage = 100.0f * float(results[1]) / pixelCount;
 }
 
 void
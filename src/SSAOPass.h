@@ -4,6 +4,7 @@
 
 #include "GBuffer.h"
 #include "ShaderDependant.h"
+#include "GpuTimer.h"
 
 #include <glm/glm.hpp>
 using namespace glm;
@@ -22,17 +23,75 @@ public:
 	float intensity = 7.0f;
 	bool applyBlur = true;
 
+	// 0 - fast 3x3 blur, 1 - wider 5x5 blur (SSAO_BLUR_QUALITY in the shader)
+	int blurQuality = 1;
+
 	// (recompile to change this.. easier this way)
 	bool randomKernelSamples = true;
 
+	// Half resolution occlusion with fewer samples per frame, accumulated over time and then blurred & upsampled with
+	// depth aware filters. The regular blur settings only apply to the full resolution path.
+	bool performanceMode = false;
+	int performanceSamplesPerFrame = 4;
+	float historyBlend = 0.15f;
+
+	// Also renders the full resolution path every frame in performance mode, and compares the two
+	bool compareQuality = false;
+
 private:
 
+	void CreateTextures(int width, int height);
+
+	void DrawFullResolution(const GBuffer& gBuffer, GLuint targetTexture);
+	void DrawHalfResolution(const GBuffer& gBuffer);
+	void CompareAgainstReference(int width, int height);
+
 	void GenerateAndUpdateKernel() const;
 
 	GLuint *ssaoProgram{ 0 };
-	GLuint *ssaoBlurProgram{ 0 };
+	GLint sampleCountLoc;
+	GLint renderSizeLoc;
+
+	GLuint *ssaoBlurPrograms[2]{};
+
+	GLuint *downsampleProgram{ nullptr };
+
+	GLuint *temporalProgram{ nullptr };
+	GLint historyBlendLoc;
+	GLint firstFrameLoc;
+
+	GLuint *bilateralBlurProgram{ nullptr };
+	GLint directionLoc;
+
+	GLuint *upsampleProgram{ nullptr };
+	GLuint *compareProgram{ nullptr };
 
 	GLuint ssaoDataBuffer{ 0 };
 	SSAOData ssaoData{};
 
+	// (before blurring, for the full resolution path)
+	GLuint rawOcclusionTexture{ 0 };
+
+	GLuint halfDepthTexture{ 0 };
+	GLuint halfNormalTexture{ 0 };
+	GLuint halfOcclusionTexture{ 0 };
+
+	// Occlusion & view depth, ping-ponged between frames
+	GLuint historyTextures[2]{};
+	int historyIndex{ 0 };
+	bool historyValid{ false };
+
+	// Horizontally & then vertically blurred occlusion & view depth
+	GLuint blurTextures[2]{};
+
+	GLuint referenceTexture{ 0 };
+	GLuint comparisonBuffer{ 0 };
+	float meanDifference{ 0.0f };
+	float largeDifferencePercentage{ 0.0f };
+
+	// The variant is whether the performance mode was timed
+	GpuTimer timer{};
+	double fullResolutionMs{ 0.0 };
+	double performanceModeMs{ 0.0 };
+
 };
@@ -32,4 +32,6 @@ struct Scene
 	std::vector<Model> models;
 
 	std::vector<DirectionalLight> directionalLights;
+	std::vector<PointLight> pointLights;
+	std::vector<SpotLight> spotLights;
 };
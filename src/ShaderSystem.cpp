@@ -1,15 +1,24 @@
 #include "ShaderSystem.h"
 
-#include <array>
+#include <deque>
+#include <cstring>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
 #include <fstream>
 #include <sstream>
 #include <iomanip>
+#include <algorithm>
+#include <filesystem>
 #include <functional>
 #include <unordered_set>
 #include <unordered_map>
 
-#ifdef _WIN32
- #include <sys/stat.h>
+#ifdef __linux__
+ #include <poll.h>
+ #include <unistd.h>
+ #include <sys/inotify.h>
 #endif
 
 #include "Logging.h"
@@ -31,6 +40,9 @@ struct Program
 	size_t fixedLocation;
 	std::vector<Shader> shaders{};
 
+	// Permutation defines, e.g. "TONEMAP_OPERATOR=2 FAST_PATH" (empty for programs that aren't permutations)
+	std::string defines{};
+
 	bool operator==(const Program& other) const
 	{
 		return fixedLocation == other.fixedLocation;
@@ -46,10 +58,42 @@ struct std::hash<Program>
 	}
 };
 
+// A shader source file, split into chunks of lines where each chunk (except the first) follows an include directive
+struct SourceFile
+{
+	struct Chunk
+	{
+		std::string includeFile;
+		int firstLine;
+		std::string text;
+	};
+
+	std::vector<Chunk> chunks{};
+	bool includeOnce = false;
+};
+
+struct PreprocessedShader
+{
+	std::string source{};
+
+	// The source string numbers used in the #line directives index into this list
+	std::vector<std::string> sourceFiles{};
+	std::unordered_set<std::string> includedOnce{};
+};
+
+struct PendingProgram
+{
+	Program program;
+	GLuint programHandle;
+	std::vector<GLuint> shaderHandles;
+	std::vector<uint64_t> shaderObjectKeys;
+	std::vector<PreprocessedShader> shaders;
+	uint64_t hash;
+};
+
 struct GlslFile
 {
 	std::string filename;
-	uint64_t timestamp = 0;
 	std::unordered_set<Program> dependablePrograms{};
 
 	GlslFile() {}
@@ -64,6 +108,9 @@ std::string shaderDirectory{ "shaders/" };
 
 std::unordered_map<std::string, GlslFile> managedFiles;
 
+// Parsed source files, which are only re-read from disk when they have changed
+std::unordered_map<std::string, SourceFile> sourceFileCache{};
+
 std::unordered_map<std::string, ShaderErrorReport> nonCompilingShaders{};
 
 // Maps from a program name to an index into the publicProgramHandles array
@@ -72,11 +119,49 @@ std::unordered_map<std::string, size_t> managedPrograms{};
 // Maps from a program location to a list of material ID's that need to be reinit on program changes
 std::unordered_map<size_t, std::unordered_set<ShaderDepandant *>> dependantObjects{};
 
-// It is very important that the memory below is never moved or reordered!
-// External pointers point to elements in in this array
-std::array<GLuint, MAX_NUM_MANAGED_PROGRAMS> publicProgramHandles{};
+// It is very important that the memory below is never moved or reordered! External pointers point to elements in this
+// deque, which never moves its elements when growing at the end.
+std::deque<GLuint> publicProgramHandles{};
+
+// Compiled shader objects, shared by all programs that have a stage with the exact same preprocessed source. Keyed by
+// a hash of the shader type and source, and referenced by pending programs and the currently used programs.
+struct ShaderObject
+{
+	GLuint handle;
+	int references;
+};
+
+std::unordered_map<uint64_t, ShaderObject> shaderObjects{};
 
-size_t nextPublicHandleIndex = 0;
+// Reflection of all loaded programs, so that no uniform etc. has to be looked up through GL by name after loading
+struct ProgramReflection
+{
+	std::unordered_map<std::string, ShaderSystem::ReflectedUniform> uniforms{};
+	std::unordered_map<std::string, GLint> uniformBlockBindings{};
+	std::unordered_map<std::string, GLint> storageBlockBindings{};
+};
+
+std::unordered_map<GLuint, ProgramReflection> programReflections{};
+std::unordered_map<size_t, std::vector<uint64_t>> programShaderObjects{};
+
+// The file watcher runs on its own thread and hands over sets of changed files (relative to the shader directory)
+std::thread fileWatcherThread{};
+std::atomic<bool> runFileWatcher{ false };
+
+std::mutex changedFilesMutex{};
+std::unordered_set<std::string> changedFiles{};
+std::atomic<bool> hasChangedFiles{ false };
+
+// Program binaries are cached on disk, keyed by a hash of the preprocessed sources and the driver
+std::string programCacheDirectory{ "shader_cache/" };
+ShaderSystem::ProgramCacheStats programCacheStats{};
+
+// Reloaded programs that are compiling & linking in parallel. The old programs are used until they are done.
+std::vector<PendingProgram> pendingPrograms{};
+
+// Editors often save in bursts (e.g. write a temporary file, rename it, touch it), so only report changes once it's quiet
+#define FILE_WATCHER_DEBOUNCE_MS 100
+#define FILE_WATCHER_POLL_INTERVAL_MS 250
 
 //
 // Internal API
@@ -93,55 +178,205 @@ AddManagedFile(const std::string& filename, const Program& dependableProgram)
 	managedFiles[filename].dependablePrograms.emplace(dependableProgram);
 }
 
-uint64_t
-GetTimestamp(const GlslFile& file)
+void
+PublishChangedFiles(std::unordered_set<std::string>& files)
 {
-	auto filename = shaderDirectory + file.filename;
-	uint64_t timestamp = 0;
+	std::lock_guard<std::mutex> lock(changedFilesMutex);
+	changedFiles.insert(files.begin(), files.end());
+	hasChangedFiles = true;
+
+	files.clear();
+}
+
+#ifdef __linux__
+
+void
+WatchShaderDirectory()
+{
+	namespace fs = std::filesystem;
+	using Clock = std::chrono::steady_clock;
+
+	int fd = inotify_init1(IN_NONBLOCK);
+	if (fd < 0)
+	{
+		Log("Could not initialize inotify, shader hot reloading is disabled.\n");
+		return;
+	}
+
+	// Maps from watch descriptors to directories, relative to the shader directory. Note that directories that are
+	// created after this point won't be watched.
+	std::unordered_map<int, std::string> watchedDirectories{};
+	auto addWatch = [&](const std::string& relativeDirectory)
+	{
+		std::string path = shaderDirectory + relativeDirectory;
+		int wd = inotify_add_watch(fd, path.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+		if (wd >= 0) watchedDirectories[wd] = relativeDirectory;
+	};
+
+	addWatch("");
+	std::error_code error;
+	for (const auto& entry : fs::recursive_directory_iterator(shaderDirectory, error))
+	{
+		if (entry.is_directory())
+		{
+			addWatch(fs::relative(entry.path(), shaderDirectory).generic_string() + "/");
+		}
+	}
 
-#ifdef _WIN32
-	struct __stat64 stFileInfo;
-	if (_stat64(filename.c_str(), &stFileInfo) == 0)
+	std::unordered_set<std::string> pendingFiles{};
+	Clock::time_point lastEventTime{};
+
+	alignas(inotify_event) char buffer[4096];
+
+	while (runFileWatcher)
 	{
-		timestamp = stFileInfo.st_mtime;
+		pollfd pollDescriptor = { fd, POLLIN, 0 };
+		if (poll(&pollDescriptor, 1, FILE_WATCHER_DEBOUNCE_MS / 2) > 0)
+		{
+			ssize_t length;
+			while ((length = read(fd, buffer, sizeof(buffer))) > 0)
+			{
+				const inotify_event *event;
+				for (char *ptr = buffer; ptr < buffer + length; ptr += sizeof(inotify_event) + event->len)
+				{
+					event = reinterpret_cast<const inotify_event *>(ptr);
+					if (event->len == 0 || (event->mask & IN_ISDIR)) continue;
+
+					auto directory = watchedDirectories.find(event->wd);
+					if (directory != watchedDirectories.end())
+					{
+						pendingFiles.insert(directory->second + event->name);
+					}
+				}
+			}
+
+			lastEventTime = Clock::now();
+		}
+
+		if (!pendingFiles.empty() && Clock::now() - lastEventTime > std::chrono::milliseconds(FILE_WATCHER_DEBOUNCE_MS))
+		{
+			PublishChangedFiles(pendingFiles);
+		}
 	}
+
+	close(fd);
+}
+
 #else
-	#warning "ShaderLoader doesn't currently support anything other than Windows for shader reloading!"
-#endif
 
-		return timestamp;
+void
+WatchShaderDirectory()
+{
+	// Fallback for platforms without a file watcher implementation: poll all modification times. It's not event driven,
+	// but at least it's off the main thread and it doesn't have to touch the managed files.
+	namespace fs = std::filesystem;
+
+	std::unordered_map<std::string, fs::file_time_type> timestamps{};
+	std::unordered_set<std::string> pendingFiles{};
+	bool initialScan = true;
+
+	while (runFileWatcher)
+	{
+		bool anyChanges = false;
+
+		std::error_code error;
+		for (const auto& entry : fs::recursive_directory_iterator(shaderDirectory, error))
+		{
+			if (!entry.is_regular_file()) continue;
+
+			std::string filename = fs::relative(entry.path(), shaderDirectory).generic_string();
+			fs::file_time_type timestamp = entry.last_write_time(error);
+
+			auto it = timestamps.find(filename);
+			if (!initialScan && (it == timestamps.end() || it->second != timestamp))
+			{
+				pendingFiles.insert(filename);
+				anyChanges = true;
+			}
+
+			timestamps[filename] = timestamp;
+		}
+
+		initialScan = false;
+
+		// Only publish when there were no new changes since the last scan (which is enough of a debounce here)
+		if (!pendingFiles.empty() && !anyChanges)
+		{
+			PublishChangedFiles(pendingFiles);
+		}
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(FILE_WATCHER_POLL_INTERVAL_MS));
+	}
 }
 
+#endif
+
 bool
 FileReadable(const std::string& filename)
 {
+	// (files from the pre-baked bundle are readable without touching the disk)
+	if (sourceFileCache.find(filename) != sourceFileCache.end())
+	{
+		return true;
+	}
+
 	auto path = shaderDirectory + filename;
 	std::ifstream ifs(path);
 	return ifs.good();
 }
 
-void
-ReadFileWithIncludes(const std::string& filename, const Program& dependableProgram, std::stringstream& sourceBuffer)
+const SourceFile&
+GetSourceFile(const std::string& filename)
 {
-	// (won't do anything if the file is already managed)
-	AddManagedFile(filename, dependableProgram);
+	auto cached = sourceFileCache.find(filename);
+	if (cached != sourceFileCache.end())
+	{
+		return cached->second;
+	}
+
+	SourceFile& file = sourceFileCache[filename];
+	file.chunks.push_back(SourceFile::Chunk{ "", 1, "" });
 
 	auto path = shaderDirectory + filename;
 	std::ifstream ifs(path);
 	if (!ifs.good())
 	{
 		Log("Could not read shader file '%s'.\n", filename.c_str());
+		return file;
+	}
+
+	std::vector<std::string> lines{};
+	for (std::string line; std::getline(ifs, line);)
+	{
+		lines.push_back(line);
 	}
 
-	std::string line;
-	while (std::getline(ifs, line))
+	auto startsWith = [](const std::string& line, const char *prefix)
 	{
+		size_t start = line.find_first_not_of(" \t");
+		return start != std::string::npos && line.compare(start, strlen(prefix), prefix) == 0;
+	};
+
+	for (size_t i = 0; i < lines.size(); ++i)
+	{
+		const std::string& line = lines[i];
+		int lineNumber = int(i) + 1;
+
+		if (startsWith(line, "#pragma once"))
+		{
+			// (keep the empty line so that line numbers are unaffected)
+			file.includeOnce = true;
+			file.chunks.back().text += '\n';
+			continue;
+		}
+
 		size_t commentIndex = line.find("//");
 		size_t index = line.find("#include");
 
 		if (index == -1 || (commentIndex < index && commentIndex != -1))
 		{
-			sourceBuffer << line;
+			file.chunks.back().text += line;
+			file.chunks.back().text += '\n';
 		}
 		else
 		{
@@ -156,75 +391,580 @@ ReadFileWithIncludes(const std::string& filename, const Program& dependableProgr
 				LogError("Invalid include directive: %s\n", line.c_str());
 			}
 
-			std::string includeFile = line.substr(start, count);
-			ReadFileWithIncludes(includeFile, dependableProgram, sourceBuffer);
-		}
+			std::string includeFile = line.substr(start, count);
+			file.chunks.push_back(SourceFile::Chunk{ includeFile, lineNumber + 1, "" });
+		}
+	}
+
+	// Files with a classic include guard (#ifndef X, #define X, ..., #endif) are also only included once
+	std::vector<std::string> directives{};
+	for (const std::string& line : lines)
+	{
+		if (line.find_first_not_of(" \t\r") != std::string::npos) directives.push_back(line);
+	}
+	if (directives.size() >= 3 && startsWith(directives[0], "#ifndef") && startsWith(directives[1], "#define") && startsWith(directives.back(), "#endif"))
+	{
+		std::string guard = directives[0].substr(directives[0].find("#ifndef") + 7);
+		std::string define = directives[1].substr(directives[1].find("#define") + 7);
+		if (std::stringstream(guard) >> guard && std::stringstream(define) >> define && guard == define)
+		{
+			file.includeOnce = true;
+		}
+	}
+
+	return file;
+}
+
+std::string
+PermutationDefineDirectives(const std::string& defines)
+{
+	std::string directives{};
+
+	std::stringstream stream{ defines };
+	for (std::string define; stream >> define;)
+	{
+		size_t equals = define.find('=');
+		if (equals != std::string::npos)
+		{
+			define[equals] = ' ';
+		}
+		directives += "#define " + define + "\n";
+	}
+
+	return directives;
+}
+
+// All define sets of the permutations declared in a stage file, i.e. every combination of the values listed in its
+// "// permutation: NAME value value ..." lines. A file without declarations has a single empty set.
+std::vector<std::string>
+PermutationDefineSets(const SourceFile& file)
+{
+	const std::string marker = "// permutation:";
+
+	std::vector<std::string> defineSets{ "" };
+	for (const SourceFile::Chunk& chunk : file.chunks)
+	{
+		std::stringstream lines{ chunk.text };
+		for (std::string line; std::getline(lines, line);)
+		{
+			size_t start = line.find_first_not_of(" \t");
+			if (start == std::string::npos || line.compare(start, marker.size(), marker) != 0)
+			{
+				continue;
+			}
+
+			std::stringstream tokens{ line.substr(start + marker.size()) };
+			std::string name;
+			if (!(tokens >> name))
+			{
+				continue;
+			}
+
+			std::vector<std::string> combined{};
+			for (std::string value; tokens >> value;)
+			{
+				for (const std::string& defines : defineSets)
+				{
+					combined.push_back(defines + (defines.empty() ? "" : " ") + name + "=" + value);
+				}
+			}
+
+			if (!combined.empty())
+			{
+				defineSets = std::move(combined);
+			}
+		}
+	}
+
+	return defineSets;
+}
+
+// The defines are the permutation defines to insert, which is only done for the last stage of a program
+void
+PreprocessFile(const std::string& filename, const Program& dependableProgram, const std::string& defines, PreprocessedShader& output)
+{
+	// (won't do anything if the file is already managed)
+	AddManagedFile(filename, dependableProgram);
+
+	const SourceFile& file = GetSourceFile(filename);
+	if (file.includeOnce && !output.includedOnce.insert(filename).second)
+	{
+		return;
+	}
+
+	int sourceIndex = int(output.sourceFiles.size());
+	output.sourceFiles.push_back(filename);
+
+	for (size_t i = 0; i < file.chunks.size(); ++i)
+	{
+		const SourceFile::Chunk& chunk = file.chunks[i];
+
+		if (!chunk.includeFile.empty())
+		{
+			PreprocessFile(chunk.includeFile, dependableProgram, defines, output);
+		}
+
+		// Permutation defines are inserted directly after the #version directive (which must come first)
+		if (sourceIndex == 0 && i == 0 && !defines.empty())
+		{
+			size_t versionEnd = chunk.text.find('\n') + 1;
+			output.source += chunk.text.substr(0, versionEnd);
+			output.source += PermutationDefineDirectives(defines);
+			output.source += "#line 2 0\n";
+			output.source += chunk.text.substr(versionEnd);
+			continue;
+		}
+
+		// Let the line numbers in compilation errors refer to the actual files. The very first chunk can't have a
+		// #line directive since the #version must come first, but it's source string 0, line 1 anyway.
+		if (sourceIndex > 0 || i > 0)
+		{
+			output.source += "#line " + std::to_string(chunk.firstLine) + " " + std::to_string(sourceIndex) + "\n";
+		}
+
+		output.source += chunk.text;
+	}
+}
+
+// FNV-1a (64-bit)
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ull
+
+uint64_t
+HashBytes(uint64_t hash, const void *data, size_t size)
+{
+	const uint8_t *bytes = static_cast<const uint8_t *>(data);
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+	}
+	return hash;
+}
+
+uint64_t
+HashShaderSource(GLenum type, const std::string& source)
+{
+	uint64_t hash = HashBytes(FNV_OFFSET_BASIS, &type, sizeof(GLenum));
+	return HashBytes(hash, source.data(), source.size());
+}
+
+uint64_t
+HashProgramSources(const std::vector<GLenum>& types, const std::vector<std::string>& sources)
+{
+	uint64_t hash = FNV_OFFSET_BASIS;
+	auto hashBytes = [&](const void *data, size_t size)
+	{
+		hash = HashBytes(hash, data, size);
+	};
+
+	// A program binary is only valid for the exact driver that produced it
+	static std::string driverIdentifier = std::string(reinterpret_cast<const char *>(glGetString(GL_VENDOR))) + "|"
+		+ reinterpret_cast<const char *>(glGetString(GL_RENDERER)) + "|"
+		+ reinterpret_cast<const char *>(glGetString(GL_VERSION));
+	hashBytes(driverIdentifier.data(), driverIdentifier.size());
+
+	for (size_t i = 0; i < sources.size(); ++i)
+	{
+		hashBytes(&types[i], sizeof(GLenum));
+		hashBytes(sources[i].data(), sources[i].size());
+	}
+
+	return hash;
+}
+
+std::string
+ProgramCachePath(uint64_t hash)
+{
+	std::stringstream path;
+	path << programCacheDirectory << std::hex << std::setfill('0') << std::setw(16) << hash << ".bin";
+	return path.str();
+}
+
+bool
+LoadCachedProgram(uint64_t hash, GLuint programHandle)
+{
+	std::ifstream file(ProgramCachePath(hash), std::ios::binary);
+	if (!file.is_open())
+	{
+		return false;
+	}
+
+	GLenum binaryFormat;
+	file.read(reinterpret_cast<char *>(&binaryFormat), sizeof(binaryFormat));
+	std::vector<char> binary{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+	if (binary.empty())
+	{
+		return false;
+	}
+
+	glProgramBinary(programHandle, binaryFormat, binary.data(), GLsizei(binary.size()));
+
+	// The driver is free to reject binaries (e.g. after an update that didn't change the version string)
+	GLint linkSuccess;
+	glGetProgramiv(programHandle, GL_LINK_STATUS, &linkSuccess);
+	if (linkSuccess != GL_TRUE)
+	{
+		programCacheStats.rejected += 1;
+		std::filesystem::remove(ProgramCachePath(hash));
+		return false;
+	}
+
+	return true;
+}
+
+void
+StoreCachedProgram(uint64_t hash, GLuint programHandle)
+{
+	GLint binaryLength;
+	glGetProgramiv(programHandle, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+	if (binaryLength <= 0)
+	{
+		return;
+	}
+
+	GLenum binaryFormat;
+	std::vector<char> binary(binaryLength);
+	glGetProgramBinary(programHandle, binaryLength, nullptr, &binaryFormat, binary.data());
+
+	std::error_code error;
+	std::filesystem::create_directories(programCacheDirectory, error);
+
+	std::ofstream file(ProgramCachePath(hash), std::ios::binary | std::ios::trunc);
+	file.write(reinterpret_cast<const char *>(&binaryFormat), sizeof(binaryFormat));
+	file.write(binary.data(), binary.size());
+}
+
+//
+// Pre-baked shader bundle, which contains all parsed source files (i.e. the content of the source file cache, including
+// the include dependencies) so that they can be loaded in a single read instead of one per file.
+//
+// Layout: magic, version, file count, and then for each file: name, include once flag, chunk count, and for each chunk:
+// include file, first line, text. All strings are stored as a 32-bit length followed by the characters.
+//
+
+#define SHADER_BUNDLE_MAGIC   0x42485350 // i.e. "PSHB"
+#define SHADER_BUNDLE_VERSION 1
+
+void
+WriteBundleValue(std::string& bundle, uint32_t value)
+{
+	bundle.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+void
+WriteBundleString(std::string& bundle, const std::string& string)
+{
+	WriteBundleValue(bundle, uint32_t(string.size()));
+	bundle.append(string);
+}
+
+struct BundleReader
+{
+	const std::vector<char>& data;
+	size_t offset = 0;
+	bool failed = false;
+
+	uint32_t ReadValue()
+	{
+		uint32_t value = 0;
+		if (offset + sizeof(value) > data.size()) { failed = true; return 0; }
+		std::memcpy(&value, data.data() + offset, sizeof(value));
+		offset += sizeof(value);
+		return value;
+	}
+
+	std::string ReadString()
+	{
+		uint32_t length = ReadValue();
+		if (failed || offset + length > data.size()) { failed = true; return ""; }
+		std::string string{ data.data() + offset, length };
+		offset += length;
+		return string;
+	}
+};
+
+bool
+LoadShaderBundle(const std::string& bundlePath)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	std::ifstream file(bundlePath, std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+	{
+		Log("Could not open shader bundle '%s', reading shader files individually.\n", bundlePath.c_str());
+		return false;
+	}
+
+	std::vector<char> data(size_t(file.tellg()));
+	file.seekg(0);
+	file.read(data.data(), data.size());
+
+	BundleReader reader{ data };
+	if (reader.ReadValue() != SHADER_BUNDLE_MAGIC || reader.ReadValue() != SHADER_BUNDLE_VERSION)
+	{
+		Log("Shader bundle '%s' is invalid or outdated, reading shader files individually.\n", bundlePath.c_str());
+		return false;
+	}
+
+	std::unordered_map<std::string, SourceFile> files{};
+
+	uint32_t fileCount = reader.ReadValue();
+	for (uint32_t i = 0; i < fileCount && !reader.failed; ++i)
+	{
+		std::string filename = reader.ReadString();
+		SourceFile& sourceFile = files[filename];
+		sourceFile.includeOnce = reader.ReadValue() != 0;
+
+		uint32_t chunkCount = reader.ReadValue();
+		for (uint32_t j = 0; j < chunkCount && !reader.failed; ++j)
+		{
+			SourceFile::Chunk chunk;
+			chunk.includeFile = reader.ReadString();
+			chunk.firstLine = int(reader.ReadValue());
+			chunk.text = reader.ReadString();
+			sourceFile.chunks.push_back(std::move(chunk));
+		}
+	}
+
+	if (reader.failed)
+	{
+		Log("Shader bundle '%s' is truncated, reading shader files individually.\n", bundlePath.c_str());
+		return false;
+	}
+
+	sourceFileCache = std::move(files);
+
+	auto duration = std::chrono::high_resolution_clock::now() - startTime;
+	double milliseconds = std::chrono::duration<double, std::milli>(duration).count();
+	Log("Loaded %u shader files from bundle '%s' in %.2f ms\n", fileCount, bundlePath.c_str(), milliseconds);
+
+	return true;
+}
+
+GLuint
+AcquireShaderObject(uint64_t key, GLenum type, const std::string& source)
+{
+	auto existing = shaderObjects.find(key);
+	if (existing != shaderObjects.end())
+	{
+		programCacheStats.sharedShaderObjects += 1;
+		existing->second.references += 1;
+		return existing->second.handle;
+	}
+
+	GLuint shaderHandle = glCreateShader(type);
+
+	const GLchar* shaderSources[] = { source.c_str() };
+	glShaderSource(shaderHandle, 1, shaderSources, nullptr);
+	glCompileShader(shaderHandle);
+
+	shaderObjects[key] = ShaderObject{ shaderHandle, 1 };
+	return shaderHandle;
+}
+
+void
+ReleaseShaderObjects(const std::vector<uint64_t>& keys)
+{
+	for (uint64_t key : keys)
+	{
+		auto it = shaderObjects.find(key);
+		if (it != shaderObjects.end() && --it->second.references == 0)
+		{
+			glDeleteShader(it->second.handle);
+			shaderObjects.erase(it);
+		}
+	}
+}
+
+void
+ReflectProgram(GLuint programHandle)
+{
+	ProgramReflection& reflection = programReflections[programHandle];
+	reflection = ProgramReflection{};
+
+	static GLchar nameBuffer[256];
+
+	GLint numUniforms;
+	glGetProgramInterfaceiv(programHandle, GL_UNIFORM, GL_ACTIVE_RESOURCES, &numUniforms);
+	for (GLint i = 0; i < numUniforms; ++i)
+	{
+		const GLenum properties[] = { GL_LOCATION, GL_TYPE, GL_ARRAY_SIZE };
+		GLint values[3];
+		glGetProgramResourceiv(programHandle, GL_UNIFORM, i, 3, properties, 3, nullptr, values);
+
+		// (uniforms in blocks have no location)
+		if (values[0] == -1) continue;
+
+		glGetProgramResourceName(programHandle, GL_UNIFORM, i, sizeof(nameBuffer), nullptr, nameBuffer);
+		std::string name{ nameBuffer };
+
+		ShaderSystem::ReflectedUniform uniform{ values[0], GLenum(values[1]), values[2] };
+		reflection.uniforms[name] = uniform;
+
+		// Arrays are reported as "name[0]", but should also be found by just their name
+		if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+		{
+			reflection.uniforms[name.substr(0, name.size() - 3)] = uniform;
+		}
+	}
+
+	auto reflectBlocks = [&](GLenum interface, std::unordered_map<std::string, GLint>& bindings)
+	{
+		GLint numBlocks;
+		glGetProgramInterfaceiv(programHandle, interface, GL_ACTIVE_RESOURCES, &numBlocks);
+		for (GLint i = 0; i < numBlocks; ++i)
+		{
+			const GLenum property = GL_BUFFER_BINDING;
+			GLint binding;
+			glGetProgramResourceiv(programHandle, interface, i, 1, &property, 1, nullptr, &binding);
+
+			glGetProgramResourceName(programHandle, interface, i, sizeof(nameBuffer), nullptr, nameBuffer);
+			bindings[nameBuffer] = binding;
+		}
+	};
+
+	reflectBlocks(GL_UNIFORM_BLOCK, reflection.uniformBlockBindings);
+	reflectBlocks(GL_SHADER_STORAGE_BLOCK, reflection.storageBlockBindings);
+}
+
+void
+ReplaceProgram(const Program& program, GLuint programHandle, const std::vector<uint64_t>& shaderObjectKeys)
+{
+	// The program successfully compiled and linked, it's safe to replace the old one
+
+	size_t index = program.fixedLocation;
+
+	// Keep references to the shader objects that the program is linked from, so they can be reused by other programs
+	ReleaseShaderObjects(programShaderObjects[index]);
+	programShaderObjects[index] = shaderObjectKeys;
+
+	GLuint oldProgramHandle = publicProgramHandles[index];
+	if (oldProgramHandle)
+	{
+		glDeleteProgram(oldProgramHandle);
+		programReflections.erase(oldProgramHandle);
+	}
+
+	ReflectProgram(programHandle);
+
+	publicProgramHandles[index] = programHandle;
+
+	// Label permutations so that they can be told apart in profilers & debuggers
+	if (!program.defines.empty())
+	{
+		std::string label = program.shaders.back().filename + " [" + program.defines + "]";
+		glObjectLabel(GL_PROGRAM, programHandle, GLsizei(label.size()), label.c_str());
+	}
 
-		sourceBuffer << '\n';
+	// Notify all dependant objects
+	for (auto shaderDependant : dependantObjects[program.fixedLocation])
+	{
+		if (shaderDependant)
+		{
+			shaderDependant->ProgramLoaded(programHandle);
+		}
 	}
 }
 
 void
-ReadFileWithIncludesTMP(const std::string& filename, std::stringstream& sourceBuffer)
+RecordProgramTime(std::chrono::high_resolution_clock::time_point startTime)
 {
-	auto path = shaderDirectory + filename;
-	std::ifstream ifs(path);
-	if (!ifs.good())
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - startTime;
+	programCacheStats.milliseconds += elapsed.count();
+}
+
+// Starts compiling and linking the program, without querying any status (which would force the driver to finish it).
+// Returns false if the program could be loaded directly from the cache, in which case there is nothing more to do.
+bool
+SubmitProgram(Program& program, PendingProgram& pending)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	pending.program = program;
+	pending.shaders.clear();
+	pending.shaderHandles.clear();
+	pending.shaderObjectKeys.clear();
+
+	// Preprocess all sources first, since we need them to look up the program in the cache
+	std::vector<GLenum> types{};
+	std::vector<std::string> sources{};
+	for (auto& shader : program.shaders)
 	{
-		Log("Could not read shader file '%s'.\n", filename.c_str());
+		// Only the last stage (fragment or compute) sees the permutation defines. That way the other stages have the
+		// same source for all permutations, so their shader objects are shared (and they share cache entries).
+		bool lastStage = &shader == &program.shaders.back();
+		const std::string& defines = lastStage ? program.defines : std::string();
+
+		PreprocessedShader preprocessed{};
+		PreprocessFile(shader.filename, program, defines, preprocessed);
+
+		types.push_back(shader.type);
+		sources.push_back(preprocessed.source);
+		pending.shaders.push_back(std::move(preprocessed));
 	}
 
-	std::string line;
-	while (std::getline(ifs, line))
-	{
-		size_t commentIndex = line.find("//");
-		size_t index = line.find("#include");
+	pending.programHandle = glCreateProgram();
+	pending.hash = HashProgramSources(types, sources);
 
-		if (index == -1 || (commentIndex < index && commentIndex != -1))
+	if (LoadCachedProgram(pending.hash, pending.programHandle))
+	{
+		for (auto& shader : program.shaders)
 		{
-			sourceBuffer << line;
+			nonCompilingShaders.erase(shader.filename);
 		}
-		else
-		{
-			// This isn't very precise but it should work assuming that
-			// the programmer isn't doing anything really stupid.
-			size_t start = line.find('<') + 1;
-			size_t end = line.find('>');
 
-			int count = int(end) - int(start);
-			if (count < 0)
-			{
-				LogError("Invalid include directive: %s\n", line.c_str());
-			}
+		programCacheStats.hits += 1;
+		ReplaceProgram(program, pending.programHandle, {});
+		RecordProgramTime(startTime);
+		return false;
+	}
 
-			std::string includeFile = line.substr(start, count);
-			ReadFileWithIncludesTMP(includeFile, sourceBuffer);
-		}
+	programCacheStats.misses += 1;
+
+	for (size_t i = 0; i < program.shaders.size(); ++i)
+	{
+		uint64_t key = HashShaderSource(types[i], sources[i]);
+		GLuint shaderHandle = AcquireShaderObject(key, types[i], sources[i]);
+
+		glAttachShader(pending.programHandle, shaderHandle);
+		pending.shaderHandles.push_back(shaderHandle);
+		pending.shaderObjectKeys.push_back(key);
+	}
+
+	glProgramParameteri(pending.programHandle, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(pending.programHandle);
+
+	RecordProgramTime(startTime);
+	return true;
+}
 
-		sourceBuffer << '\n';
+bool
+IsProgramReady(const PendingProgram& pending)
+{
+	// Without the extension we can't know, so just assume it's ready (which will then block until it is)
+	if (!GLAD_GL_KHR_parallel_shader_compile)
+	{
+		return true;
 	}
+
+	GLint completed;
+	glGetProgramiv(pending.programHandle, GL_COMPLETION_STATUS_KHR, &completed);
+	return completed == GL_TRUE;
 }
 
+// Checks the compile & link results of a submitted program, and if successful, replaces the old program with it
 void
-UpdateProgram(Program& program)
+FinalizeProgram(PendingProgram& pending)
 {
 	static GLchar statusBuffer[4096];
 	bool oneOrMoreShadersFailedToCompile = false;
 
-	GLuint programHandle = glCreateProgram();
-	std::vector<GLuint> shaderHandles{};
+	auto startTime = std::chrono::high_resolution_clock::now();
+	const Program& program = pending.program;
 
-	for (auto& shader : program.shaders)
+	for (size_t i = 0; i < program.shaders.size(); ++i)
 	{
-		std::stringstream sourceBuffer{};
-		ReadFileWithIncludes(shader.filename, program, sourceBuffer);
-
-		GLuint shaderHandle = glCreateShader(shader.type);
-
-		std::string source = sourceBuffer.str();
-		const GLchar* sources[] = { source.c_str() };
-		glShaderSource(shaderHandle, 1, sources, nullptr);
-		glCompileShader(shaderHandle);
+		const Shader& shader = program.shaders[i];
+		GLuint shaderHandle = pending.shaderHandles[i];
 
 		GLint compilationSuccess;
 		glGetShaderiv(shaderHandle, GL_COMPILE_STATUS, &compilationSuccess);
@@ -237,6 +977,7 @@ UpdateProgram(Program& program)
 			ShaderErrorReport report;
 			{
 				int lineNum = 1;
+				std::stringstream sourceBuffer{ pending.shaders[i].source };
 				std::stringstream textWithLineNrs;
 
 				for (std::string line; std::getline(sourceBuffer, line); ++lineNum)
@@ -245,63 +986,153 @@ UpdateProgram(Program& program)
 				}
 
 				report.preprocessedSource = textWithLineNrs.str();
-				report.errorMessage = std::string(statusBuffer);
 				report.shaderName = shader.filename;
+
+				// Append the source string numbers used in the error message, which refer to these files
+				std::stringstream message;
+				message << statusBuffer << "\nSource files:\n";
+				const auto& sourceFiles = pending.shaders[i].sourceFiles;
+				for (size_t fileIndex = 0; fileIndex < sourceFiles.size(); ++fileIndex)
+				{
+					message << std::setw(3) << fileIndex << ": " << sourceFiles[fileIndex] << std::endl;
+				}
+				report.errorMessage = message.str();
 			}
 			nonCompilingShaders[shader.filename] = report;
 		}
 		else
 		{
-			glAttachShader(programHandle, shaderHandle);
-			shaderHandles.push_back(shaderHandle);
-
 			// In case it previously haven't compiled, now remove it from the list
 			nonCompilingShaders.erase(shader.filename);
 		}
 	}
 
-	glLinkProgram(programHandle);
-
-	// (it's safe to detach and delete shaders after linking)
-	for (GLuint shaderHandle : shaderHandles)
+	// (it's safe to detach shaders after linking, and the shader objects are kept alive by their references)
+	for (GLuint shaderHandle : pending.shaderHandles)
 	{
-		glDetachShader(programHandle, shaderHandle);
-		glDeleteShader(shaderHandle);
+		glDetachShader(pending.programHandle, shaderHandle);
 	}
+	pending.shaderHandles.clear();
 
 	if (oneOrMoreShadersFailedToCompile)
 	{
+		ReleaseShaderObjects(pending.shaderObjectKeys);
+		glDeleteProgram(pending.programHandle);
+		RecordProgramTime(startTime);
 		return;
 	}
 
 	GLint linkSuccess;
-	glGetProgramiv(programHandle, GL_LINK_STATUS, &linkSuccess);
+	glGetProgramiv(pending.programHandle, GL_LINK_STATUS, &linkSuccess);
 
 	if (linkSuccess != GL_TRUE)
 	{
-		glGetProgramInfoLog(programHandle, sizeof(statusBuffer), nullptr, statusBuffer);
+		glGetProgramInfoLog(pending.programHandle, sizeof(statusBuffer), nullptr, statusBuffer);
 		Log("Shader program link error: %s\n", statusBuffer);
+		ReleaseShaderObjects(pending.shaderObjectKeys);
+		glDeleteProgram(pending.programHandle);
 	}
 	else
 	{
-		// The program successfully compiled and linked, it's safe to replace the old one
+		StoreCachedProgram(pending.hash, pending.programHandle);
+		ReplaceProgram(program, pending.programHandle, pending.shaderObjectKeys);
+	}
+
+	RecordProgramTime(startTime);
+}
+
+void
+DiscardPendingProgram(PendingProgram& pending)
+{
+	// (deleting the program also detaches its shaders)
+	ReleaseShaderObjects(pending.shaderObjectKeys);
+	glDeleteProgram(pending.programHandle);
+}
+
+// Loads the program and waits for the result. This is used for the initial load, since callers expect to be able to use
+// the program directly after adding it.
+void
+UpdateProgram(Program& program)
+{
+	PendingProgram pending;
+	if (SubmitProgram(program, pending))
+	{
+		FinalizeProgram(pending);
+	}
+}
+
+void
+AddPermutation(GLuint** programOut, std::vector<Shader> shaders, const std::string& defines, ShaderDepandant *shaderDependant, bool waitForLoad)
+{
+	std::string fullName{};
+	for (const Shader& shader : shaders)
+	{
+		fullName += shader.filename + "_";
+	}
+	fullName += "#" + defines;
+
+	auto existing = managedPrograms.find(fullName);
+	if (existing == managedPrograms.end())
+	{
+		Program program;
+		program.fixedLocation = publicProgramHandles.size();
+		publicProgramHandles.push_back(0);
+		program.shaders = std::move(shaders);
+		program.defines = defines;
+
+		for (const Shader& shader : program.shaders)
+		{
+			AddManagedFile(shader.filename, program);
+		}
 
-		size_t index = program.fixedLocation;
+		if (shaderDependant)
+		{
+			dependantObjects[program.fixedLocation].emplace(shaderDependant);
+		}
 
-		GLuint oldProgramHandle = publicProgramHandles[index];
-		if (oldProgramHandle)
+		managedPrograms[fullName] = program.fixedLocation;
+		*programOut = &publicProgramHandles[program.fixedLocation];
+
+		if (waitForLoad)
+		{
+			UpdateProgram(program);
+		}
+		else
 		{
-			glDeleteProgram(oldProgramHandle);
+			PendingProgram pending;
+			if (SubmitProgram(program, pending))
+			{
+				pendingPrograms.push_back(std::move(pending));
+			}
 		}
+	}
+	else
+	{
+		size_t fixedLocation = existing->second;
+		*programOut = &publicProgramHandles[fixedLocation];
 
-		publicProgramHandles[index] = programHandle;
+		// If it's still compiling in the background, but it's needed now, we have to wait for it
+		if (waitForLoad && !publicProgramHandles[fixedLocation])
+		{
+			for (auto it = pendingPrograms.begin(); it != pendingPrograms.end(); ++it)
+			{
+				if (it->program.fixedLocation == fixedLocation)
+				{
+					FinalizeProgram(*it);
+					pendingPrograms.erase(it);
+					break;
+				}
+			}
+		}
 
-		// Notify all dependant objects
-		for (auto shaderDependant : dependantObjects[program.fixedLocation])
+		if (shaderDependant && dependantObjects[fixedLocation].insert(shaderDependant).second)
 		{
-			if (shaderDependant)
+			// Since this exact program is added previously there is a chance that it's already loaded.
+			// If it is, call program loaded immediately so that it can perform its initial setup.
+			GLuint program = publicProgramHandles[fixedLocation];
+			if (program)
 			{
-				shaderDependant->ProgramLoaded(programHandle);
+				shaderDependant->ProgramLoaded(program);
 			}
 		}
 	}
@@ -312,29 +1143,288 @@ UpdateProgram(Program& program)
 //
 
 void
-ShaderSystem::Update()
+ShaderSystem::Init()
 {
-	static GLchar statusBuffer[4096];
-	std::unordered_set<Program> programsToUpdate{};
+	if (GLAD_GL_KHR_parallel_shader_compile)
+	{
+		// Let the driver decide how many threads to use
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+	}
+
+#ifdef PROSPECT_SHADER_BUNDLE
+	LoadShaderBundle(PROSPECT_SHADER_BUNDLE);
+#endif
+
+	runFileWatcher = true;
+	fileWatcherThread = std::thread(WatchShaderDirectory);
+}
+
+void
+ShaderSystem::Destroy()
+{
+	runFileWatcher = false;
+	if (fileWatcherThread.joinable())
+	{
+		fileWatcherThread.join();
+	}
+
+	for (PendingProgram& pending : pendingPrograms)
+	{
+		DiscardPendingProgram(pending);
+	}
+	pendingPrograms.clear();
+}
 
-	for (auto& pair : managedFiles)
+void
+ShaderSystem::Update()
+{
+	// (this is the common case, so keep it cheap)
+	if (!hasChangedFiles && pendingPrograms.empty())
 	{
-		GlslFile& file = pair.second;
+		return;
+	}
 
-		uint64_t timestamp = GetTimestamp(file);
-		if (timestamp != file.timestamp)
+	// Finalize the programs that are done, and keep polling the rest in later frames
+	for (auto it = pendingPrograms.begin(); it != pendingPrograms.end();)
+	{
+		if (IsProgramReady(*it))
+		{
+			FinalizeProgram(*it);
+			it = pendingPrograms.erase(it);
+		}
+		else
 		{
-			file.timestamp = timestamp;
+			++it;
+		}
+	}
 
+	if (!hasChangedFiles)
+	{
+		return;
+	}
+
+	std::unordered_set<std::string> files{};
+	{
+		std::lock_guard<std::mutex> lock(changedFilesMutex);
+		files.swap(changedFiles);
+		hasChangedFiles = false;
+	}
+
+	std::unordered_set<Program> programsToUpdate{};
+	for (const std::string& filename : files)
+	{
+		// The file has to be read again the next time it's used
+		sourceFileCache.erase(filename);
+
+		auto it = managedFiles.find(filename);
+		if (it != managedFiles.end())
+		{
 			// Add all programs that are dependant of this file (directly or included)
+			GlslFile& file = it->second;
 			programsToUpdate.insert(file.dependablePrograms.begin(), file.dependablePrograms.end());
 		}
 	}
 
+	// Submit all programs at once, so that the driver can compile them in parallel
 	for (auto program : programsToUpdate)
 	{
-		UpdateProgram(program);
+		// If the program is already being rebuilt, that result is outdated now
+		for (auto it = pendingPrograms.begin(); it != pendingPrograms.end(); ++it)
+		{
+			if (it->program.fixedLocation == program.fixedLocation)
+			{
+				DiscardPendingProgram(*it);
+				pendingPrograms.erase(it);
+				break;
+			}
+		}
+
+		PendingProgram pending;
+		if (SubmitProgram(program, pending))
+		{
+			pendingPrograms.push_back(std::move(pending));
+		}
+	}
+}
+
+bool
+ShaderSystem::BakeShaderBundle(const std::string& bundlePath)
+{
+	auto endsWith = [](const std::string& string, const std::string& suffix)
+	{
+		return string.size() >= suffix.size() && string.compare(string.size() - suffix.size(), suffix.size(), suffix) == 0;
+	};
+
+	// Parse all shader files, including the ones only used through includes
+	std::vector<std::string> stageFiles{};
+	for (auto& entry : std::filesystem::recursive_directory_iterator(shaderDirectory))
+	{
+		if (!entry.is_regular_file()) continue;
+
+		std::string filename = entry.path().lexically_relative(shaderDirectory).generic_string();
+		if (!endsWith(filename, ".glsl") && !endsWith(filename, ".h")) continue;
+
+		GetSourceFile(filename);
+
+		if (endsWith(filename, ".vert.glsl") || endsWith(filename, ".frag.glsl") || endsWith(filename, ".comp.glsl"))
+		{
+			stageFiles.push_back(filename);
+		}
+	}
+	std::sort(stageFiles.begin(), stageFiles.end());
+
+	// Validate all programs, using the same conventions as the apps: a vertex shader is paired with the fragment shader
+	// of the same name (if there is one), and a lone fragment shader is a fullscreen pass using the shared quad shader.
+	// Every permutation declared in the last stage (see PermutationDefineSets) is validated, as well as the defaults.
+	int numPrograms = 0;
+	int numFailed = 0;
+	for (const std::string& filename : stageFiles)
+	{
+		std::string vertName{};
+		std::string lastStageName{};
+
+		if (endsWith(filename, ".comp.glsl"))
+		{
+			lastStageName = filename;
+		}
+		else
+		{
+			std::string name = filename.substr(0, filename.size() - std::strlen(".vert.glsl"));
+
+			if (endsWith(filename, ".vert.glsl"))
+			{
+				vertName = filename;
+				lastStageName = name + ".frag.glsl";
+			}
+			else if (!FileReadable(name + ".vert.glsl"))
+			{
+				vertName = "quad.vert.glsl";
+				lastStageName = filename;
+			}
+			else
+			{
+				// (already validated together with its vertex shader)
+				continue;
+			}
+		}
+
+		std::vector<std::string> defineSets{ "" };
+		if (FileReadable(lastStageName))
+		{
+			std::vector<std::string> declared = PermutationDefineSets(GetSourceFile(lastStageName));
+			if (!declared.front().empty())
+			{
+				defineSets.insert(defineSets.end(), declared.begin(), declared.end());
+			}
+		}
+
+		for (const std::string& defines : defineSets)
+		{
+			GLuint *program = nullptr;
+			if (vertName.empty())
+			{
+				if (defines.empty()) program = AddComputeProgram(lastStageName);
+				else AddComputeProgramPermutation(&program, lastStageName, defines);
+			}
+			else
+			{
+				if (defines.empty()) program = AddProgram(vertName, lastStageName);
+				else AddProgramPermutation(&program, vertName, lastStageName, defines);
+			}
+
+			numPrograms += 1;
+			if (*program == 0)
+			{
+				Log("Shader validation failed for program with '%s' (defines: '%s')\n", filename.c_str(), defines.c_str());
+				numFailed += 1;
+			}
+		}
+	}
+
+	if (numFailed > 0)
+	{
+		Log("%d of %d shader programs failed to validate, no bundle is written\n", numFailed, numPrograms);
+		return false;
+	}
+
+	std::string bundle{};
+	WriteBundleValue(bundle, SHADER_BUNDLE_MAGIC);
+	WriteBundleValue(bundle, SHADER_BUNDLE_VERSION);
+	WriteBundleValue(bundle, uint32_t(sourceFileCache.size()));
+	for (auto& [filename, sourceFile] : sourceFileCache)
+	{
+		WriteBundleString(bundle, filename);
+		WriteBundleValue(bundle, sourceFile.includeOnce ? 1 : 0);
+		WriteBundleValue(bundle, uint32_t(sourceFile.chunks.size()));
+		for (auto& chunk : sourceFile.chunks)
+		{
+			WriteBundleString(bundle, chunk.includeFile);
+			WriteBundleValue(bundle, uint32_t(chunk.firstLine));
+			WriteBundleString(bundle, chunk.text);
+		}
+	}
+
+	std::ofstream file(bundlePath, std::ios::binary | std::ios::trunc);
+	file.write(bundle.data(), bundle.size());
+	if (!file.good())
+	{
+		Log("Could not write shader bundle '%s'\n", bundlePath.c_str());
+		return false;
+	}
+
+	Log("Validated %d shader programs and baked %zu shader files into '%s'\n", numPrograms, sourceFileCache.size(), bundlePath.c_str());
+	return true;
+}
+
+const ShaderSystem::ReflectedUniform *
+ShaderSystem::FindUniform(GLuint program, const std::string& name)
+{
+	auto reflection = programReflections.find(program);
+	if (reflection == programReflections.end())
+	{
+		return nullptr;
+	}
+
+	auto uniform = reflection->second.uniforms.find(name);
+	if (uniform == reflection->second.uniforms.end())
+	{
+		return nullptr;
 	}
+
+	return &uniform->second;
+}
+
+GLint
+ShaderSystem::GetUniformLocation(GLuint program, const std::string& name)
+{
+	const ReflectedUniform *uniform = FindUniform(program, name);
+	return uniform ? uniform->location : -1;
+}
+
+GLint
+ShaderSystem::GetUniformBlockBinding(GLuint program, const std::string& name)
+{
+	auto reflection = programReflections.find(program);
+	if (reflection == programReflections.end()) return -1;
+
+	auto block = reflection->second.uniformBlockBindings.find(name);
+	return (block != reflection->second.uniformBlockBindings.end()) ? block->second : -1;
+}
+
+GLint
+ShaderSystem::GetStorageBlockBinding(GLuint program, const std::string& name)
+{
+	auto reflection = programReflections.find(program);
+	if (reflection == programReflections.end()) return -1;
+
+	auto block = reflection->second.storageBlockBindings.find(name);
+	return (block != reflection->second.storageBlockBindings.end()) ? block->second : -1;
+}
+
+ShaderSystem::ProgramCacheStats
+ShaderSystem::GetProgramCacheStats()
+{
+	return programCacheStats;
 }
 
 std::vector<ShaderErrorReport>
@@ -362,7 +1452,8 @@ ShaderSystem::AddProgram(const std::string& vertName, const std::string& fragNam
 	if (managedPrograms.find(fullName) == managedPrograms.end())
 	{
 		Program program;
-		program.fixedLocation = nextPublicHandleIndex++;
+		program.fixedLocation = publicProgramHandles.size();
+		publicProgramHandles.push_back(0);
 
 		Shader vertexShader(GL_VERTEX_SHADER, vertName);
 		program.shaders.push_back(vertexShader);
@@ -420,7 +1511,8 @@ ShaderSystem::AddProgram(GLuint** programOut, const std::string& vertName, const
 	if (managedPrograms.find(fullName) == managedPrograms.end())
 	{
 		Program program;
-		program.fixedLocation = nextPublicHandleIndex++;
+		program.fixedLocation = publicProgramHandles.size();
+		publicProgramHandles.push_back(0);
 
 		Shader vertexShader(GL_VERTEX_SHADER, vertName);
 		program.shaders.push_back(vertexShader);
@@ -475,7 +1567,8 @@ ShaderSystem::AddComputeProgram(GLuint** programOut, const std::string& name, Sh
 	if (managedPrograms.find(name) == managedPrograms.end())
 	{
 		Program program;
-		program.fixedLocation = nextPublicHandleIndex++;
+		program.fixedLocation = publicProgramHandles.size();
+		publicProgramHandles.push_back(0);
 
 		Shader shader(GL_COMPUTE_SHADER, name);
 		program.shaders.push_back(shader);
@@ -519,7 +1612,8 @@ ShaderSystem::AddComputeProgram(const std::string& name, ShaderDepandant* shader
 	if (managedPrograms.find(name) == managedPrograms.end())
 	{
 		Program program;
-		program.fixedLocation = nextPublicHandleIndex++;
+		program.fixedLocation = publicProgramHandles.size();
+		publicProgramHandles.push_back(0);
 
 		Shader shader(GL_COMPUTE_SHADER, name);
 		program.shaders.push_back(shader);
@@ -557,3 +1651,27 @@ ShaderSystem::AddComputeProgram(const std::string& name, ShaderDepandant* shader
 		return &publicProgramHandles[fixedLocation];
 	}
 }
+
+void
+ShaderSystem::AddProgramPermutation(GLuint** programOut, const std::string& vertName, const std::string& fragName, const std::string& defines, ShaderDepandant *shaderDependant, bool waitForLoad)
+{
+	std::vector<Shader> shaders{};
+	shaders.emplace_back(GL_VERTEX_SHADER, vertName);
+
+	// Since there can be programs without fragment shaders, consider it optional
+	if (FileReadable(fragName))
+	{
+		shaders.emplace_back(GL_FRAGMENT_SHADER, fragName);
+	}
+
+	AddPermutation(programOut, std::move(shaders), defines, shaderDependant, waitForLoad);
+}
+
+void
+ShaderSystem::AddComputeProgramPermutation(GLuint** programOut, const std::string& name, const std::string& defines, ShaderDepandant *shaderDependant, bool waitForLoad)
+{
+	std::vector<Shader> shaders{};
+	shaders.emplace_back(GL_COMPUTE_SHADER, name);
+
+	AddPermutation(programOut, std::move(shaders), defines, shaderDependant, waitForLoad);
+}
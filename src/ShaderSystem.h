@@ -7,11 +7,6 @@
 
 #include "ShaderDependant.h"
 
-// Defines how many programs that the shader loader can manage. Should be set at a safe maximum.
-#ifndef MAX_NUM_MANAGED_PROGRAMS
- #define MAX_NUM_MANAGED_PROGRAMS 128
-#endif
-
 struct ShaderErrorReport
 {
 	std::string shaderName;
@@ -25,12 +20,55 @@ struct ShaderErrorReport
 //
 namespace ShaderSystem
 {
+	// Starts & stops the background thread that watches the shader directory for changes
+	void Init();
+	void Destroy();
+
 	// Reload recompile and relink shaders/programs if needed. Call this every
 	// render loop iteration before using any shaders managed by this shader loader.
 	void Update();
 
 	std::vector<ShaderErrorReport> GetShaderErrorReports();
 
+	// Compiles & links every program in the shader directory to validate it, and if all are valid, writes all parsed
+	// source files to a bundle. If the app is built with PROSPECT_SHADER_BUNDLE defined (as the path of the bundle) it's
+	// loaded in Init, so that no shader files have to be read from disk at startup. Requires a current GL context.
+	bool BakeShaderBundle(const std::string& bundlePath);
+
+	// Statistics for the on-disk program binary cache, accumulated since startup
+	struct ProgramCacheStats
+	{
+		int hits;
+		int misses;
+		int rejected;
+		int sharedShaderObjects;
+		double milliseconds;
+	};
+
+	ProgramCacheStats GetProgramCacheStats();
+
+	//
+	// Reflection: every program is reflected once when it's loaded. These lookups don't call into GL, but they are
+	// still hash lookups by name, so look up in e.g. ShaderDepandant::ProgramLoaded rather than when drawing.
+	//
+
+	struct ReflectedUniform
+	{
+		GLint location;
+		GLenum type;
+		GLint arraySize;
+	};
+
+	// Returns nullptr if the uniform isn't active in the program
+	const ReflectedUniform* FindUniform(GLuint program, const std::string& name);
+
+	// Returns -1 (like glGetUniformLocation) if the uniform isn't active in the program
+	GLint GetUniformLocation(GLuint program, const std::string& name);
+
+	// Returns the binding of the block, or -1 if the block isn't active in the program
+	GLint GetUniformBlockBinding(GLuint program, const std::string& name);
+	GLint GetStorageBlockBinding(GLuint program, const std::string& name);
+
 	//
 
 	// Add a shader program with the specified file name (*.vert.glsl and *.frag.glsl assumed)
@@ -45,4 +83,14 @@ namespace ShaderSystem
 	void AddComputeProgram(GLuint** programOut, const std::string& name, ShaderDepandant *shaderDependant = nullptr);
 
 	GLuint* AddComputeProgram(const std::string& name, ShaderDepandant *shaderDependant = nullptr);
+
+	// Add a permutation of a program, i.e. the program compiled with a set of defines, e.g. "TONEMAP_OPERATOR=2 FAST".
+	// Every permutation is managed as its own program. If waitForLoad is false the permutation is compiled in the
+	// background (when supported) and the program is 0 until it's done. Requesting it again with waitForLoad set will
+	// then wait for it to finish, so a typical use is to precompile all permutations and select one at bind time.
+	// The defines are only visible in the fragment (or compute) shader, so the vertex shader is shared between them.
+	void AddProgramPermutation(GLuint** programOut, const std::string& vertName, const std::string& fragName, const std::string& defines,
+	                           ShaderDepandant *shaderDependant = nullptr, bool waitForLoad = true);
+	void AddComputeProgramPermutation(GLuint** programOut, const std::string& name, const std::string& defines,
+	                                  ShaderDepandant *shaderDependant = nullptr, bool waitForLoad = true);
 }
@@ -1,16 +1,19 @@
 #include "ShadowMap.h"
 
+#include "GLState.h"
 #include "Logging.h"
+#include "TextureSystem.h"
 
-void
-ShadowMap::RecreateGpuResources(int size)
-{
-	this->size = size;
+// Smaller segments than this aren't useful for any light, so the quadtree doesn't need to go deeper
+#define SHADOW_MAP_MIN_SEGMENT_SIZE 128
 
-	glDeleteTextures(1, &texture);
+static void
+RecreateDepthTarget(int size, GLenum depthFormat, GLuint& framebuffer, GLuint& texture)
+{
+	GLState::DeleteTextures(1, &texture);
 	glCreateTextures(GL_TEXTURE_2D, 1, &texture);
 
-	glTextureStorage2D(texture, 1, GL_DEPTH_COMPONENT32F, size, size);
+	glTextureStorage2D(texture, 1, depthFormat, size, size);
 	glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
@@ -30,39 +33,87 @@ ShadowMap::RecreateGpuResources(int size)
 	{
 		LogError("The shadow pass framebuffer is not complete!");
 	}
-
 }
 
-/*
 void
-ShadowMap::AssignShadowMapSegments(std::vector<DirectionalLight>& dirLights)
+ShadowMap::RecreateGpuResources(int size, GLenum depthFormat)
 {
-	size_t totalLightCount = dirLights.size();
+	this->size = size;
+	this->depthFormat = depthFormat;
+
+	RecreateDepthTarget(size, depthFormat, framebuffer, texture);
+	RecreateDepthTarget(size, depthFormat, staticFramebuffer, staticTexture);
 
-	glm::mat4 toUv = glm::translate(vec3(0.5f)) * glm::scale(vec3(0.5f));
+	ResetSegments();
+}
 
-	if (totalLightCount <= 4)
+void
+ShadowMap::ResetSegments()
+{
+	int numLevels = 1;
+	for (int levelSize = size; levelSize > SHADOW_MAP_MIN_SEGMENT_SIZE; levelSize /= 2)
 	{
-		glm::mat4 uvScale = glm::scale(glm::vec3(0.5f));
-		glm::mat4 uvBias = glm::translate(glm::vec3(0.5f));
+		numLevels += 1;
+	}
 
-		int mid = size / 2;
+	freeNodes.resize(numLevels);
+	for (auto& nodes : freeNodes)
+	{
+		nodes.clear();
+	}
 
-		// TODO Make some automatic way of calculating the UV transform!
-		// i.e. Just by specifying the min and max xy and the total size!
+	freeNodes[0].emplace_back(0, 0);
+	allocatedTexels = 0;
+}
 
-		ShadowMapSegment segments[4] = {
-			{ 0, mid, 0, mid, uvScale * toUv, glm::mat4() },
-			{ 0, mid, mid, size, uvBias * uvScale * toUv, glm::mat4() },
-			{ 0, mid, 0, mid, uvBias * uvScale * toUv, glm::mat4() },
-			{ 0, mid, 0, mid, uvBias * uvScale * toUv, glm::mat4() }
-		};
+int
+ShadowMap::AllocateSegment(int requestedSize, glm::ivec2& minCorner)
+{
+	// The deepest level with nodes of at least the requested size
+	int level = 0;
+	while (level + 1 < int(freeNodes.size()) && (size >> (level + 1)) >= requestedSize)
+	{
+		level += 1;
 	}
-	else
+
+	// If there is no free node at this level, split a larger one, or fall back to a smaller size
+	for (; level < int(freeNodes.size()); ++level)
 	{
-		// TODO: Handle this case as well!
-		assert(false);
+		int parentLevel = level;
+		while (parentLevel >= 0 && freeNodes[parentLevel].empty())
+		{
+			parentLevel -= 1;
+		}
+
+		if (parentLevel < 0)
+		{
+			continue;
+		}
+
+		// Split down to the requested level, keeping the first child and freeing the other three at each level
+		glm::ivec2 node = freeNodes[parentLevel].back();
+		freeNodes[parentLevel].pop_back();
+
+		for (int splitLevel = parentLevel + 1; splitLevel <= level; ++splitLevel)
+		{
+			int childSize = size >> splitLevel;
+			freeNodes[splitLevel].emplace_back(node.x + childSize, node.y);
+			freeNodes[splitLevel].emplace_back(node.x, node.y + childSize);
+			freeNodes[splitLevel].emplace_back(node.x + childSize, node.y + childSize);
+		}
+
+		int segmentSize = size >> level;
+		allocatedTexels += int64_t(segmentSize) * int64_t(segmentSize);
+
+		minCorner = node;
+		return segmentSize;
 	}
 
+	return 0;
+}
+
+size_t
+ShadowMap::MemoryUsage() const
+{
+	return 2 * size_t(size) * size_t(size) * TextureSystem::BytesPerTexel(depthFormat);
 }
-*/
\ No newline at end of file
@@ -1,22 +1,52 @@
 #pragma once
 
+#include <vector>
+#include <cstdint>
+
 #include <glad/glad.h>
+#include <glm/glm.hpp>
 
-//#include "LightPass.h"
+//
+// The shadow map atlas, which all shadow casting lights (and cascades) render into. Segments are allocated as nodes of a
+// quadtree over the atlas, i.e. squares with power-of-two sizes, aligned to their size. All segments are freed and
+// reallocated every frame, so there is no fragmentation to deal with over time.
+//
 
 struct ShadowMap
 {
-	int size;
+	int size = 0;
 
-	GLuint framebuffer;
+	// GL_DEPTH_COMPONENT32F or GL_DEPTH_COMPONENT16
+	GLenum depthFormat = GL_DEPTH_COMPONENT32F;
 
-	// DEPTH_COMPONENT_32F
+	GLuint framebuffer = 0;
 	GLuint texture = 0;
 
+	// Same layout as the atlas, but with only the static casters, see ShadowPass
+	GLuint staticFramebuffer = 0;
+	GLuint staticTexture = 0;
+
 	////////////////////////////
 
-	void RecreateGpuResources(int size);
+	void RecreateGpuResources(int size, GLenum depthFormat);
+
+	// Frees all segments
+	void ResetSegments();
+
+	// Allocates a square segment of the requested (power-of-two) size, or the largest smaller size that still fits. Returns
+	// the size of the allocated segment, or 0 if the atlas is full.
+	int AllocateSegment(int requestedSize, glm::ivec2& minCorner);
+
+	// Texels covered by the segments allocated since the last reset
+	int64_t AllocatedTexels() const { return allocatedTexels; }
+
+	// (including the static caster cache)
+	size_t MemoryUsage() const;
+
+private:
 
-	//void AssignShadowMapSegments(std::vector<DirectionalLight>& dirLights/* TODO: Add the other lights here as well!*/);
+	// Free nodes per level of the quadtree, where level 0 is the whole atlas
+	std::vector<std::vector<glm::ivec2>> freeNodes{};
+	int64_t allocatedTexels = 0;
 
 };
@@ -1,63 +1,62 @@
 #include "ShadowPass.h"
 
+#include <cmath>
+
 #include <glad/glad.h>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 #include <imgui.h>
 
+#include "GLState.h"
 #include "TransformSystem.h"
 #include "ShaderSystem.h"
 #include "GuiSystem.h"
 #include "Logging.h"
+#include "PerformOnce.h"
 #include "Model.h"
+#include "Maths.h"
 
 using namespace glm;
 #include "shader_locations.h"
 #include "shader_constants.h"
 #include "shader_types.h"
 
-void
-ShadowPass::Draw(const ShadowMap& shadowMap, Scene& scene)
-{
-	// TODO: Pass in instead of setting up here!
-	
-	int lightCount = 1;
-
-	ShadowMapSegment dirLightSegment;
-	{
-		int minX = 4096;
-		int minY = 4096;
-		int maxX = 8192;
-		int maxY = 8192;
+// The fixed 8192x8192 32-bit atlas that was used before the segments were allocated, for comparisons in the GUI
+#define SHADOW_MAP_BASELINE_SIZE 8192
 
-		dirLightSegment.minX = minX;
-		dirLightSegment.minY = minY;
-		dirLightSegment.maxX = maxX;
-		dirLightSegment.maxY = maxY;
+// A caster that hasn't moved for this many frames is considered static and is rendered into the static cache
+#define SHADOW_STATIC_CASTER_FRAMES 30
 
-		vec2 textureSize = { shadowMap.size, shadowMap.size };
-		vec2 minUV = vec2(minX, minY) / textureSize;
-		vec2 maxUV = vec2(maxX, maxY) / textureSize;
-		vec2 sizeUV = maxUV - minUV;
-
-		mat4 toUnilateral = glm::translate(mat4(1.0f), vec3(0.5f)) * glm::scale(mat4(1.0f), vec3(0.5f));
-		mat4 uvScale = glm::scale(mat4(1.0f), vec3(sizeUV, 0.0f));
-		mat4 uvTranslation = glm::translate(mat4(1.0f), vec3(minUV, 0.0f));
-		dirLightSegment.uvTransform = uvTranslation * uvScale * toUnilateral;
-
-		auto dirLightView = glm::lookAtLH({ 0, 0, 0 }, vec3(scene.directionalLights[0].worldDirection), { 0, 1, 0 });
+static bool
+InsideShadowFrustum(std::array<glm::vec4, 6>& planes, const BoundingSphere& bounds)
+{
+	// The near plane is skipped, since with depth clamping casters in front of it still cast their shadows
+	for (int i : { 0, 1, 2, 3, 5 })
+	{
+		if (!InPositiveHalfSpace(planes[i], bounds)) return false;
+	}
+	return true;
+}
 
-		float size = 50.0f;
-		float zNear = -100.0f;
-		float zFar = +100.0f;
-		auto dirLightProjection = glm::orthoLH(-size, size, -size, size, zNear, zFar);
+static bool
+SameSegment(const ShadowMapSegment& a, const ShadowMapSegment& b)
+{
+	return a.minX == b.minX && a.minY == b.minY
+		&& a.maxX == b.maxX && a.maxY == b.maxY
+		&& a.lightViewProjection == b.lightViewProjection;
+}
 
-		dirLightSegment.lightViewProjection = dirLightProjection * dirLightView;
+void
+ShadowPass::Draw(ShadowMap& shadowMap, Scene& scene)
+{
+	GLenum depthFormat = settings.use16BitDepth ? GL_DEPTH_COMPONENT16 : GL_DEPTH_COMPONENT32F;
+	if (shadowMap.size != settings.atlasSize || shadowMap.depthFormat != depthFormat)
+	{
+		shadowMap.RecreateGpuResources(settings.atlasSize, depthFormat);
+		cachedStaticSegments.clear();
 	}
 
-	//
-
 	if (!shadowProgram)
 	{
 		shadowProgram = ShaderSystem::AddProgram("material/shadow");
@@ -72,88 +71,263 @@ ShadowPass::Draw(const ShadowMap& shadowMap, Scene& scene)
 		glBindBufferBase(GL_UNIFORM_BUFFER, PredefinedUniformBlockBinding(ShadowMapSegmentBlock), shadowMapSegmentUniformBuffer);
 	}
 
+	if (!timerQueries[0])
+	{
+		glCreateQueries(GL_TIME_ELAPSED, 2, timerQueries);
+	}
+
+	//
+	// Find the dynamic casters. If any caster moves between the static and dynamic set the static cache is outdated.
+	//
+
+	std::vector<bool> isDynamic(scene.models.size());
+	for (size_t i = 0; i < scene.models.size(); ++i)
+	{
+		int framesSinceChange = TransformSystem::FramesSinceChange(scene.models[i].transformID);
+		isDynamic[i] = !settings.cacheStaticCasters || framesSinceChange < SHADOW_STATIC_CASTER_FRAMES;
+	}
+
+	if (isDynamic != dynamicCasters)
+	{
+		cachedStaticSegments.clear();
+	}
+	dynamicCasters = std::move(isDynamic);
+
 	//
 	// Reserve segments/parts of the shadow map for the different lights
 	//
 
+	int cascadeCount = glm::clamp(settings.cascadeCount, 1, SHADOW_CASCADE_MAX_COUNT);
+
 	std::vector<ShadowMapSegment> shadowMapSegments;
-	shadowMapSegments.reserve(lightCount);
+	shadowMapSegments.reserve(scene.directionalLights.size() * cascadeCount);
+
+	shadowMap.ResetSegments();
 
-	// TODO/REMOVE: for the directional light
-	int index = (int)shadowMapSegments.size();
-	shadowMapSegments.push_back(dirLightSegment);
-	scene.directionalLights[0].shadowMapSegmentIndex = ivec4(index, 0, 0, 0);
+	float cascadeSplits[SHADOW_CASCADE_MAX_COUNT + 1];
+	ComputeCascadeSplits(*scene.mainCamera, cascadeCount, cascadeSplits);
+
+	for (DirectionalLight& dirLight : scene.directionalLights)
+	{
+		dirLight.shadowMapSegmentIndex = ivec4(int(shadowMapSegments.size()), 0, 0, 0);
+
+		for (int cascade = 0; cascade < cascadeCount; ++cascade)
+		{
+			// There is no good way of knowing how much of the screen each cascade covers (without reading back the depth
+			// buffer) so assume that they share it equally. Since the size is rounded down, all cascades of a light also
+			// fit in the atlas together.
+			int requestedSize = SegmentSizeForImportance(1.0f / float(cascadeCount));
+
+			glm::ivec2 minCorner;
+			int segmentSize = shadowMap.AllocateSegment(requestedSize, minCorner);
+			if (segmentSize == 0 || shadowMapSegments.size() == SHADOW_MAP_SEGMENT_MAX_COUNT)
+			{
+				// (the remaining cascades will be unshadowed)
+				break;
+			}
+
+			float nearDepth = cascadeSplits[cascade];
+			float farDepth = cascadeSplits[cascade + 1];
+			shadowMapSegments.push_back(CreateShadowMapSegmentForCascade(shadowMap, dirLight, scene, nearDepth, farDepth, minCorner, segmentSize));
+
+			dirLight.shadowMapSegmentIndex.y += 1;
+			dirLight.cascadeSplits[cascade] = farDepth;
+		}
+
+		if (dirLight.shadowMapSegmentIndex.y == 0)
+		{
+			dirLight.shadowMapSegmentIndex.x = -1;
+		}
+	}
+
+	// With the initial settings every cascade of the (first) light must get a segment
+	PerformOnce(
+		if (!scene.directionalLights.empty() && scene.directionalLights[0].shadowMapSegmentIndex.y != cascadeCount)
+		{
+			Log("Only %d of %d shadow cascades fit in the shadow map atlas, the rest are unshadowed\n", scene.directionalLights[0].shadowMapSegmentIndex.y, cascadeCount);
+		}
+	);
 
 	size_t numSegments = shadowMapSegments.size();
-	assert(numSegments <= SHADOW_MAP_SEGMENT_MAX_COUNT);
 	glNamedBufferSubData(shadowMapSegmentUniformBuffer, 0, numSegments * sizeof(ShadowMapSegment), shadowMapSegments.data());
 
 	//
 	// Render the shadow maps into the set
 	//
 
-	const float farDepth = 1.0f;
-	glClearTexImage(shadowMap.texture, 0, GL_DEPTH_COMPONENT, GL_FLOAT, &farDepth);
+	// Read the timer from two frames ago, which should be done by now
+	int queryIndex = frameIndex++ % 2;
+	if (frameIndex > 2)
+	{
+		GLuint64 elapsedNanoseconds;
+		glGetQueryObjectui64v(timerQueries[queryIndex], GL_QUERY_RESULT, &elapsedNanoseconds);
+		double elapsedMs = double(elapsedNanoseconds) / 1e6;
+		(timedStaticRedraw[queryIndex] ? redrawGpuMs : cachedGpuMs) = elapsedMs;
+	}
+
+	glBeginQuery(GL_TIME_ELAPSED, timerQueries[queryIndex]);
 
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, shadowMap.framebuffer);
-	glUseProgram(*shadowProgram);
+	GLState::UseProgram(*shadowProgram);
+	GLState::Enable(GL_DEPTH_TEST);
+	GLState::Enable(GL_DEPTH_CLAMP);
 
 	// cull front faces to avoid shadow acne a bit
-	glEnable(GL_CULL_FACE);
-	glCullFace(GL_FRONT);
+	GLState::Enable(GL_CULL_FACE);
+	GLState::CullFace(GL_FRONT);
 
 	int numDrawCalls = 0;
+	int numAvoidedDrawCalls = 0;
 	int numTriangles = 0;
+	bool anyStaticRedraw = false;
+
+	cachedStaticDrawCalls.resize(shadowMapSegments.size());
 
-	for (const ShadowMapSegment& segment : shadowMapSegments)
+	for (size_t segmentIdx = 0; segmentIdx < shadowMapSegments.size(); ++segmentIdx)
 	{
+		const ShadowMapSegment& segment = shadowMapSegments[segmentIdx];
+
 		int width = segment.maxX - segment.minX;
 		int height = segment.maxY - segment.minY;
-		glViewport(segment.minX, segment.minY, width, height);
+		GLState::Viewport(segment.minX, segment.minY, width, height);
 
 		glUniformMatrix4fv(PredefinedUniformLocation(u_projection_from_world), 1, false, glm::value_ptr(segment.lightViewProjection));
 
 		std::array<glm::vec4, 6> frustumPlanes{};
 		ExtractFrustumPlanes(segment.lightViewProjection, frustumPlanes);
 
-		for (const Model& model : scene.models)
+		auto drawCasters = [&](bool dynamic) {
+			int drawCalls = 0;
+			for (size_t i = 0; i < scene.models.size(); ++i)
+			{
+				const Model& model = scene.models[i];
+				if (!model.material->opaque || dynamicCasters[i] != dynamic) continue;
+
+				Transform& transform = TransformSystem::Get(model.transformID);
+				BoundingSphere worldSpaceBounds = model.bounds;
+				worldSpaceBounds.center += transform.position;
+				worldSpaceBounds.radius *= VectorMaxComponent(transform.scale);
+				if (!InsideShadowFrustum(frustumPlanes, worldSpaceBounds)) continue;
+
+				glUniformMatrix4fv(PredefinedUniformLocation(u_world_from_local), 1, false, glm::value_ptr(transform.matrix));
+				model.Draw();
+
+				drawCalls += 1;
+				numTriangles += TriangleCount(model);
+			}
+			numDrawCalls += drawCalls;
+			return drawCalls;
+		};
+
+		// Only clear the parts of the atlas that are in use
+		const float farDepth = 1.0f;
+
+		if (settings.cacheStaticCasters)
 		{
-			if (!model.material->opaque) continue;
-
-			Transform& transform = TransformSystem::Get(model.transformID);
-			BoundingSphere worldSpaceBounds = model.bounds;
-			worldSpaceBounds.center += transform.position;
-			if (!InsideFrustum(frustumPlanes, worldSpaceBounds)) continue;
-			
-			glUniformMatrix4fv(PredefinedUniformLocation(u_world_from_local), 1, false, glm::value_ptr(transform.matrix));
-			model.Draw();
-
-			numDrawCalls += 1;
-			numTriangles += TriangleCount(model);
+			bool cached = segmentIdx < cachedStaticSegments.size() && SameSegment(segment, cachedStaticSegments[segmentIdx]);
+			if (cached)
+			{
+				numAvoidedDrawCalls += cachedStaticDrawCalls[segmentIdx];
+			}
+			else
+			{
+				GLState::BindFramebuffer(shadowMap.staticFramebuffer);
+				glClearTexSubImage(shadowMap.staticTexture, 0, segment.minX, segment.minY, 0, width, height, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &farDepth);
+				cachedStaticDrawCalls[segmentIdx] = drawCasters(false);
+				anyStaticRedraw = true;
+			}
+
+			// Start from the static casters and add the dynamic ones on top
+			glCopyImageSubData(shadowMap.staticTexture, GL_TEXTURE_2D, 0, segment.minX, segment.minY, 0,
+			                   shadowMap.texture, GL_TEXTURE_2D, 0, segment.minX, segment.minY, 0, width, height, 1);
 		}
+		else
+		{
+			glClearTexSubImage(shadowMap.texture, 0, segment.minX, segment.minY, 0, width, height, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &farDepth);
+		}
+
+		GLState::BindFramebuffer(shadowMap.framebuffer);
+		drawCasters(true);
 	}
 
-	glCullFace(GL_BACK);
-	glUseProgram(0);
+	cachedStaticSegments = settings.cacheStaticCasters ? shadowMapSegments : std::vector<ShadowMapSegment>{};
+
+	glEndQuery(GL_TIME_ELAPSED);
+	timedStaticRedraw[queryIndex] = anyStaticRedraw || !settings.cacheStaticCasters;
+
+	GLState::CullFace(GL_BACK);
+	GLState::Disable(GL_DEPTH_CLAMP);
+	GLState::UseProgram(0);
 
 	if (ImGui::CollapsingHeader("Shadows"))
 	{
-		ImGui::Text("Shadow map size: %dx%d", shadowMap.size, shadowMap.size);
-		ImGui::Text("Draw calls: %d", numDrawCalls);
+		const char *atlasSizes[] = { "2048", "4096", "8192" };
+		int atlasSizeIndex = (settings.atlasSize >= 8192) ? 2 : (settings.atlasSize >= 4096) ? 1 : 0;
+		if (ImGui::Combo("Atlas size", &atlasSizeIndex, atlasSizes, IM_ARRAYSIZE(atlasSizes)))
+		{
+			settings.atlasSize = 2048 << atlasSizeIndex;
+		}
+		ImGui::Checkbox("16-bit depth", &settings.use16BitDepth);
+		ImGui::SliderFloat("Resolution scale", &settings.resolutionScale, 0.125f, 1.0f);
+		ImGui::SliderInt("Cascades", &settings.cascadeCount, 1, SHADOW_CASCADE_MAX_COUNT);
+		ImGui::SliderFloat("Cascade split lambda", &settings.cascadeSplitLambda, 0.0f, 1.0f);
+		ImGui::SliderFloat("Shadow distance", &settings.shadowDistance, 10.0f, 500.0f);
+		ImGui::Checkbox("Cache static casters", &settings.cacheStaticCasters);
+
+		// Compared to the fixed 8192x8192 32-bit atlas where a single 4096x4096 quadrant was used, and all of it was cleared
+		double baselineMb = double(SHADOW_MAP_BASELINE_SIZE) * SHADOW_MAP_BASELINE_SIZE * 4 / (1024.0 * 1024.0);
+		double baselineClearedTexels = double(SHADOW_MAP_BASELINE_SIZE) * SHADOW_MAP_BASELINE_SIZE;
+		ImGui::Text("Shadow map atlas: %dx%d, %.1f MB (%.1f MB before)", shadowMap.size, shadowMap.size, shadowMap.MemoryUsage() / (1024.0 * 1024.0), baselineMb);
+		ImGui::Text("Segments: %d, %.1f%% of the atlas in use", int(numSegments), 100.0 * shadowMap.AllocatedTexels() / (double(shadowMap.size) * shadowMap.size));
+		ImGui::Text("Cleared texels: %.1fM (%.1fM before)", shadowMap.AllocatedTexels() / 1e6, baselineClearedTexels / 1e6);
+		ImGui::Text("Draw calls: %d (%d avoided by the static cache)", numDrawCalls, numAvoidedDrawCalls);
+		ImGui::Text("GPU time: %.2f ms with cached static casters, %.2f ms when redrawing them", cachedGpuMs, redrawGpuMs);
+		ImGui::Text("Time saved: %.2f ms per cached frame", glm::max(0.0, redrawGpuMs - cachedGpuMs));
 		ImGui::Text("Triangles:  %d", numTriangles);
 		GuiSystem::Texture(shadowMap.texture, 1.0f);
 	}
 }
 
+int
+ShadowPass::SegmentSizeForImportance(float screenCoverage) const
+{
+	// Texels are distributed proportional to the screen area, so the side of the segment scales with the square root
+	float idealSize = settings.resolutionScale * float(settings.atlasSize) * std::sqrt(glm::clamp(screenCoverage, 0.0f, 1.0f));
+
+	// Round down to a power of two, so that segments requested for a total coverage of at most one fit in the atlas
+	int segmentSize = settings.atlasSize;
+	while (segmentSize > 1 && float(segmentSize) > idealSize)
+	{
+		segmentSize /= 2;
+	}
+
+	return segmentSize;
+}
+
+void
+ShadowPass::ComputeCascadeSplits(const CameraBase& camera, int cascadeCount, float splits[]) const
+{
+	float zNear = camera.GetNear();
+	float zFar = glm::min(camera.GetFar(), settings.shadowDistance);
+
+	// The "practical split scheme", i.e. a blend between logarithmic (lambda = 1) and uniform (lambda = 0) splits
+	for (int i = 0; i <= cascadeCount; ++i)
+	{
+		float fraction = float(i) / float(cascadeCount);
+		float logarithmicSplit = zNear * std::pow(zFar / zNear, fraction);
+		float uniformSplit = zNear + (zFar - zNear) * fraction;
+		splits[i] = glm::mix(uniformSplit, logarithmicSplit, settings.cascadeSplitLambda);
+	}
+}
+
 ShadowMapSegment
-ShadowPass::CreateShadowMapSegmentForDirectionalLight(const ShadowMap& shadowMap, const DirectionalLight& dirLight)
+ShadowPass::CreateShadowMapSegmentForCascade(const ShadowMap& shadowMap, const DirectionalLight& dirLight, const Scene& scene, float nearDepth, float farDepth, glm::ivec2 minCorner, int segmentSize)
 {
 	ShadowMapSegment segment;
 	
-	int minX = 4096;
-	int minY = 4096;
-	int maxX = 8192;
-	int maxY = 8192;
+	int minX = minCorner.x;
+	int minY = minCorner.y;
+	int maxX = minX + segmentSize;
+	int maxY = minY + segmentSize;
 
 	segment.minX = minX;
 	segment.minY = minY;
@@ -172,14 +346,66 @@ ShadowPass::CreateShadowMapSegmentForDirectionalLight(const ShadowMap& shadowMap
 	mat4 uvTranslation = glm::translate(id, vec3(minUV, 0.0f));
 	segment.uvTransform = uvTranslation * uvScale * toUnilateral;
 
-	auto dirLightView = glm::lookAtLH({ 0, 0, 0 }, vec3(dirLight.worldDirection), { 0, 1, 0 });
+	//
+	// Fit the cascade to a bounding sphere of the frustum slice. The sphere (unlike a tight box) doesn't change size when
+	// the camera rotates, so together with snapping it to whole texels the shadows are stable when the camera moves.
+	//
+
+	const CameraBase& camera = *scene.mainCamera;
+	mat4 worldFromView = glm::inverse(camera.GetViewMatrix());
+	float tanHalfFov = std::tan(camera.GetFieldOfView() / 2.0f);
+	float aspectRatio = camera.GetAspectRatio();
+
+	vec3 corners[8];
+	vec3 center = vec3(0.0f);
+	for (int i = 0; i < 8; ++i)
+	{
+		float depth = (i < 4) ? nearDepth : farDepth;
+		float x = ((i & 1) ? 1.0f : -1.0f) * depth * tanHalfFov * aspectRatio;
+		float y = ((i & 2) ? 1.0f : -1.0f) * depth * tanHalfFov;
+		corners[i] = vec3(worldFromView * vec4(x, y, depth, 1.0f));
+		center += corners[i] / 8.0f;
+	}
+
+	float radius = 0.0f;
+	for (const vec3& corner : corners)
+	{
+		radius = glm::max(radius, glm::length(corner - center));
+	}
+
+	// (round up, so that floating point imprecision doesn't change the size between frames)
+	radius = std::ceil(radius * 16.0f) / 16.0f;
+
+	mat4 lightView = glm::lookAtLH({ 0, 0, 0 }, vec3(dirLight.worldDirection), { 0, 1, 0 });
+	vec3 lightSpaceCenter = vec3(lightView * vec4(center, 1.0f));
+
+	float texelSize = 2.0f * radius / float(segmentSize);
+	lightSpaceCenter.x = std::floor(lightSpaceCenter.x / texelSize) * texelSize;
+	lightSpaceCenter.y = std::floor(lightSpaceCenter.y / texelSize) * texelSize;
 
-	float size = 50.0f;
-	float zNear = -100.0f;
-	float zFar = +100.0f;
-	auto dirLightProjection = glm::orthoLH(-size, size, -size, size, zNear, zFar);
+	// The depth range only has to cover the slice, and all (static) casters between it and the light
+	float minZ = lightSpaceCenter.z - radius;
+	float maxZ = lightSpaceCenter.z + radius;
+	// Only the static casters are included, so that the projection (and with it the static cache) isn't affected by the
+	// dynamic ones. Those are instead kept in the depth range by depth clamping.
+	for (size_t i = 0; i < scene.models.size(); ++i)
+	{
+		const Model& model = scene.models[i];
+		if (!model.material->opaque || dynamicCasters[i]) continue;
+
+		const Transform& transform = TransformSystem::Get(model.transformID);
+		vec3 casterCenter = vec3(lightView * vec4(model.bounds.center + transform.position, 1.0f));
+		float casterRadius = model.bounds.radius * VectorMaxComponent(transform.scale);
+
+		if (std::abs(casterCenter.x - lightSpaceCenter.x) > radius + casterRadius) continue;
+		if (std::abs(casterCenter.y - lightSpaceCenter.y) > radius + casterRadius) continue;
+
+		minZ = glm::min(minZ, casterCenter.z - casterRadius);
+	}
 
-	segment.lightViewProjection = dirLightProjection * dirLightView;
+	mat4 lightProjection = glm::orthoLH(lightSpaceCenter.x - radius, lightSpaceCenter.x + radius,
+	                                    lightSpaceCenter.y - radius, lightSpaceCenter.y + radius, minZ, maxZ);
+	segment.lightViewProjection = lightProjection * lightView;
 
 	return segment;
 }
@@ -12,13 +12,52 @@ class ShadowPass
 {
 public:
 
-	void Draw(const ShadowMap& shadowMap, Scene& scene);
+	void Draw(ShadowMap& shadowMap, Scene& scene);
+
+	struct
+	{
+		int atlasSize = 4096;
+		bool use16BitDepth = false;
+
+		// Scales all segment sizes, e.g. 0.5 to use a quarter of the texels for all lights
+		float resolutionScale = 1.0f;
+
+		// Cascades for directional lights, split between the camera's near plane and the shadow distance. A split lambda
+		// of 0 gives uniform splits and 1 gives logarithmic splits.
+		int cascadeCount = 3;
+		float cascadeSplitLambda = 0.8f;
+		float shadowDistance = 120.0f;
+
+		// Render casters that haven't moved in a while into a static cache, which is only updated when the light (or
+		// cascade) changes. Every frame the cache is copied into the atlas and only the moving casters are drawn.
+		bool cacheStaticCasters = true;
+	} settings;
 
 private:
 
-	ShadowMapSegment CreateShadowMapSegmentForDirectionalLight(const ShadowMap& shadowMap, const DirectionalLight& dirLight);
+	// The segment size for something that covers the given fraction of the screen
+	int SegmentSizeForImportance(float screenCoverage) const;
+
+	// Writes cascadeCount + 1 view space depths, from the near plane to the end of the last cascade
+	void ComputeCascadeSplits(const CameraBase& camera, int cascadeCount, float splits[]) const;
+
+	ShadowMapSegment CreateShadowMapSegmentForCascade(const ShadowMap& shadowMap, const DirectionalLight& dirLight, const Scene& scene,
+	                                                  float nearDepth, float farDepth, glm::ivec2 minCorner, int segmentSize);
 
 	GLuint *shadowProgram{ 0 };
 	GLuint shadowMapSegmentUniformBuffer{ 0 };
 
+	// Per model in the scene, from the last frame
+	std::vector<bool> dynamicCasters{};
+
+	// The segments in the static cache, and the draw calls spent on each of them
+	std::vector<ShadowMapSegment> cachedStaticSegments{};
+	std::vector<int> cachedStaticDrawCalls{};
+
+	GLuint timerQueries[2]{ 0, 0 };
+	bool timedStaticRedraw[2]{ false, false };
+	uint64_t frameIndex{ 0 };
+	double cachedGpuMs{ 0.0 };
+	double redrawGpuMs{ 0.0 };
+
 };
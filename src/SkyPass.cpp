@@ -1,5 +1,6 @@
 #include "SkyPass.h"
 
+#include "GLState.h"
 #include "ShaderSystem.h"
 #include "FullscreenQuad.h"
 
@@ -21,24 +22,24 @@ SkyPass::Draw(const LightBuffer& lightBuffer, const GBuffer& gBuffer, Scene& sce
 		glNamedFramebufferDrawBuffers(framebuffer, 3, drawBuffers);
 	}
 
-	glDisable(GL_BLEND);
-	glEnable(GL_DEPTH_TEST);
-	glDepthFunc(GL_EQUAL);
-	glDepthMask(GL_FALSE);
+	GLState::Disable(GL_BLEND);
+	GLState::Enable(GL_DEPTH_TEST);
+	GLState::DepthFunc(GL_EQUAL);
+	GLState::DepthMask(GL_FALSE);
 
 	// TODO: Maybe don't rebind all textures every frame?
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+	GLState::BindFramebuffer(framebuffer);
 	glNamedFramebufferTexture(framebuffer, PredefinedOutputLocation(o_color), lightBuffer.lightTexture, 0);
 	glNamedFramebufferTexture(framebuffer, PredefinedOutputLocation(o_g_buffer_norm_vel), gBuffer.normVelTexture, 0);
 	glNamedFramebufferTexture(framebuffer, GL_DEPTH_ATTACHMENT, gBuffer.depthTexture, 0);
-	glViewport(0, 0, lightBuffer.width, lightBuffer.height);
+	GLState::Viewport(0, 0, lightBuffer.renderWidth, lightBuffer.renderHeight);
 
-	glUseProgram(skyProgram);
-	glBindTextureUnit(0, scene.skyProbe.radiance);
+	GLState::UseProgram(skyProgram);
+	GLState::BindTextureUnit(0, scene.skyProbe.radiance);
 	FullscreenQuad::Draw();
 
-	glDepthFunc(GL_LEQUAL);
-	glDepthMask(GL_TRUE);
+	GLState::DepthFunc(GL_LEQUAL);
+	GLState::DepthMask(GL_TRUE);
 }
 
 void
@@ -2,10 +2,43 @@
 
 #include <imgui.h>
 
+#include "GLState.h"
 #include "PerformOnce.h"
 #include "ShaderSystem.h"
 
+#include "light_formats.h"
+
 void TemporalAAPass::Draw(const LightBuffer& lightBuffer, const GBuffer& gBuffer)
+{
+	GLuint inputTexture;
+	bool firstFrameForCurrentRun;
+	if (!AdvanceFrame(lightBuffer, &inputTexture, &firstFrameForCurrentRun))
+	{
+		return;
+	}
+
+	PerformOnce(
+		taaProgram = ShaderSystem::AddComputeProgram("post/temporal_aa.comp.glsl", this);
+	)
+
+	GLState::UseProgram(*taaProgram);
+	historyBlend.UpdateUniformIfNeeded(*taaProgram);
+
+	glBindImageTexture(1, lightBuffer.lightTexture, 0, GL_FALSE, 0, GL_READ_ONLY, LIGHT_BUFFER_INTERNAL_FORMAT);
+	glBindImageTexture(2, gBuffer.normVelTexture, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA16F);
+
+	GLState::BindTextureUnit(0, inputTexture);
+	glBindImageTexture(0, outputTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, TAA_HISTORY_INTERNAL_FORMAT);
+
+	glProgramUniform1i(*taaProgram, firstFrameLocation, firstFrameForCurrentRun);
+
+	int xGroups = int(ceil(lightBuffer.width / 32.0f));
+	int yGroups = int(ceil(lightBuffer.height / 32.0f));
+	glDispatchCompute(xGroups, yGroups, 1);
+	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+}
+
+bool TemporalAAPass::AdvanceFrame(const LightBuffer& lightBuffer, GLuint *historyTexture, bool *firstFrame)
 {
 	if (ImGui::CollapsingHeader("Temporal AA"))
 	{
@@ -20,52 +53,33 @@ void TemporalAAPass::Draw(const LightBuffer& lightBuffer, const GBuffer& gBuffer
 	{
 		// Just fully pass through
 		outputTexture = lightBuffer.lightTexture;
-		return;
+		return false;
 	}
 
-	PerformOnce(
-		taaProgram = ShaderSystem::AddComputeProgram("post/temporal_aa.comp.glsl", this);
-	)
-
-	glUseProgram(*taaProgram);
-	historyBlend.UpdateUniformIfNeeded(*taaProgram);
-
-	glBindImageTexture(1, lightBuffer.lightTexture, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
-	glBindImageTexture(2, gBuffer.normVelTexture, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA16F);
-
 	// Read/write from different history buffers depending on even/odd frames
 	static int evenOdd = 0;
 	evenOdd = (evenOdd + 1) % 2;
 
-	GLuint inputTexture;
 	if (evenOdd == 0)
 	{
-		inputTexture = lightBuffer.taaHistoryTextures[0];
+		*historyTexture = lightBuffer.taaHistoryTextures[0];
 		outputTexture = lightBuffer.taaHistoryTextures[1];
 	}
 	else
 	{
-		inputTexture = lightBuffer.taaHistoryTextures[1];
+		*historyTexture = lightBuffer.taaHistoryTextures[1];
 		outputTexture = lightBuffer.taaHistoryTextures[0];
 	}
 
-	glBindTextureUnit(0, inputTexture);
-	glBindImageTexture(0, outputTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
-
-	bool firstFrameForCurrentRun = ShouldSetFirstFrame(lightBuffer.width, lightBuffer.height, frameCount);
-	glProgramUniform1i(*taaProgram, firstFrameLocation, firstFrameForCurrentRun);
-
-	int xGroups = int(ceil(lightBuffer.width / 32.0f));
-	int yGroups = int(ceil(lightBuffer.height / 32.0f));
-	glDispatchCompute(xGroups, yGroups, 1);
-	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	*firstFrame = ShouldSetFirstFrame(lightBuffer.width, lightBuffer.height, frameCount);
+	return true;
 }
 
 void TemporalAAPass::ProgramLoaded(GLuint program)
 {
 	if (taaProgram && program == *taaProgram)
 	{
-		firstFrameLocation = glGetUniformLocation(*taaProgram, "u_first_frame");
+		firstFrameLocation = ShaderSystem::GetUniformLocation(*taaProgram, "u_first_frame");
 	}
 }
 
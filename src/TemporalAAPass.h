@@ -15,6 +15,11 @@ public:
 	void Draw(const LightBuffer& lightBuffer, const GBuffer& gBuffer);
 	void ProgramLoaded(GLuint program) override;
 
+	// Selects this frame's history textures without resolving, for when the resolve is done elsewhere (see FinalPass).
+	// The history is read from historyTexture and the resolved frame written to outputTexture. Returns false if
+	// TAA is disabled, in which case outputTexture is the light buffer.
+	bool AdvanceFrame(const LightBuffer& lightBuffer, GLuint *historyTexture, bool *firstFrame);
+
 	Uniform<float> historyBlend{ "u_history_blend", 0.05f };
 
 	bool enabled = true;
@@ -81,8 +81,6 @@ void TestApp::Init()
 		}
 	});
 
-	shadowMap.RecreateGpuResources(8192);
-
 	scene.skyProbe.radiance = TextureSystem::LoadHdrImage("assets/env/blue_lagoon/blue_lagoon_2k.hdr");
 
 	DirectionalLight sunLight;
@@ -4,9 +4,20 @@
 #include <stb_image.h>
 
 #include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
+#include <fstream>
 #include <filesystem>
+#include <unordered_set>
 #include <algorithm>
+#include <vector>
 
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include "GLState.h"
 #include "Logging.h"
 #include "Queue.h"
 
@@ -21,6 +32,9 @@ struct ImageLoadDescription
 	GLenum format, internalFormat;
 	bool requestMipmaps;
 	bool isHdr;
+
+	// If true, filename is a folder path of single-channel images which are loaded into layers of a texture array
+	bool isImageArray = false;
 };
 
 struct LoadedImage
@@ -28,13 +42,104 @@ struct LoadedImage
 	void* pixels;
 	GLenum type;
 	int width, height;
+	int layers = 1;
+
+	// Mip levels 1 and down, only generated for images that can be streamed (RGBA8 data)
+	std::vector<void *> mipChain{};
+};
+
+struct StreamedTexture
+{
+	ImageLoadDescription dsc;
+	int size;
+	int numLevels;
+
+	// The texture that is actually sampled (through its handle). It only contains the levels from residentLevel and down.
+	GLuint physicalTexture = 0;
+	GLuint64 handle = 0;
+
+	int residentLevel;
+	int requestedLevel;
+	uint64_t lastRequestFrame = 0;
 };
 
+struct AtlasShelf
+{
+	int y, height;
+	int usedWidth;
+};
+
+struct TextureAtlas
+{
+	GLenum internalFormat;
+	GLuint texture = 0;
+	GLuint64 handle = 0;
+	int numLayers = 0;
+
+	// Shelf packing state, per layer
+	std::vector<std::vector<AtlasShelf>> shelves{};
+	bool mipmapsDirty = false;
+};
+
+struct AtlasEntry
+{
+	TextureAtlas *atlas;
+	TextureSystem::AtlasRegion region;
+};
+
+std::string
+ImageCacheKey(const ImageLoadDescription& dsc)
+{
+	// HDR images are converted to their storage format on the loader thread, so the same file can have more than one representation
+	if (dsc.isHdr) return dsc.filename + "#" + std::to_string(dsc.internalFormat);
+	else return dsc.filename;
+}
+
 //
 // Data
 //
 
 static std::unordered_map<std::string, LoadedImage> loadedImages{};
+
+// Textures that are waiting for their image data (only accessed from the main thread)
+static std::unordered_set<GLuint> texturesBeingLoaded{};
+static std::unordered_map<GLuint, GLuint64> residentHandles{};
+
+// Textures that are streamed, keyed by their public texture name (which itself only ever contains a placeholder)
+static std::unordered_map<GLuint, StreamedTexture> streamedTextures{};
+static std::atomic<size_t> streamingBudget{ 0 };
+static uint64_t streamingFrame = 0;
+static int streamingUploadsLastFrame = 0;
+
+// Small textures packed into shared array textures, one atlas per internal format. The map keys are public texture names.
+static std::unordered_map<GLenum, TextureAtlas> textureAtlases{};
+static std::unordered_map<GLuint, AtlasEntry> atlasEntries{};
+static std::atomic<int> atlasMaxTextureSize{ 0 };
+
+// Every entry is surrounded by (wrapped) padding and aligned so that the padding survives down to the last atlas mip level
+#define ATLAS_SIZE 1024
+#define ATLAS_PADDING 8
+#define ATLAS_ALIGNMENT 16
+#define ATLAS_NUM_LEVELS 4
+
+// Textures are initially made resident with only the levels at or below this size, until feedback requests more
+#define STREAMING_INITIAL_MAX_SIZE 64
+#define STREAMING_MAX_UPLOADS_PER_FRAME 4
+#define STREAMING_REQUEST_TIMEOUT_FRAMES 120
+
+// Replaced bindless handles can still be used by frames in flight (through the material buffer), so their release is
+// deferred by this many frames (i.e. calls to Update)
+#define HANDLE_RELEASE_DELAY_FRAMES 3
+
+struct DeferredHandleRelease
+{
+	GLuint texture;
+	GLuint64 handle;
+	uint64_t releaseFrame;
+};
+
+static std::vector<DeferredHandleRelease> deferredHandleReleases{};
+static uint64_t updateFrame = 0;
 static Queue<ImageLoadDescription> pendingJobs{};
 static Queue<ImageLoadDescription> finishedJobs{};
 
@@ -120,6 +225,640 @@ CreateImmutableTextureFromImage(const ImageLoadDescription& dsc, const LoadedIma
 	}
 }
 
+void
+CreateTextureArrayFromImage(const ImageLoadDescription& dsc, const LoadedImage& image)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	glTextureStorage3D(dsc.texture, 1, dsc.internalFormat, image.width, image.height, image.layers);
+	glTextureSubImage3D(dsc.texture, 0, 0, 0, 0, image.width, image.height, image.layers, dsc.format, image.type, image.pixels);
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - startTime;
+	Log("Texture array '%s': uploaded %d layers in %.2f ms\n", dsc.filename.c_str(), image.layers, elapsed.count());
+}
+
+bool
+IsStreamableImage(const ImageLoadDescription& dsc, int width, int height)
+{
+	bool powerOfTwoSize = (width & (width - 1)) == 0;
+	bool largerThanAtlased = width > atlasMaxTextureSize || height > atlasMaxTextureSize;
+	return streamingBudget > 0 && !dsc.isHdr && dsc.requestMipmaps && width == height && powerOfTwoSize && width > 1 && largerThanAtlased;
+}
+
+void
+GenerateMipChain(LoadedImage& image)
+{
+	// A simple 2x2 box filter. Note that this is performed in sRGB space for color textures, which isn't entirely correct
+	// but it's close enough for this purpose.
+	const uint8_t *source = static_cast<const uint8_t *>(image.pixels);
+	int sourceSize = image.width;
+
+	while (sourceSize > 1)
+	{
+		int size = sourceSize / 2;
+		uint8_t *mip = static_cast<uint8_t *>(malloc(size_t(size) * size * 4));
+
+		for (int y = 0; y < size; ++y)
+		{
+			for (int x = 0; x < size; ++x)
+			{
+				for (int c = 0; c < 4; ++c)
+				{
+					int sum = source[4 * ((2 * y + 0) * sourceSize + (2 * x + 0)) + c]
+					        + source[4 * ((2 * y + 0) * sourceSize + (2 * x + 1)) + c]
+					        + source[4 * ((2 * y + 1) * sourceSize + (2 * x + 0)) + c]
+					        + source[4 * ((2 * y + 1) * sourceSize + (2 * x + 1)) + c];
+					mip[4 * (y * size + x) + c] = uint8_t((sum + 2) / 4);
+				}
+			}
+		}
+
+		image.mipChain.push_back(mip);
+		source = mip;
+		sourceSize = size;
+	}
+}
+
+size_t
+StreamedTextureSize(const StreamedTexture& texture, int fromLevel)
+{
+	size_t bytes = 0;
+	for (int level = fromLevel; level < texture.numLevels; ++level)
+	{
+		size_t levelSize = size_t(texture.size >> level);
+		bytes += levelSize * levelSize * TextureSystem::BytesPerTexel(texture.dsc.internalFormat);
+	}
+	return bytes;
+}
+
+int
+InitialStreamingLevel(const StreamedTexture& texture)
+{
+	int level = 0;
+	while ((texture.size >> level) > STREAMING_INITIAL_MAX_SIZE)
+	{
+		level += 1;
+	}
+	return level;
+}
+
+void
+DeferHandleRelease(GLuint texture, GLuint64 handle)
+{
+	deferredHandleReleases.push_back({ texture, handle, updateFrame + HANDLE_RELEASE_DELAY_FRAMES });
+}
+
+// Releases the handles that are due, or all of them (e.g. on shutdown)
+void
+ReleaseDeferredHandles(bool releaseAll = false)
+{
+	auto isDue = [releaseAll](const DeferredHandleRelease& release) { return releaseAll || release.releaseFrame <= updateFrame; };
+	for (DeferredHandleRelease& release : deferredHandleReleases)
+	{
+		if (isDue(release))
+		{
+			glMakeTextureHandleNonResidentARB(release.handle);
+			GLState::DeleteTextures(1, &release.texture);
+		}
+	}
+
+	deferredHandleReleases.erase(std::remove_if(deferredHandleReleases.begin(), deferredHandleReleases.end(), isDue), deferredHandleReleases.end());
+}
+
+void
+MakeLevelsResident(StreamedTexture& streamed, int level)
+{
+	const LoadedImage& image = loadedImages[streamed.dsc.filename];
+
+	int levelSize = streamed.size >> level;
+	int numLevels = streamed.numLevels - level;
+
+	// The storage of the physical texture is immutable, so a new one is created with only the requested levels
+	GLuint texture = CreateEmptyTextureObject();
+	glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameterf(texture, GL_TEXTURE_LOD_BIAS, -1.0f);
+	glTextureStorage2D(texture, numLevels, streamed.dsc.internalFormat, levelSize, levelSize);
+
+	for (int i = 0; i < numLevels; ++i)
+	{
+		int sourceLevel = level + i;
+		const void *pixels = (sourceLevel == 0) ? image.pixels : image.mipChain[sourceLevel - 1];
+		glTextureSubImage2D(texture, i, 0, 0, levelSize >> i, levelSize >> i, streamed.dsc.format, GL_UNSIGNED_BYTE, pixels);
+	}
+
+	GLuint64 handle = glGetTextureHandleARB(texture);
+	glMakeTextureHandleResidentARB(handle);
+
+	if (streamed.physicalTexture)
+	{
+		DeferHandleRelease(streamed.physicalTexture, streamed.handle);
+	}
+
+	streamed.physicalTexture = texture;
+	streamed.handle = handle;
+	streamed.residentLevel = level;
+}
+
+int
+AlignUp(int value, int alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+bool
+IsAtlasableImage(const ImageLoadDescription& dsc, int width, int height)
+{
+	bool supportedFormat = dsc.internalFormat == GL_RGBA8 || dsc.internalFormat == GL_SRGB8_ALPHA8;
+	return !dsc.isHdr && !dsc.isImageArray && supportedFormat && width <= atlasMaxTextureSize && height <= atlasMaxTextureSize;
+}
+
+void
+GrowTextureAtlas(TextureAtlas& atlas)
+{
+	int numLayers = std::max(1, 2 * atlas.numLayers);
+
+	GLuint texture;
+	glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &texture);
+	glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(texture, GL_TEXTURE_MAX_LEVEL, ATLAS_NUM_LEVELS - 1);
+
+	// Limit the anisotropic footprint so that it (mostly) stays within the padding
+	glTextureParameterf(texture, GL_TEXTURE_MAX_ANISOTROPY, 4.0f);
+
+	glTextureStorage3D(texture, ATLAS_NUM_LEVELS, atlas.internalFormat, ATLAS_SIZE, ATLAS_SIZE, numLayers);
+
+	if (atlas.texture)
+	{
+		for (int level = 0; level < ATLAS_NUM_LEVELS; ++level)
+		{
+			int levelSize = ATLAS_SIZE >> level;
+			glCopyImageSubData(atlas.texture, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0,
+			                   texture, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0,
+			                   levelSize, levelSize, atlas.numLayers);
+		}
+
+		DeferHandleRelease(atlas.texture, atlas.handle);
+	}
+
+	atlas.texture = texture;
+	atlas.handle = glGetTextureHandleARB(texture);
+	glMakeTextureHandleResidentARB(atlas.handle);
+
+	atlas.numLayers = numLayers;
+	atlas.shelves.resize(numLayers);
+}
+
+bool
+AllocateAtlasRect(TextureAtlas& atlas, int width, int height, int& outX, int& outY, int& outLayer)
+{
+	for (int layer = 0; layer < atlas.numLayers; ++layer)
+	{
+		std::vector<AtlasShelf>& shelves = atlas.shelves[layer];
+
+		// First fit in an existing shelf that isn't excessively tall
+		for (AtlasShelf& shelf : shelves)
+		{
+			if (shelf.height >= height && shelf.height <= 2 * height && shelf.usedWidth + width <= ATLAS_SIZE)
+			{
+				outX = shelf.usedWidth;
+				outY = shelf.y;
+				outLayer = layer;
+				shelf.usedWidth += width;
+				return true;
+			}
+		}
+
+		int shelfY = shelves.empty() ? 0 : shelves.back().y + shelves.back().height;
+		if (shelfY + height <= ATLAS_SIZE)
+		{
+			shelves.push_back({ shelfY, height, width });
+			outX = 0;
+			outY = shelfY;
+			outLayer = layer;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void
+AddTextureToAtlas(const ImageLoadDescription& dsc, const LoadedImage& image)
+{
+	TextureAtlas& atlas = textureAtlases[dsc.internalFormat];
+	atlas.internalFormat = dsc.internalFormat;
+
+	int paddedWidth = AlignUp(image.width + 2 * ATLAS_PADDING, ATLAS_ALIGNMENT);
+	int paddedHeight = AlignUp(image.height + 2 * ATLAS_PADDING, ATLAS_ALIGNMENT);
+
+	int x, y, layer;
+	while (!AllocateAtlasRect(atlas, paddedWidth, paddedHeight, x, y, layer))
+	{
+		GrowTextureAtlas(atlas);
+	}
+
+	// Build the padded image, where the padding is wrapped from the opposite side so that the (manual) repeat addressing
+	// filters correctly across the edges
+	std::vector<uint32_t> padded(size_t(paddedWidth) * paddedHeight);
+	const uint32_t *source = static_cast<const uint32_t *>(image.pixels);
+	for (int py = 0; py < paddedHeight; ++py)
+	{
+		int sy = ((py - ATLAS_PADDING) % image.height + image.height) % image.height;
+		for (int px = 0; px < paddedWidth; ++px)
+		{
+			int sx = ((px - ATLAS_PADDING) % image.width + image.width) % image.width;
+			padded[py * paddedWidth + px] = source[sy * image.width + sx];
+		}
+	}
+
+	glTextureSubImage3D(atlas.texture, 0, x, y, layer, paddedWidth, paddedHeight, 1, GL_RGBA, GL_UNSIGNED_BYTE, padded.data());
+	atlas.mipmapsDirty = true;
+
+	AtlasEntry entry;
+	entry.atlas = &atlas;
+	entry.region.offset[0] = float(x + ATLAS_PADDING) / ATLAS_SIZE;
+	entry.region.offset[1] = float(y + ATLAS_PADDING) / ATLAS_SIZE;
+	entry.region.scale[0] = float(image.width) / ATLAS_SIZE;
+	entry.region.scale[1] = float(image.height) / ATLAS_SIZE;
+	entry.region.layer = layer;
+	atlasEntries[dsc.texture] = entry;
+}
+
+void
+CreateTextureFromImage(const ImageLoadDescription& dsc, const LoadedImage& image)
+{
+	if (IsAtlasableImage(dsc, image.width, image.height))
+	{
+		AddTextureToAtlas(dsc, image);
+		return;
+	}
+
+	if (dsc.isImageArray)
+	{
+		CreateTextureArrayFromImage(dsc, image);
+		return;
+	}
+
+	if (!IsStreamableImage(dsc, image.width, image.height) || image.mipChain.empty())
+	{
+		CreateImmutableTextureFromImage(dsc, image);
+		return;
+	}
+
+	StreamedTexture streamed;
+	streamed.dsc = dsc;
+	streamed.size = image.width;
+	streamed.numLevels = 1 + int(std::log2(image.width));
+	streamed.requestedLevel = InitialStreamingLevel(streamed);
+
+	MakeLevelsResident(streamed, streamed.requestedLevel);
+	streamedTextures[dsc.texture] = streamed;
+}
+
+void
+UpdateStreamedTextures()
+{
+	if (streamedTextures.empty())
+	{
+		return;
+	}
+
+	streamingFrame += 1;
+
+	struct Candidate
+	{
+		StreamedTexture *texture;
+		int targetLevel;
+	};
+
+	std::vector<Candidate> candidates{};
+	candidates.reserve(streamedTextures.size());
+
+	size_t totalSize = 0;
+	for (auto& pair : streamedTextures)
+	{
+		StreamedTexture& streamed = pair.second;
+
+		// If a texture hasn't been requested for a while it's probably not visible, so drop it back to its initial levels
+		bool recentlyRequested = streamingFrame - streamed.lastRequestFrame < STREAMING_REQUEST_TIMEOUT_FRAMES;
+		int targetLevel = recentlyRequested ? streamed.requestedLevel : InitialStreamingLevel(streamed);
+
+		candidates.push_back({ &streamed, targetLevel });
+		totalSize += StreamedTextureSize(streamed, targetLevel);
+	}
+
+	// Evict levels of the least recently requested textures until we are within the budget
+	std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b)
+	{
+		return a.texture->lastRequestFrame < b.texture->lastRequestFrame;
+	});
+
+	bool anyEvicted = true;
+	while (totalSize > streamingBudget && anyEvicted)
+	{
+		anyEvicted = false;
+		for (Candidate& candidate : candidates)
+		{
+			if (totalSize <= streamingBudget) break;
+			if (candidate.targetLevel >= candidate.texture->numLevels - 1) continue;
+
+			totalSize -= StreamedTextureSize(*candidate.texture, candidate.targetLevel);
+			candidate.targetLevel += 1;
+			totalSize += StreamedTextureSize(*candidate.texture, candidate.targetLevel);
+			anyEvicted = true;
+		}
+	}
+
+	// Evictions are always applied (they only free memory), while uploads of finer levels are limited per frame
+	streamingUploadsLastFrame = 0;
+	for (Candidate& candidate : candidates)
+	{
+		StreamedTexture& streamed = *candidate.texture;
+		if (candidate.targetLevel > streamed.residentLevel)
+		{
+			MakeLevelsResident(streamed, candidate.targetLevel);
+		}
+	}
+	for (auto it = candidates.rbegin(); it != candidates.rend(); ++it)
+	{
+		StreamedTexture& streamed = *it->texture;
+		if (it->targetLevel < streamed.residentLevel && streamingUploadsLastFrame < STREAMING_MAX_UPLOADS_PER_FRAME)
+		{
+			MakeLevelsResident(streamed, it->targetLevel);
+			streamingUploadsLastFrame += 1;
+		}
+	}
+}
+
+GLenum
+PixelTypeForHdrFormat(GLenum internalFormat)
+{
+	switch (internalFormat)
+	{
+	case GL_RGBA16F:        return GL_HALF_FLOAT;
+	case GL_R11F_G11F_B10F: return GL_UNSIGNED_INT_10F_11F_11F_REV;
+	case GL_RGB9_E5:        return GL_UNSIGNED_INT_5_9_9_9_REV;
+	default:                return GL_FLOAT;
+	}
+}
+
+void
+ConvertHdrImage(LoadedImage& image, GLenum internalFormat, const std::string& filename)
+{
+	// Converts the RGB32F pixels from stb_image into the compact storage format, in place of the original data. This
+	// should be called from the loader thread so that the main thread only has to upload the (smaller) packed data.
+
+	GLenum type = PixelTypeForHdrFormat(internalFormat);
+	if (type == GL_FLOAT)
+	{
+		return;
+	}
+
+	const float *source = static_cast<const float *>(image.pixels);
+	size_t pixelCount = size_t(image.width) * size_t(image.height);
+
+	size_t bytesPerPixel = (type == GL_HALF_FLOAT) ? 4 * sizeof(uint16_t) : sizeof(uint32_t);
+	void *converted = malloc(pixelCount * bytesPerPixel);
+
+	// Keep track of the error compared to the 32-bit source, so it's easy to tell if some format doesn't cut it for an image
+	double sumSquaredError = 0.0;
+	float maxRelativeError = 0.0f;
+
+	for (size_t i = 0; i < pixelCount; ++i)
+	{
+		glm::vec3 color = glm::max(glm::vec3(source[3 * i + 0], source[3 * i + 1], source[3 * i + 2]), glm::vec3(0.0f));
+		glm::vec3 decoded;
+
+		switch (type)
+		{
+		case GL_HALF_FLOAT:
+		{
+			uint16_t *dst = static_cast<uint16_t *>(converted) + 4 * i;
+			dst[0] = glm::packHalf1x16(color.r);
+			dst[1] = glm::packHalf1x16(color.g);
+			dst[2] = glm::packHalf1x16(color.b);
+			dst[3] = glm::packHalf1x16(1.0f);
+			decoded = glm::vec3(glm::unpackHalf1x16(dst[0]), glm::unpackHalf1x16(dst[1]), glm::unpackHalf1x16(dst[2]));
+			break;
+		}
+		case GL_UNSIGNED_INT_10F_11F_11F_REV:
+		{
+			uint32_t packed = glm::packF2x11_1x10(color);
+			static_cast<uint32_t *>(converted)[i] = packed;
+			decoded = glm::unpackF2x11_1x10(packed);
+			break;
+		}
+		case GL_UNSIGNED_INT_5_9_9_9_REV:
+		{
+			uint32_t packed = glm::packF3x9_E1x5(color);
+			static_cast<uint32_t *>(converted)[i] = packed;
+			decoded = glm::unpackF3x9_E1x5(packed);
+			break;
+		}
+		}
+
+		glm::vec3 error = glm::abs(decoded - color);
+		sumSquaredError += double(glm::dot(error, error));
+
+		float luminance = glm::dot(color, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+		float luminanceError = glm::dot(error, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+		maxRelativeError = std::max(maxRelativeError, luminanceError / std::max(luminance, 1.0e-4f));
+	}
+
+	float rmse = float(std::sqrt(sumSquaredError / double(3 * pixelCount)));
+	Log("Converted HDR image '%s' to compact format: %.1f MB -> %.1f MB, RMSE %.6f, max relative luminance error %.4f\n",
+		filename.c_str(), (pixelCount * 3 * sizeof(float)) / (1024.0f * 1024.0f), (pixelCount * bytesPerPixel) / (1024.0f * 1024.0f),
+		rmse, maxRelativeError);
+
+	stbi_image_free(image.pixels);
+	image.pixels = converted;
+	image.type = type;
+}
+
+struct ImageArrayCacheHeader
+{
+	uint32_t magic;
+	int32_t size;
+	int32_t layers;
+	int64_t sourceTimestamp;
+};
+
+#define IMAGE_ARRAY_CACHE_MAGIC 0x59524141 // "AARY"
+
+std::string
+ImageArrayCachePath(const std::string& folderPath)
+{
+	// Placed next to (not inside) the image folder, e.g. "assets/blue_noise/64.array.bin"
+	std::string path = folderPath;
+	while (!path.empty() && (path.back() == '/' || path.back() == '\\'))
+	{
+		path.pop_back();
+	}
+	return path + ".array.bin";
+}
+
+bool
+ReadImageArrayCache(const std::string& cachePath, int64_t sourceTimestamp, int numImages, LoadedImage& image)
+{
+	std::ifstream file(cachePath, std::ios::binary);
+	if (!file.is_open())
+	{
+		return false;
+	}
+
+	ImageArrayCacheHeader header;
+	file.read(reinterpret_cast<char *>(&header), sizeof(header));
+	if (!file || header.magic != IMAGE_ARRAY_CACHE_MAGIC || header.sourceTimestamp != sourceTimestamp || header.layers != numImages)
+	{
+		return false;
+	}
+
+	size_t dataSize = size_t(header.size) * header.size * header.layers;
+	uint8_t *pixels = static_cast<uint8_t *>(malloc(dataSize));
+	file.read(reinterpret_cast<char *>(pixels), dataSize);
+	if (!file)
+	{
+		free(pixels);
+		return false;
+	}
+
+	image.pixels = pixels;
+	image.width = image.height = header.size;
+	image.layers = header.layers;
+	return true;
+}
+
+void
+WriteImageArrayCache(const std::string& cachePath, int64_t sourceTimestamp, const LoadedImage& image)
+{
+	std::ofstream file(cachePath, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		Log("Could not write texture array cache '%s'\n", cachePath.c_str());
+		return;
+	}
+
+	ImageArrayCacheHeader header;
+	header.magic = IMAGE_ARRAY_CACHE_MAGIC;
+	header.size = image.width;
+	header.layers = image.layers;
+	header.sourceTimestamp = sourceTimestamp;
+
+	file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+	file.write(static_cast<const char *>(image.pixels), size_t(image.width) * image.height * image.layers);
+}
+
+bool
+LoadImageArray(const std::string& folderPath, LoadedImage& image)
+{
+	namespace fs = std::filesystem;
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	// Collect the images, where the layer index is given by the number after the last '_' in the file name
+	std::vector<std::string> layerFiles{};
+	int64_t sourceTimestamp = 0;
+	for (const auto& entry : fs::directory_iterator(folderPath))
+	{
+		if (!entry.is_regular_file() || entry.path().extension() != ".png") continue;
+
+		auto filename = entry.path().stem().u8string();
+		size_t subIdx = filename.rfind('_');
+		if (subIdx == std::string::npos)
+		{
+			Log("Texture array image '%s' has no sequence index, ignoring it\n", filename.c_str());
+			continue;
+		}
+
+		size_t layer = size_t(atoi(filename.substr(subIdx + 1).c_str()));
+		if (layer >= layerFiles.size()) layerFiles.resize(layer + 1);
+		layerFiles[layer] = entry.path().u8string();
+
+		sourceTimestamp = std::max(sourceTimestamp, int64_t(entry.last_write_time().time_since_epoch().count()));
+	}
+
+	int numImages = int(layerFiles.size());
+	if (numImages == 0 || std::find(layerFiles.begin(), layerFiles.end(), "") != layerFiles.end())
+	{
+		Log("Texture array folder '%s' is empty or has gaps in its image sequence\n", folderPath.c_str());
+		return false;
+	}
+
+	std::string cachePath = ImageArrayCachePath(folderPath);
+	if (ReadImageArrayCache(cachePath, sourceTimestamp, numImages, image))
+	{
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - startTime;
+		Log("Texture array '%s': read %d layers from cache in %.2f ms\n", folderPath.c_str(), numImages, elapsed.count());
+		return true;
+	}
+
+	int size, height;
+	if (!stbi_info(layerFiles[0].c_str(), &size, &height, nullptr) || size != height)
+	{
+		Log("Texture array images must be square, which '%s' is not\n", layerFiles[0].c_str());
+		return false;
+	}
+
+	// Decode all images in parallel, directly into their layer in a single staging allocation
+	size_t layerSize = size_t(size) * size;
+	uint8_t *staging = static_cast<uint8_t *>(malloc(layerSize * numImages));
+
+	std::atomic<int> nextLayer{ 0 };
+	std::atomic<bool> failed{ false };
+
+	auto decodeWorker = [&]()
+	{
+		int layer;
+		while ((layer = nextLayer++) < numImages && !failed)
+		{
+			const char *filepath = layerFiles[layer].c_str();
+			int w, h;
+			stbi_uc *pixels = stbi_load(filepath, &w, &h, nullptr, STBI_grey);
+			if (!pixels || w != size || h != size)
+			{
+				Log("Could not load texture array image '%s' (all images must be of the same size)\n", filepath);
+				stbi_image_free(pixels);
+				failed = true;
+				return;
+			}
+
+			memcpy(staging + layer * layerSize, pixels, layerSize);
+			stbi_image_free(pixels);
+		}
+	};
+
+	int numWorkers = std::max(1, std::min(int(std::thread::hardware_concurrency()), numImages));
+	std::vector<std::thread> workers{};
+	for (int i = 0; i < numWorkers; ++i)
+	{
+		workers.emplace_back(decodeWorker);
+	}
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+
+	if (failed)
+	{
+		free(staging);
+		return false;
+	}
+
+	image.pixels = staging;
+	image.width = image.height = size;
+	image.layers = numImages;
+
+	WriteImageArrayCache(cachePath, sourceTimestamp, image);
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - startTime;
+	Log("Texture array '%s': decoded %d layers on %d threads in %.2f ms\n", folderPath.c_str(), numImages, numWorkers, elapsed.count());
+
+	return true;
+}
+
 //
 // Public API
 //
@@ -159,14 +898,23 @@ TextureSystem::Init()
 			// NOTE: If we add more threads for image loading, this check needs to be more rigorous!
 			// We should never load an image if it's already loaded, but this can happen if we quickly
 			// call some LoadImage function a second time before the first image has finished loading.
-			if (loadedImages.find(filename) != loadedImages.end())
+			if (loadedImages.find(ImageCacheKey(currentJob)) != loadedImages.end())
 			{
 				std::lock_guard<std::mutex> lock(accessMutex);
 				finishedJobs.Push(currentJob);
 				continue;
 			}
 
-			if (currentJob.isHdr)
+			if (currentJob.isImageArray)
+			{
+				if (!LoadImageArray(currentJob.filename, image))
+				{
+					currentJobsCounter -= 1;
+					continue;
+				}
+				image.type = GL_UNSIGNED_BYTE;
+			}
+			else if (currentJob.isHdr)
 			{
 				image.pixels = stbi_loadf(filename, &image.width, &image.height, nullptr, STBI_rgb);
 				if (!image.pixels)
@@ -176,6 +924,8 @@ TextureSystem::Init()
 					continue;
 				}
 				image.type = GL_FLOAT;
+
+				ConvertHdrImage(image, currentJob.internalFormat, currentJob.filename);
 			}
 			else
 			{
@@ -187,9 +937,14 @@ TextureSystem::Init()
 					continue;
 				}
 				image.type = GL_UNSIGNED_BYTE;
+
+				if (IsStreamableImage(currentJob, image.width, image.height))
+				{
+					GenerateMipChain(image);
+				}
 			}
 
-			loadedImages[filename] = image;
+			loadedImages[ImageCacheKey(currentJob)] = image;
 
 			std::lock_guard<std::mutex> lock(accessMutex);
 			finishedJobs.Push(currentJob);
@@ -205,10 +960,17 @@ TextureSystem::Destroy()
 	runCondition.notify_all();
 	backgroundThread.join();
 
+	// Replaced handles aren't in use anymore at this point
+	ReleaseDeferredHandles(true);
+
 	// Release all loaded images (but NOT textures!)
 	for (auto& nameImagePair : loadedImages)
 	{
 		stbi_image_free(nameImagePair.second.pixels);
+		for (void *mip : nameImagePair.second.mipChain)
+		{
+			free(mip);
+		}
 	}
 }
 
@@ -220,10 +982,26 @@ TextureSystem::Update()
 	while (!finishedJobs.IsEmpty())
 	{
 		ImageLoadDescription job = finishedJobs.Pop();
-		const LoadedImage& image = loadedImages[job.filename];
-		CreateImmutableTextureFromImage(job, image);
+		const LoadedImage& image = loadedImages[ImageCacheKey(job)];
+		CreateTextureFromImage(job, image);
+		texturesBeingLoaded.erase(job.texture);
 		currentJobsCounter -= 1;
 	}
+
+	for (auto& pair : textureAtlases)
+	{
+		TextureAtlas& atlas = pair.second;
+		if (atlas.mipmapsDirty)
+		{
+			glGenerateTextureMipmap(atlas.texture);
+			atlas.mipmapsDirty = false;
+		}
+	}
+
+	UpdateStreamedTextures();
+
+	updateFrame += 1;
+	ReleaseDeferredHandles();
 }
 
 bool
@@ -250,6 +1028,146 @@ TextureSystem::CreatePlaceholder(uint8_t r, uint8_t g, uint8_t b, uint8_t a)
 	return texture;
 }
 
+GLuint64
+TextureSystem::GetResidentHandle(GLuint texture)
+{
+	auto streamed = streamedTextures.find(texture);
+	if (streamed != streamedTextures.end())
+	{
+		return streamed->second.handle;
+	}
+
+	auto atlasEntry = atlasEntries.find(texture);
+	if (atlasEntry != atlasEntries.end())
+	{
+		return atlasEntry->second.atlas->handle;
+	}
+
+	// Taking a handle makes the texture state immutable, so wait until the real image data is in place
+	if (texture == 0 || texturesBeingLoaded.find(texture) != texturesBeingLoaded.end())
+	{
+		return 0;
+	}
+
+	auto it = residentHandles.find(texture);
+	if (it != residentHandles.end())
+	{
+		return it->second;
+	}
+
+	GLuint64 handle = glGetTextureHandleARB(texture);
+	glMakeTextureHandleResidentARB(handle);
+	residentHandles[texture] = handle;
+
+	return handle;
+}
+
+bool
+TextureSystem::GetAtlasRegion(GLuint texture, AtlasRegion& region)
+{
+	auto it = atlasEntries.find(texture);
+	if (it == atlasEntries.end())
+	{
+		return false;
+	}
+
+	region = it->second.region;
+	return true;
+}
+
+void
+TextureSystem::SetAtlasMaxTextureSize(int size)
+{
+	atlasMaxTextureSize = std::min(size, ATLAS_SIZE - 2 * ATLAS_PADDING);
+}
+
+int
+TextureSystem::GetAtlasTextureCount()
+{
+	return int(atlasEntries.size());
+}
+
+void
+TextureSystem::SetStreamingBudget(size_t bytes)
+{
+	streamingBudget = bytes;
+}
+
+void
+TextureSystem::RequestStreamingResolution(GLuint texture, int log2Resolution)
+{
+	auto it = streamedTextures.find(texture);
+	if (it == streamedTextures.end())
+	{
+		return;
+	}
+
+	StreamedTexture& streamed = it->second;
+
+	// (one level finer than the resolution implies, since we also use a -1 mip bias for these textures)
+	int level = (streamed.numLevels - 1) - log2Resolution - 1;
+	level = std::max(0, std::min(level, streamed.numLevels - 1));
+
+	// Several materials can request the same texture in the same frame, in which case the finest request wins
+	if (streamed.lastRequestFrame == streamingFrame)
+	{
+		streamed.requestedLevel = std::min(streamed.requestedLevel, level);
+	}
+	else
+	{
+		streamed.requestedLevel = level;
+		streamed.lastRequestFrame = streamingFrame;
+	}
+}
+
+TextureSystem::StreamingStats
+TextureSystem::GetStreamingStats()
+{
+	StreamingStats stats{};
+	stats.budget = streamingBudget;
+	stats.streamedTextureCount = int(streamedTextures.size());
+	stats.uploadsLastFrame = streamingUploadsLastFrame;
+
+	for (auto& pair : streamedTextures)
+	{
+		stats.residentBytes += StreamedTextureSize(pair.second, pair.second.residentLevel);
+		stats.fullResolutionBytes += StreamedTextureSize(pair.second, 0);
+	}
+
+	return stats;
+}
+
+int
+TextureSystem::BytesPerTexel(GLenum internalFormat)
+{
+	switch (internalFormat)
+	{
+	case GL_R8:
+		return 1;
+	case GL_R16F:
+	case GL_RG8:
+	case GL_DEPTH_COMPONENT16:
+		return 2;
+	case GL_R32F:
+	case GL_RG16F:
+	case GL_RGBA8:
+	case GL_SRGB8_ALPHA8:
+	case GL_R11F_G11F_B10F:
+	case GL_RGB9_E5:
+	case GL_DEPTH_COMPONENT32F:
+		return 4;
+	case GL_RGBA16F:
+		return 8;
+	case GL_RGB32F:
+		return 12;
+	case GL_RGBA32F:
+		return 16;
+	default:
+		Log("BytesPerTexel: unknown internal format 0x%04x\n", internalFormat);
+		return 0;
+	}
+}
+
 GLuint
 TextureSystem::CreateTexture(int width, int height, GLenum format, GLenum minFilter, GLenum magFilter, bool useMips)
 {
@@ -292,7 +1210,7 @@ TextureSystem::LoadLdrImage(const std::string& filename)
 	{
 		// The file is already loaded into memory, just fill in the GPU texture data
 		const LoadedImage& image = loadedImages[filename];
-		CreateImmutableTextureFromImage(dsc, image);
+		CreateTextureFromImage(dsc, image);
 	}
 	else
 	{
@@ -302,6 +1220,7 @@ TextureSystem::LoadLdrImage(const std::string& filename)
 		static uint8_t placeholderImageData[4] = { 200, 200, 200, 255 };
 		CreateMutableTextureFromPixel(dsc.texture, placeholderImageData);
 
+		texturesBeingLoaded.insert(dsc.texture);
 		pendingJobs.Push(dsc);
 		runCondition.notify_all();
 	}
@@ -310,24 +1229,33 @@ TextureSystem::LoadLdrImage(const std::string& filename)
 }
 
 GLuint
-TextureSystem::LoadHdrImage(const std::string& filename)
+TextureSystem::LoadHdrImage(const std::string& filename, GLenum internalFormat)
 {
 	if (!IsHdrFile(filename))
 	{
 		Log("Texture file '%s' is an LDR image and must be loaded as such\n", filename.c_str());
 	}
 
+	if (internalFormat != GL_RGB32F && internalFormat != GL_RGBA16F && internalFormat != GL_R11F_G11F_B10F && internalFormat != GL_RGB9_E5)
+	{
+		Log("Unsupported HDR storage format 0x%04x for '%s', falling back to GL_RGB32F\n", internalFormat, filename.c_str());
+		internalFormat = GL_RGB32F;
+	}
+
 	ImageLoadDescription dsc;
 	dsc.filename = filename;
 	dsc.texture = CreateEmptyTextureObject();
-	dsc.format = GL_RGB;
-	dsc.internalFormat = GL_RGB32F; // TODO: alpha? 16b?
-	dsc.requestMipmaps = true;
+	dsc.format = (internalFormat == GL_RGBA16F) ? GL_RGBA : GL_RGB;
+	dsc.internalFormat = internalFormat;
 	dsc.isHdr = true;
 
-	if (loadedImages.find(filename) != loadedImages.end())
+	// RGB9E5 isn't color-renderable, so the driver can't generate mipmaps for it
+	dsc.requestMipmaps = internalFormat != GL_RGB9_E5;
+
+	std::string cacheKey = ImageCacheKey(dsc);
+	if (loadedImages.find(cacheKey) != loadedImages.end())
 	{
-		const LoadedImage& image = loadedImages[filename];
+		const LoadedImage& image = loadedImages[cacheKey];
 		CreateImmutableTextureFromImage(dsc, image);
 	}
 	else
@@ -337,6 +1265,7 @@ TextureSystem::LoadHdrImage(const std::string& filename)
 		static uint8_t placeholderImageData[4] = { 128, 128, 128, 255 };
 		CreateMutableTextureFromPixel(dsc.texture, placeholderImageData);
 
+		texturesBeingLoaded.insert(dsc.texture);
 		pendingJobs.Push(dsc);
 		runCondition.notify_all();
 	}
@@ -363,7 +1292,7 @@ TextureSystem::LoadDataTexture(const std::string& filename, GLenum internalForma
 	if (loadedImages.find(filename) != loadedImages.end())
 	{
 		const LoadedImage& image = loadedImages[filename];
-		CreateImmutableTextureFromImage(dsc, image);
+		CreateTextureFromImage(dsc, image);
 	}
 	else
 	{
@@ -372,6 +1301,7 @@ TextureSystem::LoadDataTexture(const std::string& filename, GLenum internalForma
 		static uint8_t placeholderImageData[4] = { 128, 128, 128, 255 };
 		CreateMutableTextureFromPixel(dsc.texture, placeholderImageData);
 
+		texturesBeingLoaded.insert(dsc.texture);
 		pendingJobs.Push(dsc);
 		runCondition.notify_all();
 	}
@@ -382,75 +1312,33 @@ TextureSystem::LoadDataTexture(const std::string& filename, GLenum internalForma
 GLuint
 TextureSystem::LoadBlueNoiseTextureArray(const std::string& folderPath)
 {
-	// TODO: Make this async!
-
-	// TODO: I really need to update to the latest version of Visual Studio...
-	namespace fs = std::experimental::filesystem;
-
-	GLuint texture;
-	int size;
+	ImageLoadDescription dsc;
+	dsc.filename = folderPath;
+	dsc.format = GL_RED;
+	dsc.internalFormat = GL_R8;
+	dsc.requestMipmaps = false;
+	dsc.isHdr = false;
+	dsc.isImageArray = true;
 
-	glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &texture);
-	glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &dsc.texture);
+	glTextureParameteri(dsc.texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(dsc.texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTextureParameteri(dsc.texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTextureParameteri(dsc.texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
-	int numImages = 0;
-	for (const auto& entry : fs::directory_iterator(folderPath))
+	if (loadedImages.find(folderPath) != loadedImages.end())
 	{
-		if (fs::is_regular_file(entry))
-		{
-			numImages += 1;
-		}
+		const LoadedImage& image = loadedImages[folderPath];
+		CreateTextureFromImage(dsc, image);
 	}
-
-	bool storageAllocated = false;
-	for (const auto& entry : fs::directory_iterator(folderPath))
+	else
 	{
-		// For now, assume we only have valid images in a directory
-		if (!fs::is_regular_file(entry)) continue;
-		auto filepath = entry.path().u8string();
-
-		int w, h;
-		stbi_uc *pixels = stbi_load(filepath.c_str(), &w, &h, nullptr, STBI_grey);
-		if (!pixels)
-		{
-			Log("Could not load image '%s': %s.\n", filepath.c_str(), stbi_failure_reason());
-			continue;
-		}
-
-		if (w != h)
-		{
-			Log("LoadBlueNoiseTextureArray only supports square images.");
-			return texture;
-		}
-
-		if (storageAllocated)
-		{
-			if (w != size)
-			{
-				Log("LoadBlueNoiseTextureArray can only load an image directory where all images are of the same size.");
-				return texture;
-			}
-		}
-		else
-		{
-			size = w;
-			glTextureStorage3D(texture, 1, GL_R8, size, size, numImages);
-			storageAllocated = true;
-		}
-
-		// Get the index of the image in the sequence
-		auto filename = entry.path().filename().replace_extension("").u8string();
-		size_t subIdx = filename.rfind('_');
-		assert(subIdx != std::string::npos);
-		auto sequenceIdxStr = filename.substr(subIdx + 1);
-		int sequenceIdx = atoi(sequenceIdxStr.c_str());
-
-		glTextureSubImage3D(texture, 0, 0, 0, sequenceIdx, size, size, 1, GL_RED, GL_UNSIGNED_BYTE, pixels);
-		stbi_image_free(pixels);
+		// There is no placeholder, so until the storage is created any image loads from it will return zero
+		currentJobsCounter += 1;
+		texturesBeingLoaded.insert(dsc.texture);
+		pendingJobs.Push(dsc);
+		runCondition.notify_all();
 	}
 
-	return texture;
+	return dsc.texture;
 }
@@ -23,12 +23,62 @@ namespace TextureSystem
 
 	GLuint CreatePlaceholder(uint8_t r, uint8_t g, uint8_t b, uint8_t a = 0xFF);
 
+	// Returns a resident bindless (ARB_bindless_texture) handle for the texture, or 0 if it's still loading. Note that
+	// the texture's state (e.g. parameters) can't be changed after a handle has been taken!
+	GLuint64 GetResidentHandle(GLuint texture);
+
+	//
+	// Texture atlas: with a non-zero max size, small LDR textures are packed into shared array textures. For these the
+	// resident handle is that of the (sampler2DArray) atlas, and the region is needed to sample the texture.
+	//
+
+	struct AtlasRegion
+	{
+		float offset[2];
+		float scale[2];
+		int layer;
+	};
+
+	// Must be set before any textures are loaded. Textures of at most this size (in both dimensions) will be atlased.
+	void SetAtlasMaxTextureSize(int size);
+
+	bool GetAtlasRegion(GLuint texture, AtlasRegion& region);
+	int GetAtlasTextureCount();
+
+	//
+	// Texture streaming: with a non-zero budget, mipmapped LDR textures are only made resident (in their own physical
+	// texture, only accessible through GetResidentHandle) with the levels requested through the GPU feedback.
+	//
+
+	struct StreamingStats
+	{
+		size_t budget;
+		size_t residentBytes;
+		size_t fullResolutionBytes;
+		int streamedTextureCount;
+		int uploadsLastFrame;
+	};
+
+	// Must be set before any textures are loaded. A zero budget disables streaming.
+	void SetStreamingBudget(size_t bytes);
+
+	// Request that the texture can be sampled with (at least) 2^log2Resolution texels across
+	void RequestStreamingResolution(GLuint texture, int log2Resolution);
+
+	StreamingStats GetStreamingStats();
+
+	int BytesPerTexel(GLenum internalFormat);
+
 	GLuint CreateTexture(int width, int height, GLenum format,
 		GLenum minFilter = GL_LINEAR_MIPMAP_LINEAR, GLenum magFilter = GL_LINEAR, bool useMips = true);
 
 	GLuint LoadLdrImage(const std::string& filename);
-	GLuint LoadHdrImage(const std::string& filename);
+	// Supported internal formats for HDR images are GL_RGB32F, GL_RGBA16F, GL_R11F_G11F_B10F and GL_RGB9_E5.
+	// Compact formats are converted on the loader thread. Note that GL_RGB9_E5 textures will not have mipmaps.
+	GLuint LoadHdrImage(const std::string& filename, GLenum internalFormat = GL_RGB32F);
 	GLuint LoadDataTexture(const std::string& filename, GLenum internalFormat = GL_RGBA8);
 
+	// Loads all (single-channel, square, same size) images "*_<index>.png" in the folder into the layers of a texture
+	// array. The images are decoded in parallel on the loader thread and the result is cached as a single binary blob.
 	GLuint LoadBlueNoiseTextureArray(const std::string& folderPath);
 }
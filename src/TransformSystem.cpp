@@ -14,6 +14,9 @@ static int nextIndex = 0;
 static std::array<Transform, MAX_NUM_TRANSFORMS> transforms;
 static std::array<Transform, MAX_NUM_TRANSFORMS> oldTransforms;
 
+static int currentFrame = 0;
+static std::array<int, MAX_NUM_TRANSFORMS> lastChangedFrame;
+
 //
 // Internal API
 //
@@ -37,6 +40,8 @@ TransformSystem::Init()
 void
 TransformSystem::Update()
 {
+	currentFrame += 1;
+
 	size_t numTransforms = nextIndex;
 	for (size_t id = 0; id < numTransforms; ++id)
 	{
@@ -46,6 +51,7 @@ TransformSystem::Update()
 		if (!IdenticalTransformProperties(old, curr))
 		{
 			old = curr;
+			lastChangedFrame[id] = currentFrame - 1;
 		}
 	}
 }
@@ -72,6 +78,18 @@ TransformSystem::GetPrevious(int transformID)
 	return transform;
 }
 
+int
+TransformSystem::FramesSinceChange(int transformID)
+{
+	// (changes made this frame are only found in the next update, but can be seen directly)
+	if (!IdenticalTransformProperties(oldTransforms[transformID], transforms[transformID]))
+	{
+		return 0;
+	}
+
+	return currentFrame - lastChangedFrame[transformID];
+}
+
 void
 TransformSystem::UpdateMatrices(int transformID)
 {
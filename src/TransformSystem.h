@@ -76,6 +76,9 @@ namespace TransformSystem
 	Transform& Get(int transformID);
 	const Transform& GetPrevious(int transformID);
 
+	// Number of frames since the transform was last changed, i.e. 0 if it changed this frame
+	int FramesSinceChange(int transformID);
+
 	void UpdateMatrices(int transformID);
 
 };
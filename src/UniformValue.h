@@ -1,8 +1,13 @@
 #pragma once
 
+#include <cassert>
+#include <limits>
+
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include "ShaderSystem.h"
+
 namespace prospect
 {
 	namespace internal
@@ -42,9 +47,34 @@ namespace prospect
 		{
 			glProgramUniform4fv(program, location, 1, &value.x);
 		}
+
+		// Whether a GLSL uniform type (as reported by reflection) can be written with the given C++ type
+		template<typename T>
+		inline bool IsCompatibleUniformType(GLenum type) { return false; }
+
+		template <>
+		inline bool IsCompatibleUniformType<int>(GLenum type) { return type == GL_INT || type == GL_BOOL || type == GL_SAMPLER_2D || type == GL_SAMPLER_CUBE || type == GL_SAMPLER_2D_ARRAY || type == GL_IMAGE_2D || type == GL_IMAGE_CUBE; }
+
+		template <>
+		inline bool IsCompatibleUniformType<float>(GLenum type) { return type == GL_FLOAT; }
+
+		template <>
+		inline bool IsCompatibleUniformType<glm::vec2>(GLenum type) { return type == GL_FLOAT_VEC2; }
+
+		template <>
+		inline bool IsCompatibleUniformType<glm::vec3>(GLenum type) { return type == GL_FLOAT_VEC3; }
+
+		template <>
+		inline bool IsCompatibleUniformType<glm::vec4>(GLenum type) { return type == GL_FLOAT_VEC4; }
 	}
 }
 
+//
+// A typed handle to a uniform. The location is resolved through the shader system's reflection only when the program
+// changes (e.g. on a hot reload), and the value is only written when it's dirty, so there are no GL queries nor string
+// lookups in the common case.
+//
+
 template<typename T>
 struct Uniform
 {
@@ -65,21 +95,27 @@ struct Uniform
 
 	void UpdateUniformIfNeeded(GLuint program)
 	{
-		if (location == 0 || program != lastProgram)
+		bool programChanged = program != lastProgram;
+
+		if (programChanged)
 		{
-			location = glGetUniformLocation(program, name);
+			const ShaderSystem::ReflectedUniform *uniform = ShaderSystem::FindUniform(program, name);
+			location = uniform ? uniform->location : -1;
+
+			// (a type mismatch would silently be ignored by GL, so catch it here instead)
+			assert(!uniform || prospect::internal::IsCompatibleUniformType<T>(uniform->type));
+
+			lastProgram = program;
 		}
 
-		if (value != lastValue || program != lastProgram)
+		if (location != -1 && (value != lastValue || programChanged))
 		{
 			prospect::internal::PerformUniformUpdate(program, location, value);
 			lastValue = value;
 		}
-
-		lastProgram = program;
 	}
 
-	GLint location = 0;
+	GLint location = -1;
 	T value = std::numeric_limits<T>::max();
 
 private:
@@ -90,3 +126,10 @@ private:
 	T lastValue = T{};
 	
 };
+
+// Flush all dirty uniforms of a program in one go
+template<typename... Ts>
+void UpdateUniformsIfNeeded(GLuint program, Uniform<Ts>&... uniforms)
+{
+	(uniforms.UpdateUniformIfNeeded(program), ...);
+}
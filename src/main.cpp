@@ -7,7 +7,9 @@
 #include <stdlib.h>
 
 #include "Logging.h"
+#include "GLState.h"
 #include "GuiSystem.h"
+#include "GLValidation.h"
 #include "ModelSystem.h"
 #include "ShaderSystem.h"
 #include "TextureSystem.h"
@@ -33,49 +35,17 @@ bool renderUI{ true };
 // without dropping any frames etc. In other words, works pretty well for me.
 #define ASSUME_FIXED_60_FPS false
 
+// Checking every GL call for errors is very useful while developing, but it serializes the driver which skews timings
+#ifdef NDEBUG
+ #define DEFAULT_GL_VALIDATION_MODE GLValidation::Mode::Async
+#else
+ #define DEFAULT_GL_VALIDATION_MODE GLValidation::Mode::Full
+#endif
+
 //
 // Callbacks
 //
 
-void gl_debug_message_callback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar *message, const void *userParam)
-{
-	Log("GL debug message: %s\n", message);
-}
-
-void glad_post_callback(const char *name, void *funcptr, int argCount, ...)
-{
-	// Use the "raw" glad_glGetError to avoid an recursive loop
-	GLenum errorCode = glad_glGetError();
-
-	if (errorCode != GL_NO_ERROR)
-	{
-		const char *errorName;
-		switch (errorCode)
-		{
-		case GL_INVALID_ENUM:
-			errorName = "GL_INVALID_ENUM";
-			break;
-		case GL_INVALID_VALUE:
-			errorName = "GL_INVALID_VALUE";
-			break;
-		case GL_INVALID_OPERATION:
-			errorName = "GL_INVALID_OPERATION";
-			break;
-		case GL_OUT_OF_MEMORY:
-			errorName = "GL_OUT_OF_MEMORY";
-			break;
-		case GL_INVALID_FRAMEBUFFER_OPERATION:
-			errorName = "GL_INVALID_FRAMEBUFFER_OPERATION";
-			break;
-		default:
-			errorName = "UnknownError";
-			break;
-		}
-
-		LogError("%s error (0x%03x) in '%s'\n", errorName, errorCode, name);
-	}
-}
-
 void glfw_error_callback(int code, const char *message)
 {
 	LogError("GLFW error %d: %s\n", code, message);
@@ -191,14 +161,8 @@ int main()
 	glfwMakeContextCurrent(window);
 	gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
 
-	// Setup OpenGL error handlers
-	glad_set_post_callback(glad_post_callback);
-
-	glEnable(GL_DEBUG_OUTPUT);
-	glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
-	glDebugMessageCallback(gl_debug_message_callback, nullptr);
-	glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, true);
-	glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, nullptr, false);
+	// Setup OpenGL error handling (can be changed at runtime)
+	GLValidation::Init(DEFAULT_GL_VALIDATION_MODE);
 
 	// Setup input and callbacks
 	Input input;
@@ -216,9 +180,11 @@ int main()
 	glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 
 	// Initialize global systems (that need initialization)
+	ShaderSystem::Init();
 	TransformSystem::Init();
 	TextureSystem::Init();
 	ModelSystem::Init();
+	MaterialSystem::Init();
 	GuiSystem::Init(window);
 
 	app->Init();
@@ -238,16 +204,27 @@ int main()
 	double lastTime = glfwGetTime();
 	float accumulatedTime = 0.0;
 
+	// Startup timings, logged once: the first frame (which e.g. includes requesting all lazy resources) and the time
+	// until all pending texture loads are done
+	int frameIndex = 0;
+	bool texturesLoadedLogged = false;
+
 	while (!glfwWindowShouldClose(window))
 	{
+		double frameStartTime = glfwGetTime();
+
 		input.PreEventPoll();
 		glfwPollEvents();
 
 		TransformSystem::Update();
 		TextureSystem::Update();
 		ModelSystem::Update();
+		MaterialSystem::Update();
 		ShaderSystem::Update();
 
+		GLState::NewFrame();
+		GLValidation::BeginFrame();
+
 		handle_global_key_commands(window, input);
 
 #if ASSUME_FIXED_60_FPS
@@ -276,7 +253,22 @@ int main()
 			ImGui::EndFrame();
 		}
 
+		GLValidation::EndFrame();
 		glfwSwapBuffers(window);
+
+		if (frameIndex++ == 0)
+		{
+			Log("Startup: first frame took %.1f ms\n", 1000.0 * (glfwGetTime() - frameStartTime));
+
+			auto shaderStats = ShaderSystem::GetProgramCacheStats();
+			Log("Startup: %.1f ms spent on shader programs (%d cached, %d compiled, %d cached binaries rejected, %d shared shader objects)\n",
+				shaderStats.milliseconds, shaderStats.hits, shaderStats.misses, shaderStats.rejected, shaderStats.sharedShaderObjects);
+		}
+		if (!texturesLoadedLogged && TextureSystem::IsIdle())
+		{
+			Log("Startup: all textures loaded after %.1f ms\n", 1000.0 * glfwGetTime());
+			texturesLoadedLogged = true;
+		}
 	}
 
 	// Destroy global systems (that need to be destroyed)
@@ -284,6 +276,7 @@ int main()
 	TextureSystem::Destroy();
 	ModelSystem::Destroy();
 	GuiSystem::Destroy();
+	ShaderSystem::Destroy();
 
 	glfwTerminate();
 }
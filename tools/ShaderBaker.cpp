@@ -0,0 +1,54 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "Logging.h"
+#include "ShaderSystem.h"
+
+//
+// Offline shader validation & baking, see the bake_shaders target. Every program is compiled and linked in a context
+// of a hidden window, so it needs some kind of display, e.g. run with xvfb-run and Mesa (LIBGL_ALWAYS_SOFTWARE=1) on
+// headless build machines. Run from the directory containing the shaders/ directory. Returns non-zero on any failure.
+//
+//   Usage: ShaderBaker <bundle path>
+//
+
+void glfw_error_callback(int code, const char *message)
+{
+	LogError("GLFW error %d: %s\n", code, message);
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2)
+	{
+		LogError("Usage: %s <bundle path>\n", argv[0]);
+	}
+
+	glfwSetErrorCallback(glfw_error_callback);
+	if (!glfwInit())
+	{
+		LogError("Fatal error: could not initialize GLFW");
+	}
+
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+	GLFWwindow *window = glfwCreateWindow(64, 64, "ShaderBaker", nullptr, nullptr);
+	if (!window)
+	{
+		LogError("Fatal error: could not create a GL 4.6 context");
+	}
+
+	glfwMakeContextCurrent(window);
+	gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+
+	Log("Validating shaders with %s (%s)\n", glGetString(GL_RENDERER), glGetString(GL_VERSION));
+	bool success = ShaderSystem::BakeShaderBundle(argv[1]);
+
+	glfwDestroyWindow(window);
+	glfwTerminate();
+
+	return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}